@@ -18,6 +18,9 @@
  *
  */
 
+#include <fstream>
+#include <sstream>
+
 #include "Flow.h"
 #include "../util/Utils.h"
 
@@ -27,7 +30,8 @@ namespace remo
     _description ( "Base Flow" ),
     _inStream ( inStream_ ),
     _outStream ( outStream_ ),
-    _ffPipeline ( nullptr ) {}
+    _ffPipeline ( nullptr ),
+    _stop ( false ) {}
 
   std::string Flow::getDescription ( void )
   {
@@ -49,6 +53,284 @@ namespace remo
 
   void Flow::finish ( void )
   {
-    
+    _stop = true;
+  }
+
+  StageStats* Flow::addStage ( const std::string& name_ )
+  {
+    _stages.emplace_back ( new StageStats ( name_ ));
+    return _stages.back ( ).get ( );
+  }
+
+  std::vector < StageStats* > Flow::getStageStats ( void )
+  {
+    std::vector < StageStats* > stages_;
+    for ( auto& stage_ : _stages )
+    {
+      stages_.push_back ( stage_.get ( ));
+    }
+    //Then the operations of the pipeline, as they run.
+    if ( _ffPipeline != nullptr )
+    {
+      stages_.push_back ( _ffPipeline->getFrameStats ( ));
+      for ( StageStats* stage_ : _ffPipeline->getStageStats ( ))
+      {
+        stages_.push_back ( stage_ );
+      }
+    }
+    return stages_;
+  }
+
+  StageStats* Flow::getStageStats ( const std::string& name_ )
+  {
+    for ( StageStats* stage_ : getStageStats ( ))
+    {
+      if ( stage_->getName ( ) == name_ )
+      {
+        return stage_;
+      }
+    }
+    return nullptr;
+  }
+
+  std::string Flow::getStatsJSON ( void )
+  {
+    std::ostringstream json_;
+    json_ << "{\"flow\": \"" << _description << "\", \"stages\": [";
+    std::vector < StageStats* > stages_ = getStageStats ( );
+    for ( unsigned int i = 0; i < stages_.size ( ); ++i )
+    {
+      json_ << ( i > 0 ? ", " : "" ) << stages_[i]->toJSON ( );
+    }
+    json_ << "]}";
+    return json_.str ( );
+  }
+
+  bool Flow::dumpStats ( const std::string& statsFile_ )
+  {
+    std::ofstream file_ ( statsFile_ );
+    if ( !file_ )
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "Unable to write flow stats to ",
+                                           statsFile_ );
+      return false;
+    }
+
+    file_ << getStatsJSON ( ) << std::endl;
+    return true;
+  }
+
+  Flow::STEP_RESULT Flow::step ( void )
+  {
+    processStreams ( );
+    return STEP_DONE;
+  }
+
+  namespace
+  {
+    //Once the flow has released its resources, so the stats are complete.
+    void writeStatsFile ( Flow* flow_ )
+    {
+      if ( !flow_->getStatsFile ( ).empty ( ))
+      {
+        flow_->dumpStats ( flow_->getStatsFile ( ));
+      }
+    }
+  }
+
+  void Flow::runSteps ( void )
+  {
+    prepare ( );
+
+    STEP_RESULT result_ = STEP_CONTINUE;
+    while ( !_stop && ( result_ != STEP_DONE ))
+    {
+      result_ = step ( );
+      if ( result_ == STEP_IDLE )
+      {
+        std::this_thread::sleep_for ( std::chrono::milliseconds ( 1 ));
+      }
+    }
+
+    cleanup ( );
+    writeStatsFile ( this );
+  }
+
+  namespace
+  {
+    //Runs one step of a flow on the executor and queues the next one, so
+    //the flows sharing the executor take turns.
+    struct FlowRunner: public std::enable_shared_from_this < FlowRunner >
+    {
+      Flow* flow;
+      WorkerPool* executor;
+      std::promise < void > done;
+      bool prepared = false;
+
+      void operator( ) ( void )
+      {
+        try
+        {
+          if ( !prepared )
+          {
+            flow->prepare ( );
+            prepared = true;
+          }
+
+          Flow::STEP_RESULT result_ = flow->isStopRequested ( )
+                                      ? Flow::STEP_DONE : flow->step ( );
+          if ( result_ == Flow::STEP_DONE )
+          {
+            prepared = false;
+            flow->cleanup ( );
+            writeStatsFile ( flow );
+            done.set_value ( );
+            return;
+          }
+
+          auto self_ = shared_from_this ( );
+          executor->submitAfter ( result_ == Flow::STEP_IDLE
+                                  ? std::chrono::milliseconds ( 2 )
+                                  : std::chrono::milliseconds ( 0 ),
+                                  [ self_ ] ( ) { ( *self_ ) ( ); } );
+        }
+        catch ( ... )
+        {
+          //Release what prepare ( ) took, unless cleanup ( ) itself threw.
+          if ( prepared )
+          {
+            prepared = false;
+            try
+            {
+              flow->cleanup ( );
+            }
+            catch ( ... )
+            {
+            }
+          }
+          done.set_exception ( std::current_exception ( ));
+        }
+      }
+    };
+  }
+
+  FlowHandle Flow::start ( WorkerPool* executor_ )
+  {
+    _stop = false;
+
+    FlowHandle handle_;
+    handle_._flow = this;
+
+    if ( executor_ != nullptr )
+    {
+      if ( runsOwnThreads ( ))
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                             _description,
+                                             " runs on its own threads, it holds "
+                                             "an executor thread until it ends." );
+      }
+
+      //Reads must not block the shared threads, devices without a new
+      //packet report EAGAIN and the step is retried later.
+      StreamDeviceIn* in_ = dynamic_cast < StreamDeviceIn* > ( _inStream );
+      if ( in_ && in_->getFormatContext ( ))
+      {
+        in_->getFormatContext ( )->flags |= AVFMT_FLAG_NONBLOCK;
+      }
+
+      auto runner_ = std::make_shared < FlowRunner > ( );
+      runner_->flow = this;
+      runner_->executor = executor_;
+      handle_._future = runner_->done.get_future ( ).share ( );
+      executor_->submit ( [ runner_ ] ( ) { ( *runner_ ) ( ); } );
+    }
+    else
+    {
+      std::packaged_task < void ( void ) > task_ ( [ this ] ( ) { runSteps ( ); } );
+      handle_._future = task_.get_future ( ).share ( );
+      handle_._thread = std::make_shared < FlowHandle::Thread > ( );
+      handle_._thread->thread = std::thread ( std::move ( task_ ));
+    }
+
+    return handle_;
+  }
+
+  FlowHandle::Thread::~Thread ( void )
+  {
+    if ( thread.joinable ( ))
+    {
+      thread.join ( );
+    }
+  }
+
+  void FlowHandle::stop ( void )
+  {
+    if ( _flow != nullptr )
+    {
+      _flow->finish ( );
+    }
+  }
+
+  bool FlowHandle::waitFor ( std::chrono::milliseconds timeout_ )
+  {
+    if ( !_future.valid ( ))
+    {
+      return true;
+    }
+    return _future.wait_for ( timeout_ ) == std::future_status::ready;
+  }
+
+  bool FlowHandle::stopAndWait ( std::chrono::milliseconds timeout_ )
+  {
+    stop ( );
+    return waitFor ( timeout_ );
+  }
+
+  void FlowHandle::join ( void )
+  {
+    if ( !_future.valid ( ))
+    {
+      return;
+    }
+
+    _future.wait ( );
+    if ( _thread )
+    {
+      std::unique_lock < std::mutex > lock ( _thread->mtx );
+      if ( _thread->thread.joinable ( ))
+      {
+        _thread->thread.join ( );
+      }
+    }
+  }
+
+  void Flow::logStageStats ( void )
+  {
+    for ( StageStats* stage_ : getStageStats ( ))
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                           "Stage ", stage_->getName ( ),
+                                           ": p50/p95/p99/max (us) ",
+                                           stage_->getPercentile ( 50.0 ), "/",
+                                           stage_->getPercentile ( 95.0 ), "/",
+                                           stage_->getPercentile ( 99.0 ), "/",
+                                           stage_->getMax ( ),
+                                           ", fps: ", stage_->getFps ( ),
+                                           ", bytes/s: ", stage_->getBytesPerSecond ( ),
+                                           ", skipped: ", stage_->getSkipped ( ));
+    }
+  }
+
+  void Flow::logPoolUsage ( void )
+  {
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Frame pool hits/misses: ",
+                                         _framePool.getHits ( ), "/",
+                                         _framePool.getMisses ( ),
+                                         ", packet pool hits/misses: ",
+                                         _packetPool.getHits ( ), "/",
+                                         _packetPool.getMisses ( ));
   }
 }
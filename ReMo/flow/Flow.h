@@ -21,29 +21,122 @@
 #ifndef REMO_FLOW_H
 #define REMO_FLOW_H
 
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "../pipeline/FFPipeline.h"
 #include "../stream/StreamDeviceIn.h"
 #include "../stream/StreamVideoFileOut.h"
+#include "../util/FramePool.h"
+#include "../util/StageStats.h"
+#include "../util/WorkerPool.h"
 
 namespace remo
 {
+  class Flow;
+
+  //Returned by Flow::start ( ). Copies share the same execution.
+  class FlowHandle
+  {
+    public:
+      FlowHandle ( void ) = default;
+
+      bool isValid ( void ) { return _future.valid ( ); }
+      //Asks the flow to stop, it finishes the current step and releases
+      //its resources.
+      void stop ( void );
+      //True when the flow has finished before the timeout.
+      bool waitFor ( std::chrono::milliseconds timeout_ );
+      //Stops the flow and waits at most timeout_ for it.
+      bool stopAndWait ( std::chrono::milliseconds timeout_ );
+      void join ( void );
+
+      std::shared_future < void > getFuture ( void ) { return _future; }
+
+    private:
+      friend class Flow;
+
+      //Dedicated thread of a flow started without executor, joined by the
+      //last handle.
+      struct Thread
+      {
+        ~Thread ( void );
+        std::mutex mtx;
+        std::thread thread;
+      };
+
+      Flow* _flow = nullptr;
+      std::shared_future < void > _future;
+      std::shared_ptr < Thread > _thread;
+  };
+
   class Flow
   {
     public:
+      //Result of one step of execution.
+      enum STEP_RESULT
+      {
+        STEP_CONTINUE,
+        STEP_IDLE,     //Nothing to read yet, retry later.
+        STEP_DONE
+      };
+
       Flow ( Stream* inStream_, Stream* outStream_ );
       virtual ~Flow ( void ) = default;
 
       virtual void init ( void ) = 0;
       virtual void processStreams ( void ) = 0;
+      //Requests the flow to stop, safe to call from any thread.
       virtual void finish ( void );
+      bool isStopRequested ( void ) { return _stop; }
+
+      //Runs the flow asynchronously, on its own thread or, when an executor
+      //is given, as a sequence of steps sharing the executor threads with
+      //other flows. A flow that runs on its own threads (see
+      //runsOwnThreads ( )) does it in a single step, holding one executor
+      //thread for its whole run.
+      //Without executor the last copy of the handle joins the thread when
+      //destroyed, so discarding the handle of a continuous flow blocks until
+      //finish ( ) is called from elsewhere.
+      FlowHandle start ( WorkerPool* executor_ = nullptr );
+      //True when step ( ) starts threads of its own instead of returning
+      //after a bounded amount of work.
+      virtual bool runsOwnThreads ( void ) { return false; }
+
+      //Step based execution. The defaults run the whole processStreams ( )
+      //as a single step.
+      virtual void prepare ( void ) {}
+      virtual STEP_RESULT step ( void );
+      virtual void cleanup ( void ) {}
 
       std::string getDescription ( void );
       void setPipeline ( FFPipeline* ffPipeline_ = nullptr );
       FFPipeline* getPipeline ( ) { return _ffPipeline; };
 
+      //Latency and throughput of each stage of the flow, they can be read
+      //while the flow runs.
+      std::vector < StageStats* > getStageStats ( void );
+      StageStats* getStageStats ( const std::string& name_ );
+      std::string getStatsJSON ( void );
+      //When set, the stats JSON is written to this file after cleanup ( ),
+      //whether the flow was stopped or reached the end of its input.
+      void setStatsFile ( const std::string& statsFile_ ) { _statsFile = statsFile_; }
+      const std::string& getStatsFile ( void ) { return _statsFile; }
+      bool dumpStats ( const std::string& statsFile_ );
+
+      FramePool& getFramePool ( void ) { return _framePool; }
+      PacketPool& getPacketPool ( void ) { return _packetPool; }
+
     protected:
+      StageStats* addStage ( const std::string& name_ );
+      void logStageStats ( void );
+      void logPoolUsage ( void );
+      //prepare ( ), step ( ) until done or stopped, and cleanup ( ).
+      void runSteps ( void );
 
       std::string _description;
 
@@ -51,6 +144,14 @@ namespace remo
       Stream* _outStream;
       
       FFPipeline* _ffPipeline;
+
+      std::atomic < bool > _stop;
+
+      std::vector < std::unique_ptr < StageStats > > _stages;
+      std::string _statsFile;
+
+      FramePool _framePool;
+      PacketPool _packetPool;
   };
 }
 
@@ -19,7 +19,6 @@
  */
 #ifdef REMO_USE_SDL
 
-#include <thread>
 #include <libavformat/version.h>
 
 #include "FlowDeviceToSDLViewer.h"
@@ -34,8 +33,19 @@ namespace remo
     : Flow ( inStream_, outStream_ ),
     _continuousExecution ( continuousExecution_ ),
     _numFrames ( numFrames_ ),
-    _stop ( false )
+    _packetsToSkip ( 8 ),
+    _viewerMedia ( nullptr ),
+    _packet ( nullptr ),
+    _frame ( nullptr ),
+    _frameYUV ( nullptr )
   {
+    _readStats = addStage ( "read" );
+    _decodeStats = addStage ( "decode" );
+    _processStats = addStage ( "process" );
+    _drawStats = addStage ( "draw" );
+    _scaleStats = addStage ( "scale" );
+
+    _description = "Device to SDL Viewer Flow";
     _inDevice = static_cast<StreamDeviceIn*>( _inStream );
     _outViewer = static_cast<StreamSDLViewerOut*>( _outStream );
 
@@ -83,181 +93,174 @@ namespace remo
 
     Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
                                          "All streams has been init succesfully." );
-
-    if ( _ffPipeline != nullptr )
-    {
-      _ffPipeline->connectFramesAndPackages ( _frame, _frameYUV, _packet );
-    }
   }
 
   void FlowDeviceToSDLViewer::releaseResources ( const std::string& msg_ )
   {
-    av_packet_unref ( _packet );
-    av_packet_free ( &_packet );
-
-    av_frame_unref ( _frame );
-    av_frame_free ( &_frame );
+    _packetPool.releasePacket ( _packet );
 
-    av_frame_unref ( _frameYUV );
-    av_frame_free ( &_frameYUV );
-
-    sws_freeContext ( _swsCtx );
+    _framePool.releaseFrame ( _frame );
+    _framePool.releaseFrame ( _frameYUV );
 
     Utils::getInstance ( )->getErrorManager ( )->criticalError ( msg_ );
   }
 
   void FlowDeviceToSDLViewer::processStreams ( void )
   {
-    if ( _continuousExecution )
-    {
-      std::thread th_ ( &FlowDeviceToSDLViewer::loop, this );
-      th_.detach ( ); 
-
-      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
-                                           "Press any key to finish the thread!." );
-      std::cin.get ( );
-      _stop = true;
-    }
-    else
-    {
-      loop ( );
-    }
+    runSteps ( );
   }
 
-  void FlowDeviceToSDLViewer::loop ( void )
+  void FlowDeviceToSDLViewer::prepare ( void )
   {
-    int value = 0;
-
     avformat_version ( );
 
-    _packet = av_packet_alloc ( );
-    if ( !_packet )
+    _packet = _packetPool.getPacket ( );
+    _frame = _framePool.getFrame ( );
+    _frameYUV = _framePool.getFrame ( );
+    if ( !_packet || !_frame || !_frameYUV )
     {
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to"
-                                                                   "reserve "
-                                                                   "resources "
-                                                                   "fo working "
-                                                                   "packet." );
-    }
-
-    _frame = av_frame_alloc ( );
-    if ( !_frame )
-    {
-      av_packet_unref ( _packet );
-      av_packet_free ( &_packet );
+      _packetPool.releasePacket ( _packet );
+      _framePool.releaseFrame ( _frame );
+      _framePool.releaseFrame ( _frameYUV );
       Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
                                                                    "reserve "
                                                                    "resources "
                                                                    "for "
                                                                    "working "
-                                                                   "frame." );
+                                                                   "frames." );
     }
 
-    _frameYUV = av_frame_alloc ( );
-    if ( !_frameYUV )
+    _viewerMedia = static_cast<MediaSDLViewer*>(_outViewer->getMedia ( ));
+
+    //The working frames only exist from here on.
+    if ( _ffPipeline != nullptr )
     {
-      av_packet_unref ( _packet );
-      av_packet_free ( &_packet );
-      av_frame_unref ( _frame );
-      av_frame_free ( &_frame );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
-                                                                   "reserve "
-                                                                   "resources "
-                                                                   "for "
-                                                                   "working "
-                                                                   "YUVframe.");
+      _ffPipeline->connectFramesAndPackages ( _frame, _frameYUV, _packet );
+      _ffPipeline->init ( );
     }
 
-    MediaSDLViewer
-      * vMedia_ = static_cast<MediaSDLViewer*>(_outViewer->getMedia ( ));
-
-    _swsCtx = sws_getContext ( _inDevice->getCodecContext ( )->width,
-                               _inDevice->getCodecContext ( )->height,
-                               _inDevice->getCodecContext ( )->pix_fmt,
-                               vMedia_->getOverlayWidth ( ),
-                               vMedia_->getOverlayHeigh ( ),
-                               AV_PIX_FMT_YUV420P,
-                               SWS_BILINEAR,
-                               nullptr,
-                               nullptr,
-                               nullptr );
-    if ( !_swsCtx )
+    _packetsToSkip = 8;
+  }
+
+  Flow::STEP_RESULT FlowDeviceToSDLViewer::step ( void )
+  {
+    if ( !_continuousExecution )
     {
-      av_packet_unref ( _packet );
-      av_packet_free ( &_packet );
-      av_frame_unref ( _frame );
-      av_frame_free ( &_frame );
-      av_frame_unref ( _frameYUV );
-      av_frame_free ( &_frameYUV );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
-                                                                   "reserve "
-                                                                   "resources "
-                                                                   "for "
-                                                                   "context. " );
+      if ( _numFrames == 0 )
+      {
+        return STEP_DONE;
+      }
+      --_numFrames;
     }
 
-    int actNumFrames = 0;
-    int how_many_packets_to_process = 8;
-
-    while ((( _continuousExecution ) && ( !_stop )) || ( _numFrames > 0 ))
+    StageTimer readTimer_ ( _readStats );
+    int value = av_read_frame ( _inDevice->getFormatContext ( ), _packet );
+    if ( value < 0 )
+    {
+      readTimer_.cancel ( );
+    }
+    else
+    {
+      readTimer_.setBytes ( _packet->size );
+      readTimer_.stop ( );
+    }
+    if ( value == AVERROR( EAGAIN ))
     {
       if ( !_continuousExecution )
-        --_numFrames;
-      if ( av_read_frame ( _inDevice->getFormatContext ( ), _packet ) >= 0 )
       {
-        if (( _packet->stream_index == _inDevice->getVideoStreamIndx ( ))
-          && ( --how_many_packets_to_process < 0 ))
-        {
-          value = avcodec_send_packet ( _inDevice->getCodecContext ( ), _packet );
-          if ( value < 0 )
-          {
-            releaseResources ( "Unable to decode video." );
-          }
+        ++_numFrames;
+      }
+      return STEP_IDLE;
+    }
+    else if ( value < 0 )
+    {
+      return value == AVERROR_EOF ? STEP_DONE : STEP_CONTINUE;
+    }
 
-          value = avcodec_receive_frame ( _inDevice->getCodecContext ( ), _frame );
+    STEP_RESULT result_ = STEP_CONTINUE;
+    if (( _packet->stream_index == _inDevice->getVideoStreamIndx ( ))
+      && ( --_packetsToSkip < 0 ))
+    {
+      StageTimer decodeTimer_ ( _decodeStats );
+      decodeTimer_.setBytes ( _packet->size );
+      value = avcodec_send_packet ( _inDevice->getCodecContext ( ), _packet );
+      if ( value < 0 )
+      {
+        releaseResources ( "Unable to decode video." );
+      }
 
-          if ( value == AVERROR( EAGAIN ) || value == AVERROR_EOF)
-          {
-            Utils::getInstance ( )
-              ->getLog ( ) ( LOG_LEVEL::INFO, "Error receiving frame." );
-            break;
-          }
-          else if ( value < 0 )
-          {
-            Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
-                                                 "Legitimate decoding error:",
-                                                 value );
-          }
-          else
+      value = avcodec_receive_frame ( _inDevice->getCodecContext ( ), _frame );
+      decodeTimer_.stop ( );
+
+      if ( value == AVERROR( EAGAIN ))
+      {
+        //The decoder needs more packets.
+      }
+      else if ( value == AVERROR_EOF )
+      {
+        Utils::getInstance ( )
+          ->getLog ( ) ( LOG_LEVEL::INFO, "Error receiving frame." );
+        result_ = STEP_DONE;
+      }
+      else if ( value < 0 )
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                             "Legitimate decoding error:",
+                                             value );
+      }
+      else
+      {
+        bool ready_ = true;
+        if ( _ffPipeline != nullptr )
+        {
+          StageTimer processTimer_ ( _processStats );
+          //A threaded pipeline may still hold the frame.
+          ready_ = _ffPipeline->process ( );
+        }
+        if ( ready_ )
+        {
+          StageTimer drawTimer_ ( _drawStats );
+          _viewerMedia->draw ( _frameYUV );
+          drawTimer_.stop ( );
+
+          StageTimer scaleTimer_ ( _scaleStats );
+          if ( !_scaler.scale ( _frame->data,
+                                _frame->linesize,
+                                _frame->width,
+                                _frame->height,
+                                static_cast<AVPixelFormat>( _frame->format ),
+                                _frameYUV->data,
+                                _frameYUV->linesize,
+                                _viewerMedia->getOverlayWidth ( ),
+                                _viewerMedia->getOverlayHeigh ( ),
+                                AV_PIX_FMT_YUV420P,
+                                SWS_BILINEAR ))
           {
-            if ( _ffPipeline != nullptr )
-            {
-              _ffPipeline->process ( );
-            }
-
-            vMedia_->draw ( _frameYUV );
-            sws_scale ( _swsCtx,
-                        _frame->data,
-                        _frame->linesize,
-                        0,
-                        _inDevice->getCodecContext ( )->height,
-                        _frameYUV->data,
-                        _frameYUV->linesize );
-            ++actNumFrames;
+            releaseResources ( "Unable to scale frame." );
           }
+          scaleTimer_.stop ( );
         }
       }
-      av_packet_unref ( _packet );
     }
-    av_packet_free ( &_packet );
+    av_packet_unref ( _packet );
+
+    return result_;
+  }
+
+  void FlowDeviceToSDLViewer::cleanup ( void )
+  {
+    if ( _ffPipeline != nullptr )
+    {
+      _ffPipeline->stop ( );
+    }
 
-    av_frame_unref ( _frame );
-    av_frame_free ( &_frame );
+    _packetPool.releasePacket ( _packet );
 
-    av_frame_unref ( _frameYUV );
-    av_frame_free ( &_frameYUV );
+    _framePool.releaseFrame ( _frame );
+    _framePool.releaseFrame ( _frameYUV );
 
-    sws_freeContext ( _swsCtx );
+    logStageStats ( );
+    logPoolUsage ( );
   }
 }
 
@@ -28,6 +28,7 @@
 #include "../stream/StreamDeviceIn.h"
 #include "../stream/StreamSDLViewerOut.h"
 #include "../media/MediaSDLViewer.h"
+#include "../util/ParallelScaler.h"
 
 namespace remo
 {
@@ -42,9 +43,13 @@ namespace remo
       virtual ~FlowDeviceToSDLViewer ( void ) = default;
 
       virtual void init ( void );
+      //Runs until the frames are captured or, in continuous execution, until
+      //finish ( ) is called. Use start ( ) to run it asynchronously.
       virtual void processStreams ( void );
 
-      void loop ( );
+      virtual void prepare ( void );
+      virtual STEP_RESULT step ( void );
+      virtual void cleanup ( void );
 
       void setNumFramesToCapture ( unsigned int numFrames_ )
       {
@@ -59,13 +64,21 @@ namespace remo
 
       bool _continuousExecution;
       unsigned int _numFrames;
-      bool _stop;
- 
+      int _packetsToSkip;
+
+      StageStats* _readStats;
+      StageStats* _decodeStats;
+      StageStats* _processStats;
+      StageStats* _drawStats;
+      StageStats* _scaleStats;
+
+      MediaSDLViewer* _viewerMedia;
+
       AVPacket* _packet;
       AVFrame* _frame;
       AVFrame* _frameYUV;
       
-      SwsContext* _swsCtx;
+      ParallelScaler _scaler;
   };
 }
 
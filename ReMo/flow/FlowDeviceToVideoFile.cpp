@@ -18,6 +18,8 @@
  *
  */
 
+#include <thread>
+
 #include "FlowDeviceToVideoFile.h"
 #include "../util/Utils.h"
 
@@ -29,8 +31,23 @@ namespace remo
                                                  unsigned int numFrames_ )
     : Flow ( inStream_, outStream_ ),
     _continuousExecution ( continuousExecution_ ),
-    _numFrames ( numFrames_ )
+    _numFrames ( numFrames_ ),
+    _nextPts ( 0 ),
+    _scaler ( _framePool ),
+    _inAVPacket ( nullptr ),
+    _inAVFrame ( nullptr ),
+    _outAVFrame ( nullptr ),
+    _outputMuxer ( nullptr ),
+    _pipelined ( false ),
+    _queueDepths { 8, 4, 4, 16 }
   {
+    _readStats = addStage ( "read" );
+    _decodeStats = addStage ( "decode" );
+    _convertStats = addStage ( "convert" );
+    _encodeStats = addStage ( "encode" );
+    _writeStats = addStage ( "write" );
+
+    _description = "Device to Video File Flow";
     _inDevice = static_cast<StreamDeviceIn*>( _inStream );
     _outFile = static_cast<StreamVideoFileOut*>( _outStream );
 
@@ -68,6 +85,7 @@ namespace remo
       ->getLog ( ) ( LOG_LEVEL::INFO, "Init out Stream Flow." );
     if ( _outStream != nullptr )
     {
+      _outFile->setSourceStream ( _inDevice->getVideoStream ( ));
       _outFile->init ( );
     }
     else
@@ -82,279 +100,630 @@ namespace remo
 
   void FlowDeviceToVideoFile::releaseResources ( const std::string& msg_ )
   {
-    av_packet_unref ( _inAVPacket );
-    av_packet_free ( &_inAVPacket );
-
-    av_packet_unref ( _outAVPacket );
-    av_packet_free ( &_outAVPacket );
-
-    av_frame_unref ( _inAVFrame );
-    av_frame_free ( &_inAVFrame );
-
-    av_frame_unref ( _outAVFrame );
-    av_frame_free ( &_outAVFrame );
-
-    sws_freeContext ( _swsCtx );
+    _packetPool.releasePacket ( _inAVPacket );
 
-    av_free ( _videoOutBuffer );
+    _framePool.releaseFrame ( _inAVFrame );
+    _framePool.releaseFrame ( _outAVFrame );
 
     Utils::getInstance ( )->getErrorManager ( )->criticalError ( msg_ );
   }
 
-  void FlowDeviceToVideoFile::processStreams ( void )
+  void FlowDeviceToVideoFile::addOutput ( const std::string& url_,
+                                          const std::string& format_,
+                                          bool dropWhenFull_ )
   {
-    int value = 0;
+    _extraOutputs.push_back ( ExtraOutput { url_, format_, dropWhenFull_ } );
+  }
+
+  void FlowDeviceToVideoFile::addSegmentedOutput ( const std::string& prefix_,
+                                                   double segmentSeconds_,
+                                                   uint64_t segmentBytes_,
+                                                   uint64_t quotaBytes_,
+                                                   const std::string& extension_ )
+  {
+    SegmentMuxer* segmenter_ = new SegmentMuxer ( prefix_, extension_ );
+    segmenter_->setSegmentDuration ( segmentSeconds_ );
+    segmenter_->setSegmentSize ( segmentBytes_ );
+    segmenter_->setQuota ( quotaBytes_ );
+    _segmentMuxers.emplace_back ( segmenter_ );
+  }
 
-    _inAVPacket = av_packet_alloc ( );
-    if ( !_inAVPacket )
+  void FlowDeviceToVideoFile::prepareMuxer ( void )
+  {
+    AVCodecContext* outCtx_ = _outFile->getCodecContext ( );
+    _muxer.setOutput ( _outFile->getFormatContext ( ),
+                       _outFile->getVideoStream ( ),
+                       outCtx_->time_base );
+    _muxer.setStats ( _writeStats );
+    _muxer.init ( );
+    _outputMuxer = &_muxer;
+
+    if ( _extraOutputs.empty ( ) && _segmentMuxers.empty ( ))
     {
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
-                                                                   "reserve "
-                                                                   "working "
-                                                                   "package." );
+      return;
     }
 
-    _outAVPacket = av_packet_alloc ( );
-    if ( !_outAVPacket )
+    //The file never drops, the extra outputs are opened once.
+    if ( _teeMuxer.getNumOutputs ( ) == 0 )
     {
-      av_packet_unref ( _inAVPacket );
-      av_packet_free ( &_inAVPacket );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
-                                                                   "reserve "
-                                                                   "working "
-                                                                   "package." );
+      _teeMuxer.addOutput ( _outFile->getFormatContext ( ),
+                            _outFile->getVideoStream ( ),
+                            _queueDepths[ENCODED_PACKETS], false );
+      for ( const ExtraOutput& output_ : _extraOutputs )
+      {
+        _teeMuxer.openOutput ( output_.url, outCtx_, output_.format,
+                               _queueDepths[ENCODED_PACKETS],
+                               output_.dropWhenFull );
+      }
+      //Rotating a segment takes a while, it happens on its writer thread.
+      for ( auto& segmenter_ : _segmentMuxers )
+      {
+        segmenter_->setCodecContext ( outCtx_ );
+        _teeMuxer.addOutput ( segmenter_.get ( ), _queueDepths[ENCODED_PACKETS], false );
+      }
     }
+    _teeMuxer.setTimeBase ( outCtx_->time_base );
+    _teeMuxer.setStats ( _writeStats );
+    _teeMuxer.init ( );
+    _outputMuxer = &_teeMuxer;
+  }
 
-    _inAVFrame = av_frame_alloc ( );
-    if ( !_inAVFrame )
+  void FlowDeviceToVideoFile::logOutputs ( void )
+  {
+    for ( unsigned int i = 0; i < _teeMuxer.getNumOutputs ( ); ++i )
     {
-      av_packet_unref ( _inAVPacket );
-      av_packet_free ( &_inAVPacket );
-
-      av_packet_unref ( _outAVPacket );
-      av_packet_free ( &_outAVPacket );
+      StageStats* stats_ = _teeMuxer.getOutputStats ( i );
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                           "Output ", stats_->getName ( ),
+                                           ": ", stats_->getCount ( ),
+                                           " packets, mean ", stats_->getMean ( ),
+                                           " us, dropped ", _teeMuxer.getDropped ( i ),
+                                           _teeMuxer.isOutputActive ( i ) ? "" : ", failed" );
+    }
+    for ( auto& segmenter_ : _segmentMuxers )
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                           segmenter_->getPlaylistName ( ), ": ",
+                                           segmenter_->getNumSegments ( ),
+                                           " segments on disk (",
+                                           segmenter_->getDiskUsage ( ) / 1000000,
+                                           " MB), ", segmenter_->getNumDeleted ( ),
+                                           " deleted" );
+    }
+  }
 
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
-                                                                   "reserve "
-                                                                   "working "
-                                                                   "package." );
+  void FlowDeviceToVideoFile::setQueueDepth ( STAGE_QUEUE queue_,
+                                             unsigned int depth_ )
+  {
+    if ( queue_ < NUM_STAGE_QUEUES )
+    {
+      _queueDepths[queue_] = depth_ > 0 ? depth_ : 1;
     }
+  }
+
+  unsigned int FlowDeviceToVideoFile::getQueueDepth ( STAGE_QUEUE queue_ )
+  {
+    return queue_ < NUM_STAGE_QUEUES ? _queueDepths[queue_] : 0;
+  }
 
-    _outAVFrame = av_frame_alloc ( );
-    if ( !_outAVFrame )
+  unsigned int FlowDeviceToVideoFile::getQueueHighWaterMark ( STAGE_QUEUE queue_ )
+  {
+    switch ( queue_ )
     {
-      av_packet_unref ( _inAVPacket );
-      av_packet_free ( &_inAVPacket );
+      case CAPTURED_PACKETS:
+        return _capturedPackets ? _capturedPackets->getHighWaterMark ( ) : 0;
+      case DECODED_FRAMES:
+        return _decodedFrames ? _decodedFrames->getHighWaterMark ( ) : 0;
+      case CONVERTED_FRAMES:
+        return _convertedFrames ? _convertedFrames->getHighWaterMark ( ) : 0;
+      case ENCODED_PACKETS:
+        return _encodedPackets ? _encodedPackets->getHighWaterMark ( ) : 0;
+      default:
+        return 0;
+    }
+  }
 
-      av_packet_unref ( _outAVPacket );
-      av_packet_free ( &_outAVPacket );
+  void FlowDeviceToVideoFile::processStreams ( void )
+  {
+    runSteps ( );
 
-      av_frame_unref ( _inAVFrame );
-      av_frame_free ( &_inAVFrame );
+//    //Full video information!
+//    std::cout<<"Output file information :"<<std::endl;
+//    av_dump_format(_pOutFile->getFormatContext ( ) , 0 ,"output.mp4" ,1);
+  }
 
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
-                                                                   "reserve "
-                                                                   "working "
-                                                                   "frame." );
+  void FlowDeviceToVideoFile::prepare ( void )
+  {
+    if ( _outFile->isPassthrough ( ))
+    {
+      if ( !_extraOutputs.empty ( ))
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                             "Extra outputs need encoding, "
+                                             "ignored in stream copy." );
+      }
+    }
+    else
+    {
+      prepareMuxer ( );
     }
 
-    int nbytes =
-      av_image_get_buffer_size ( _outFile->getCodecContext ( )->pix_fmt,
-                                 _outFile->getCodecContext ( )->width,
-                                 _outFile->getCodecContext ( )->height, 32 );
+    if ( runPipelined ( ))
+    {
+      return;
+    }
 
-    _videoOutBuffer = ( uint8_t* ) av_malloc ( nbytes );
-    if ( !_videoOutBuffer )
+    _inAVPacket = _packetPool.getPacket ( );
+    _inAVFrame = _framePool.getFrame ( );
+    _outAVFrame = nullptr;
+    if ( !_inAVPacket || !_inAVFrame )
     {
-      av_packet_unref ( _inAVPacket );
-      av_packet_free ( &_inAVPacket );
+      releaseResources ( "Unable to reserve working package." );
+    }
 
-      av_packet_unref ( _outAVPacket );
-      av_packet_free ( &_outAVPacket );
+    _nextPts = 0;
 
-      av_frame_unref ( _inAVFrame );
-      av_frame_free ( &_inAVFrame );
+    if ( !_outFile->isPassthrough ( ))
+    {
+      _encoder.setCodecContext ( _outFile->getCodecContext ( ));
+      _encoder.setMuxer ( _outputMuxer );
+      _encoder.setStats ( _encodeStats );
+      _encoder.init ( );
+    }
+  }
 
-      av_frame_unref ( _outAVFrame );
-      av_frame_free ( &_outAVFrame );
+  Flow::STEP_RESULT FlowDeviceToVideoFile::step ( void )
+  {
+    if ( runPipelined ( ))
+    {
+      processStreamsPipelined ( );
+      return STEP_DONE;
+    }
 
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
-                                                                   "reserve "
-                                                                   "output "
-                                                                   "video "
-                                                                   "buffer. " );
+    if ( _numFrames == 0 )
+    {
+      return STEP_DONE;
     }
 
-    value = av_image_fill_arrays ( _outAVFrame->data,
-                                   _outAVFrame->linesize,
-                                   _videoOutBuffer,
-                                   AV_PIX_FMT_YUV420P,
-                                   _outFile->getCodecContext ( )->width,
-                                   _outFile->getCodecContext ( )->height,
-                                   1 );
+    StageTimer readTimer_ ( _readStats );
+    int value = av_read_frame ( _inDevice->getFormatContext ( ), _inAVPacket );
     if ( value < 0 )
     {
+      readTimer_.cancel ( );
+      return value == AVERROR( EAGAIN ) ? STEP_IDLE : STEP_DONE;
+    }
+    readTimer_.setBytes ( _inAVPacket->size );
+    readTimer_.stop ( );
+
+    if ( !_continuousExecution )
+    {
+      --_numFrames;
+    }
+
+    if ( _outFile->isPassthrough ( ))
+    {
+      if ( _inAVPacket->stream_index == _inDevice->getVideoStreamIndx ( ))
+      {
+        StageTimer writeTimer_ ( _writeStats );
+        writeTimer_.setBytes ( _inAVPacket->size );
+        if ( _outFile->writeSourcePacket ( _inAVPacket ) != 0 )
+        {
+          releaseResources ( "Error writing video frame." );
+        }
+      }
       av_packet_unref ( _inAVPacket );
-      av_packet_free ( &_inAVPacket );
+      return STEP_CONTINUE;
+    }
 
-      av_packet_unref ( _outAVPacket );
-      av_packet_free ( &_outAVPacket );
+    STEP_RESULT result_ = STEP_CONTINUE;
 
-      av_frame_unref ( _inAVFrame );
-      av_frame_free ( &_inAVFrame );
+    //#Packages could need multiple reading until a frame is generated (under testing)
+    if ( _inAVPacket->stream_index == _inDevice->getVideoStreamIndx ( ))
+    {
+      StageTimer decodeTimer_ ( _decodeStats );
+      decodeTimer_.setBytes ( _inAVPacket->size );
+      value = avcodec_send_packet ( _inDevice->getCodecContext ( ), _inAVPacket );
+      if ( value < 0 )
+      {
+        releaseResources ( "Unable to decode video." );
+      }
 
-      av_frame_unref ( _outAVFrame );
-      av_frame_free ( &_outAVFrame );
+      value = avcodec_receive_frame ( _inDevice->getCodecContext ( ), _inAVFrame );
+      decodeTimer_.stop ( );
+      if ( value == AVERROR( EAGAIN ))
+      {
+        //The decoder needs more packets.
+      }
+      else if ( value == AVERROR_EOF )
+      {
+        Utils::getInstance ( )
+          ->getLog ( ) ( LOG_LEVEL::INFO, "Error receiving frame." );
+        result_ = STEP_DONE;
+      }
+      else if ( value < 0 )
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                             "Legitimate decoding error:",
+                                             value );
+      }
+      else
+      {
+        //The encoder may keep a reference to the frame (B-frames), so every
+        //frame gets its own pooled buffer, returned once the encoder is done.
+        StageTimer convertTimer_ ( _convertStats );
+        _outAVFrame = _scaler.scale ( _inAVFrame,
+                                      _outFile->getCodecContext ( )->pix_fmt,
+                                      _outFile->getCodecContext ( )->width,
+                                      _outFile->getCodecContext ( )->height );
+        if ( !_outAVFrame )
+        {
+          releaseResources ( "Unable to reserve output video buffer. " );
+        }
+        _outAVFrame->pts = _nextPts++;
+        convertTimer_.setBytes ( av_image_get_buffer_size ( _outFile->getCodecContext ( )->pix_fmt,
+                                                            _outFile->getCodecContext ( )->width,
+                                                            _outFile->getCodecContext ( )->height,
+                                                            1 ));
+        convertTimer_.stop ( );
+
+        //Queued with a reference of its own, the packets are muxed by the
+        //encoder thread as the codec produces them.
+        _encoder.setFrames ( _outAVFrame );
+        _encoder.apply ( );
+        _framePool.releaseFrame ( _outAVFrame );
+      }
+    }
+    av_packet_unref ( _inAVPacket );
 
-      av_free ( _videoOutBuffer );
+    return result_;
+  }
 
-      Utils::getInstance ( )->getErrorManager ( )
-                            ->criticalError ( "Error filling image array. " );
+  void FlowDeviceToVideoFile::cleanup ( void )
+  {
+    if ( runPipelined ( ))
+    {
+      return;
     }
 
-    _swsCtx = sws_getContext ( _inDevice->getCodecContext ( )->width,
-                               _inDevice->getCodecContext ( )->height,
-                               _inDevice->getCodecContext ( )->pix_fmt,
-                               _outFile->getCodecContext ( )->width,
-                               _outFile->getCodecContext ( )->height,
-                               _outFile->getCodecContext ( )->pix_fmt,
-                               SWS_BICUBIC, nullptr, nullptr, nullptr );
+    //Waits for the queued frames and drains the delayed (B-frame) packets.
+    _encoder.flush ( );
+    int value = _outFile->isPassthrough ( )
+      ? av_write_trailer ( _outFile->getFormatContext ( ))
+      : _outputMuxer->writeTrailer ( );
     if ( value < 0 )
     {
-      av_packet_unref ( _inAVPacket );
-      av_packet_free ( &_inAVPacket );
+      releaseResources ( "Error writing output file." );
+    }
 
-      av_packet_unref ( _outAVPacket );
-      av_packet_free ( &_outAVPacket );
+    if ( !_outFile->isPassthrough ( ))
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                           "Encoded frames/packets: ",
+                                           _encoder.getNumFrames ( ), "/",
+                                           _encoder.getNumPackets ( ),
+                                           ", encoder queue high-water mark: ",
+                                           _encoder.getQueueHighWaterMark ( ));
+      logOutputs ( );
+    }
 
-      av_frame_unref ( _inAVFrame );
-      av_frame_free ( &_inAVFrame );
+    _packetPool.releasePacket ( _inAVPacket );
 
-      av_frame_unref ( _outAVFrame );
-      av_frame_free ( &_outAVFrame );
+    _framePool.releaseFrame ( _inAVFrame );
+    _framePool.releaseFrame ( _outAVFrame );
 
-      sws_freeContext ( _swsCtx );
+    logScalePaths ( );
+    logStageStats ( );
+    logPoolUsage ( );
+  }
 
-      av_free ( _videoOutBuffer );
+  void FlowDeviceToVideoFile::processStreamsPipelined ( void )
+  {
+    _capturedPackets.reset (
+      new SPSCQueue < AVPacket* > ( _queueDepths[CAPTURED_PACKETS] ));
+    _decodedFrames.reset (
+      new SPSCQueue < AVFrame* > ( _queueDepths[DECODED_FRAMES] ));
+    _convertedFrames.reset (
+      new SPSCQueue < AVFrame* > ( _queueDepths[CONVERTED_FRAMES] ));
+    _encodedPackets.reset (
+      new SPSCQueue < AVPacket* > ( _queueDepths[ENCODED_PACKETS] ));
+
+    //Each stage runs on its own thread, so the sustained throughput is the
+    //one of the slowest stage instead of the sum of all of them.
+    std::thread capture_ ( &FlowDeviceToVideoFile::captureStage, this );
+    std::thread decode_ ( &FlowDeviceToVideoFile::decodeStage, this );
+    std::thread convert_ ( &FlowDeviceToVideoFile::convertStage, this );
+    std::thread encode_ ( &FlowDeviceToVideoFile::encodeStage, this );
+    std::thread mux_ ( &FlowDeviceToVideoFile::muxStage, this );
+
+    capture_.join ( );
+    decode_.join ( );
+    convert_.join ( );
+    encode_.join ( );
+    mux_.join ( );
+
+    logScalePaths ( );
 
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
-                                                                   "reserve "
-                                                                   "resources "
-                                                                   "for "
-                                                                   "context. " );
-    }
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Queue high-water marks (captured, "
+                                         "decoded, converted, encoded): ",
+                                         getQueueHighWaterMark ( CAPTURED_PACKETS ),
+                                         "/", _queueDepths[CAPTURED_PACKETS], " ",
+                                         getQueueHighWaterMark ( DECODED_FRAMES ),
+                                         "/", _queueDepths[DECODED_FRAMES], " ",
+                                         getQueueHighWaterMark ( CONVERTED_FRAMES ),
+                                         "/", _queueDepths[CONVERTED_FRAMES], " ",
+                                         getQueueHighWaterMark ( ENCODED_PACKETS ),
+                                         "/", _queueDepths[ENCODED_PACKETS] );
+    logStageStats ( );
+    logPoolUsage ( );
+  }
 
-    //#Packages could need multiple reading until a frame is generated (under testing)
-    //int how_many_packets_to_process = 8;
-    unsigned int j = 0;
-    while (
-      ( av_read_frame ( _inDevice->getFormatContext ( ), _inAVPacket ) >= 0 )
-        && ( _numFrames > 0 ))
+  void FlowDeviceToVideoFile::captureStage ( void )
+  {
+    while (( _numFrames > 0 ) && !_stop )
     {
+      AVPacket* packet_ = _packetPool.getPacket ( );
+      if ( !packet_ )
+      {
+        Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
+                                                                     "reserve "
+                                                                     "working "
+                                                                     "package." );
+      }
+
+      StageTimer readTimer_ ( _readStats );
+      int value = av_read_frame ( _inDevice->getFormatContext ( ), packet_ );
+      if ( value == AVERROR( EAGAIN ))
+      {
+        readTimer_.cancel ( );
+        _packetPool.releasePacket ( packet_ );
+        std::this_thread::sleep_for ( std::chrono::milliseconds ( 1 ));
+        continue;
+      }
+      else if ( value < 0 )
+      {
+        readTimer_.cancel ( );
+        _packetPool.releasePacket ( packet_ );
+        break;
+      }
+      readTimer_.setBytes ( packet_->size );
+      readTimer_.stop ( );
+
       if ( !_continuousExecution )
       {
         --_numFrames;
       }
 
-      if ( _inAVPacket->stream_index == _inDevice->getVideoStreamIndx ( ))
-        //&& (--how_many_packets_to_process < 0)
+      if (( packet_->stream_index != _inDevice->getVideoStreamIndx ( ))
+        || !_capturedPackets->push ( packet_ ))
+      {
+        _packetPool.releasePacket ( packet_ );
+      }
+    }
+
+    _capturedPackets->close ( );
+  }
+
+  void FlowDeviceToVideoFile::decodeStage ( void )
+  {
+    AVCodecContext* codecCtx_ = _inDevice->getCodecContext ( );
+    AVPacket* packet_ = nullptr;
+    bool flushing_ = false;
+    int value = 0;
+
+    while ( !flushing_ )
+    {
+      //Only the time spent in the decoder, not waiting on the queues.
+      StageStats::Clock::time_point start_ = StageStats::Clock::now ( );
+      StageStats::Clock::duration busy_ = StageStats::Clock::duration::zero ( );
+      std::size_t bytes_ = 0;
+
+      if ( _capturedPackets->pop ( packet_ ))
       {
-        value = avcodec_send_packet ( _inDevice->getCodecContext ( ), _inAVPacket );
+        start_ = StageStats::Clock::now ( );
+        bytes_ = packet_->size;
+        value = avcodec_send_packet ( codecCtx_, packet_ );
+        busy_ += StageStats::Clock::now ( ) - start_;
+        _packetPool.releasePacket ( packet_ );
         if ( value < 0 )
         {
-          releaseResources ( "Unable to decode video." );
+          Utils::getInstance ( )->getErrorManager ( )
+                                ->criticalError ( "Unable to decode video." );
         }
+      }
+      else
+      {
+        //Capture finished, drain the frames still buffered in the decoder.
+        avcodec_send_packet ( codecCtx_, nullptr );
+        flushing_ = true;
+      }
 
-        value = avcodec_receive_frame ( _inDevice->getCodecContext ( ), _inAVFrame );
-        if ( value == AVERROR( EAGAIN ) || value == AVERROR_EOF)
+      while ( true )
+      {
+        AVFrame* frame_ = _framePool.getFrame ( );
+        if ( !frame_ )
         {
-          Utils::getInstance ( )
-            ->getLog ( ) ( LOG_LEVEL::INFO, "Error receiving frame." );
-          break;
+          Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
+                                                                       "reserve "
+                                                                       "working "
+                                                                       "frame." );
         }
-        else if ( value < 0 )
+
+        start_ = StageStats::Clock::now ( );
+        value = avcodec_receive_frame ( codecCtx_, frame_ );
+        busy_ += StageStats::Clock::now ( ) - start_;
+        if ( value < 0 )
         {
-          Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
-                                               "Legitimate decoding error:",
-                                               value );
+          _framePool.releaseFrame ( frame_ );
+          if ( value != AVERROR( EAGAIN ) && value != AVERROR_EOF )
+          {
+            Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                                 "Legitimate decoding error:",
+                                                 value );
+          }
+          break;
         }
-        else
+
+        if ( !_decodedFrames->push ( frame_ ))
         {
-          sws_scale ( _swsCtx,
-                      _inAVFrame->data,
-                      _inAVFrame->linesize,
-                      0,
-                      _inDevice->getCodecContext ( )->height,
-                      _outAVFrame->data,
-                      _outAVFrame->linesize );
+          _framePool.releaseFrame ( frame_ );
+        }
+      }
 
-          av_init_packet ( _outAVPacket );
-          _outAVPacket->data = nullptr;
-          _outAVPacket->size = 0;
+      if ( !flushing_ )
+      {
+        _decodeStats->record ( busy_, bytes_ );
+      }
+    }
 
-          //avcodec_encode_video2 ( _pOutFile->getCodecContext ( ), _outAVPacket, _outAVFrame, &got_picture );
+    _decodedFrames->close ( );
+  }
 
-          avcodec_send_frame ( _outFile->getCodecContext ( ), _outAVFrame );
-          avcodec_receive_packet ( _outFile->getCodecContext ( ), _outAVPacket );
+  void FlowDeviceToVideoFile::convertStage ( void )
+  {
+    AVCodecContext* outCtx_ = _outFile->getCodecContext ( );
+    AVFrame* frame_ = nullptr;
+    int64_t pts_ = 0;
 
-          if ( _outAVPacket->pts != AV_NOPTS_VALUE)
-          {
-            _outAVPacket->pts = av_rescale_q ( _outAVPacket->pts,
-                                               _outFile->getCodecContext ( )
-                                                        ->time_base,
-                                               _outFile->getVideoStream ( )
-                                                        ->time_base );
-          }
-          if ( _outAVPacket->dts != AV_NOPTS_VALUE)
-          {
-            _outAVPacket->dts = av_rescale_q ( _outAVPacket->dts,
-                                               _outFile->getCodecContext ( )
-                                                        ->time_base,
-                                               _outFile->getVideoStream ( )
-                                                        ->time_base );
-          }
-          Utils::getInstance ( )
-            ->getLog ( ) ( LOG_LEVEL::INFO,
-                           "Write frame ",
-                           ++j,
-                           " -> size: ",
-                           _outAVPacket->size/1000 );
-
-          if ( av_write_frame ( _outFile->getFormatContext ( ), _outAVPacket ) != 0 )
-          {
-            releaseResources ( "Error writing video frame." );
-          }
+    int frameBytes_ = av_image_get_buffer_size ( outCtx_->pix_fmt,
+                                                 outCtx_->width,
+                                                 outCtx_->height,
+                                                 1 );
 
-          av_packet_unref ( _outAVPacket );
-          av_packet_unref ( _outAVPacket );
-        }
+    while ( _decodedFrames->pop ( frame_ ))
+    {
+      StageTimer convertTimer_ ( _convertStats );
+      convertTimer_.setBytes ( frameBytes_ );
+      AVFrame* outFrame_ = _scaler.scale ( frame_,
+                                           outCtx_->pix_fmt,
+                                           outCtx_->width,
+                                           outCtx_->height );
+      if ( !outFrame_ )
+      {
+        Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
+                                                                     "reserve "
+                                                                     "output "
+                                                                     "video "
+                                                                     "buffer. " );
+      }
+      outFrame_->pts = pts_++;
+      convertTimer_.stop ( );
+
+      _framePool.releaseFrame ( frame_ );
+
+      if ( !_convertedFrames->push ( outFrame_ ))
+      {
+        _framePool.releaseFrame ( outFrame_ );
       }
     }
 
-    value = av_write_trailer ( _outFile->getFormatContext ( ));
-    if ( value < 0 )
+    _convertedFrames->close ( );
+  }
+
+  void FlowDeviceToVideoFile::encodeStage ( void )
+  {
+    AVCodecContext* outCtx_ = _outFile->getCodecContext ( );
+    AVFrame* frame_ = nullptr;
+    bool flushing_ = false;
+    int value = 0;
+
+    while ( !flushing_ )
     {
-      releaseResources ( "Error writing output file." );
-    }
+      StageStats::Clock::time_point start_ = StageStats::Clock::now ( );
+      StageStats::Clock::duration busy_ = StageStats::Clock::duration::zero ( );
+      std::size_t bytes_ = 0;
 
-    av_packet_unref ( _inAVPacket );
-    av_packet_free ( &_inAVPacket );
+      if ( _convertedFrames->pop ( frame_ ))
+      {
+        start_ = StageStats::Clock::now ( );
+        value = avcodec_send_frame ( outCtx_, frame_ );
+        busy_ += StageStats::Clock::now ( ) - start_;
+        _framePool.releaseFrame ( frame_ );
+        if ( value < 0 )
+        {
+          Utils::getInstance ( )->getErrorManager ( )
+                                ->criticalError ( "Unable to encode video." );
+        }
+      }
+      else
+      {
+        //No more frames, flush the delayed (B-frame) packets.
+        avcodec_send_frame ( outCtx_, nullptr );
+        flushing_ = true;
+      }
 
-    av_packet_unref ( _outAVPacket );
-    av_packet_free ( &_outAVPacket );
+      //One frame may produce none or several packets, take all of them.
+      while ( true )
+      {
+        AVPacket* packet_ = _packetPool.getPacket ( );
+        if ( !packet_ )
+        {
+          Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
+                                                                       "reserve "
+                                                                       "working "
+                                                                       "package." );
+        }
 
-    av_frame_unref ( _inAVFrame );
-    av_frame_free ( &_inAVFrame );
+        start_ = StageStats::Clock::now ( );
+        value = avcodec_receive_packet ( outCtx_, packet_ );
+        busy_ += StageStats::Clock::now ( ) - start_;
+        if ( value < 0 )
+        {
+          _packetPool.releasePacket ( packet_ );
+          break;
+        }
 
-    av_frame_unref ( _outAVFrame );
-    av_frame_free ( &_outAVFrame );
+        bytes_ += packet_->size;
+        if ( !_encodedPackets->push ( packet_ ))
+        {
+          _packetPool.releasePacket ( packet_ );
+        }
+      }
 
-    sws_freeContext ( _swsCtx );
+      if ( !flushing_ )
+      {
+        _encodeStats->record ( busy_, bytes_ );
+      }
+    }
 
-    av_free ( _videoOutBuffer );
+    _encodedPackets->close ( );
+  }
 
-//    //Full video information!
-//    std::cout<<"Output file information :"<<std::endl;
-//    av_dump_format(_pOutFile->getFormatContext ( ) , 0 ,"output.mp4" ,1);
+  void FlowDeviceToVideoFile::muxStage ( void )
+  {
+    AVPacket* packet_ = nullptr;
+
+    //No log per packet, this thread has to keep up with the encoder. The
+    //muxer records the write stats.
+    while ( _encodedPackets->pop ( packet_ ))
+    {
+      if ( _outputMuxer->writePacket ( packet_ ) != 0 )
+      {
+        Utils::getInstance ( )->getErrorManager ( )
+                              ->criticalError ( "Error writing video frame." );
+      }
+
+      _packetPool.releasePacket ( packet_ );
+    }
+
+    if ( _outputMuxer->writeTrailer ( ) < 0 )
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Error writing output file." );
+    }
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Wrote ", _outputMuxer->getNumPackets ( ),
+                                         " packets, ", _outputMuxer->getNumBytes ( ) / 1000,
+                                         " kB." );
+    logOutputs ( );
+  }
+
+  void FlowDeviceToVideoFile::logScalePaths ( void )
+  {
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Frames bypassed/converted/resampled: ",
+                                         _scaler.getCount ( FrameScaler::BYPASS ), "/",
+                                         _scaler.getCount ( FrameScaler::CONVERT ), "/",
+                                         _scaler.getCount ( FrameScaler::RESAMPLE ));
   }
 }
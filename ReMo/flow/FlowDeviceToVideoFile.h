@@ -22,16 +22,34 @@
 #define REMO_FLOW_DEVICETOVIDEOFILE_H
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "Flow.h"
 #include "../stream/StreamDeviceIn.h"
 #include "../stream/StreamVideoFileOut.h"
+#include "../util/SPSCQueue.h"
+#include "../util/FrameScaler.h"
+#include "../pipeline/Encoder.h"
+#include "../pipeline/Muxer.h"
+#include "../pipeline/SegmentMuxer.h"
+#include "../pipeline/TeeMuxer.h"
 
 namespace remo
 {
   class FlowDeviceToVideoFile: public Flow
   {
     public:
+      //Queues between the stages of the pipelined execution mode.
+      enum STAGE_QUEUE
+      {
+        CAPTURED_PACKETS = 0,
+        DECODED_FRAMES,
+        CONVERTED_FRAMES,
+        ENCODED_PACKETS,
+        NUM_STAGE_QUEUES
+      };
+
       FlowDeviceToVideoFile ( Stream* inStream_,
                               Stream* outStream_,
                               bool continuousExecution_ = false,
@@ -41,27 +59,108 @@ namespace remo
       virtual void init ( void );
       virtual void processStreams ( void );
 
+      //The pipelined execution runs as a single step on its own threads.
+      virtual void prepare ( void );
+      virtual STEP_RESULT step ( void );
+      virtual void cleanup ( void );
+
       void setNumFramesToCapture ( unsigned int numFrames_ )
       {
         _numFrames = numFrames_;
       };
 
+      //Runs capture, decode, convert, encode and mux on their own threads.
+      //Started on an executor it still takes one of its threads, in a
+      //single step, until the capture ends.
+      void setPipelinedExecution ( bool pipelined_ ) { _pipelined = pipelined_; }
+      bool isPipelinedExecution ( void ) { return _pipelined; }
+      virtual bool runsOwnThreads ( void ) { return runPipelined ( ); }
+
+      //Writes the encoded stream to url_ too (udp://, rtp://, pipe:1...)
+      //without encoding it again, the container is guessed from url_ when
+      //format_ is empty. Set before running the flow, not in stream copy.
+      void addOutput ( const std::string& url_,
+                       const std::string& format_ = "",
+                       bool dropWhenFull_ = true );
+
+      //Records the encoded stream too as a rolling sequence of segments,
+      //prefix_000001.ts..., with the HLS playlist prefix_.m3u8. A new
+      //segment starts on the first keyframe after segmentSeconds_ or
+      //segmentBytes_ (0 no limit). The oldest closed segments are deleted
+      //above quotaBytes_ (0 keeps all), so the segment being written can
+      //take the disk use over it by up to one segment. Set before running
+      //the flow, not in stream copy.
+      void addSegmentedOutput ( const std::string& prefix_,
+                                double segmentSeconds_ = 10.0,
+                                uint64_t segmentBytes_ = 0,
+                                uint64_t quotaBytes_ = 0,
+                                const std::string& extension_ = "ts" );
+
+      void setQueueDepth ( STAGE_QUEUE queue_, unsigned int depth_ );
+      unsigned int getQueueDepth ( STAGE_QUEUE queue_ );
+      //Maximum number of items stored in the queue during the last run.
+      unsigned int getQueueHighWaterMark ( STAGE_QUEUE queue_ );
+
     private:
       void releaseResources ( const std::string& msg_ );
 
+      void processStreamsPipelined ( void );
+      void captureStage ( void );
+      void decodeStage ( void );
+      void convertStage ( void );
+      void encodeStage ( void );
+      void muxStage ( void );
+      void logScalePaths ( void );
+      //Muxer the encoded packets go to, the tee one with extra outputs.
+      void prepareMuxer ( void );
+      void logOutputs ( void );
+      //Stream copy does not decode nor encode, it always runs sequentially.
+      bool runPipelined ( void ) { return _pipelined && !_outFile->isPassthrough ( ); }
+
       unsigned int _continuousExecution;
       unsigned int _numFrames;
-      uint8_t* _videoOutBuffer;
+      int64_t _nextPts;
+
+      StageStats* _readStats;
+      StageStats* _decodeStats;
+      StageStats* _convertStats;
+      StageStats* _encodeStats;
+      StageStats* _writeStats;
 
-      SwsContext* _swsCtx;
+      //Skips the resample (or the whole conversion) when the capture
+      //already matches the encoder input.
+      FrameScaler _scaler;
 
       StreamDeviceIn* _inDevice;
       StreamVideoFileOut* _outFile;
 
       AVPacket* _inAVPacket;
-      AVPacket* _outAVPacket;
       AVFrame* _inAVFrame;
       AVFrame* _outAVFrame;
+
+      //Sequential execution: the encoder runs on its own thread and muxes
+      //every packet, so encoding overlaps with capture and conversion.
+      Muxer _muxer;
+      Encoder _encoder;
+
+      struct ExtraOutput
+      {
+        std::string url;
+        std::string format;
+        bool dropWhenFull;
+      };
+      std::vector < ExtraOutput > _extraOutputs;
+      std::vector < std::unique_ptr < SegmentMuxer > > _segmentMuxers;
+      TeeMuxer _teeMuxer;
+      Muxer* _outputMuxer;
+
+      bool _pipelined;
+      unsigned int _queueDepths[NUM_STAGE_QUEUES];
+
+      std::unique_ptr < SPSCQueue < AVPacket* > > _capturedPackets;
+      std::unique_ptr < SPSCQueue < AVFrame* > > _decodedFrames;
+      std::unique_ptr < SPSCQueue < AVFrame* > > _convertedFrames;
+      std::unique_ptr < SPSCQueue < AVPacket* > > _encodedPackets;
   };
 }
 
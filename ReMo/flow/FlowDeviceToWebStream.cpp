@@ -20,7 +20,6 @@
 
 #ifdef REMO_USE_WEBSTREAMER
 
-#include <thread>
 #include <libavformat/version.h>
 
 #include "FlowDeviceToWebStream.h"
@@ -31,8 +30,17 @@ namespace remo
   FlowDeviceToWebStream::FlowDeviceToWebStream ( Stream* inStream_,
                                                  Stream* outStream_)
     : Flow ( inStream_, outStream_ ),
-    _stop ( false )
+    _packetsToSkip ( 8 ),
+    _packet ( nullptr ),
+    _frame ( nullptr ),
+    _frameProc ( nullptr )
   {
+    _readStats = addStage ( "read" );
+    _decodeStats = addStage ( "decode" );
+    _processStats = addStage ( "process" );
+    _pushStats = addStage ( "push" );
+
+    _description = "Device to Web Stream Flow";
     _inDevice = static_cast<StreamDeviceIn*>( _inStream );
     _outWebStreamer = static_cast<StreamWebStreamer*>( _outStream );
 
@@ -80,144 +88,150 @@ namespace remo
 
     Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
                                          "All streams has been init succesfully." );
-
-    if ( _ffPipeline != nullptr )
-    {
-      _ffPipeline->connectFramesAndPackages ( _frame, _frameProc, _packet );
-    }
   }
 
   void FlowDeviceToWebStream::releaseResources ( const std::string& msg_ )
   {
-    av_packet_unref ( _packet );
-    av_packet_free ( &_packet );
+    _packetPool.releasePacket ( _packet );
 
-    av_frame_unref ( _frame );
-    av_frame_free ( &_frame );
-
-    av_frame_unref ( _frameProc );
-    av_frame_free ( &_frameProc );
+    _framePool.releaseFrame ( _frame );
+    _framePool.releaseFrame ( _frameProc );
 
     Utils::getInstance ( )->getErrorManager ( )->criticalError ( msg_ );
   }
 
   void FlowDeviceToWebStream::processStreams ( void )
   {
-    /*
-    std::thread th_ ( &FlowDeviceToWebStream::loop, this );
-    th_.detach ( ); 
-
-    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
-                                         "Press any key to finish the thread!." );
-    std::cin.get ( );
-    _stop = true;
-    */
-
-    loop ( );
+    runSteps ( );
   }
 
-  void FlowDeviceToWebStream::loop ( void )
+  void FlowDeviceToWebStream::prepare ( void )
   {
-    int value = 0;
-
     avformat_version ( );
 
-    _packet = av_packet_alloc ( );
-    if ( !_packet )
-    {
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to"
-                                                                   "reserve "
-                                                                   "resources "
-                                                                   "fo working "
-                                                                   "packet." );
-    }
-
-    _frame = av_frame_alloc ( );
-    if ( !_frame )
+    _packet = _packetPool.getPacket ( );
+    _frame = _framePool.getFrame ( );
+    _frameProc = _framePool.getFrame ( );
+    if ( !_packet || !_frame || !_frameProc )
     {
-      av_packet_unref ( _packet );
-      av_packet_free ( &_packet );
+      _packetPool.releasePacket ( _packet );
+      _framePool.releaseFrame ( _frame );
+      _framePool.releaseFrame ( _frameProc );
       Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
                                                                    "reserve "
                                                                    "resources "
                                                                    "for "
                                                                    "working "
-                                                                   "frame." );
+                                                                   "frames." );
     }
 
-    _frameProc = av_frame_alloc ( );
-    if ( !_frameProc )
+    //The working frames only exist from here on.
+    if ( _ffPipeline != nullptr )
     {
-      av_packet_unref ( _packet );
-      av_packet_free ( &_packet );
-      av_frame_unref ( _frame );
-      av_frame_free ( &_frame );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
-                                                                   "reserve "
-                                                                   "resources "
-                                                                   "for "
-                                                                   "working "
-                                                                   "YUVframe.");
+      _ffPipeline->connectFramesAndPackages ( _frame, _frameProc, _packet );
+      _ffPipeline->init ( );
     }
 
-    int actNumFrames = 0;
-    int how_many_packets_to_process = 8;
+    _packetsToSkip = 8;
+  }
 
-    while ( !_stop )
+  Flow::STEP_RESULT FlowDeviceToWebStream::step ( void )
+  {
+    StageTimer readTimer_ ( _readStats );
+    int value = av_read_frame ( _inDevice->getFormatContext ( ), _packet );
+    if ( value < 0 )
+    {
+      readTimer_.cancel ( );
+    }
+    else
     {
-      //Not needed!
-      //if (_outWebStreamer->isSync ()) continue;
+      readTimer_.setBytes ( _packet->size );
+      readTimer_.stop ( );
+    }
+    if ( value == AVERROR( EAGAIN ))
+    {
+      return STEP_IDLE;
+    }
+    else if ( value < 0 )
+    {
+      return value == AVERROR_EOF ? STEP_DONE : STEP_CONTINUE;
+    }
+
+    STEP_RESULT result_ = STEP_CONTINUE;
+    if (( _packet->stream_index == _inDevice->getVideoStreamIndx ( ))
+      && ( --_packetsToSkip < 0 ))
+    {
+      StageTimer decodeTimer_ ( _decodeStats );
+      decodeTimer_.setBytes ( _packet->size );
+      value = avcodec_send_packet ( _inDevice->getCodecContext ( ), _packet );
+      if ( value < 0 )
+      {
+        releaseResources ( "Unable to decode video." );
+      }
 
-      if ( av_read_frame ( _inDevice->getFormatContext ( ), _packet ) >= 0 )
+      value = avcodec_receive_frame ( _inDevice->getCodecContext ( ), _frame );
+      decodeTimer_.stop ( );
+
+      if ( value == AVERROR( EAGAIN ))
+      {
+        //The decoder needs more packets.
+      }
+      else if ( value == AVERROR_EOF )
+      {
+        Utils::getInstance ( )
+          ->getLog ( ) ( LOG_LEVEL::INFO, "Error receiving frame." );
+        result_ = STEP_DONE;
+      }
+      else if ( value < 0 )
       {
-        if (( _packet->stream_index == _inDevice->getVideoStreamIndx ( ))
-          && ( --how_many_packets_to_process < 0 ))
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                             "Legitimate decoding error:",
+                                             value );
+      }
+      else
+      {
+        bool ready_ = true;
+        if ( _ffPipeline != nullptr )
+        {
+          StageTimer processTimer_ ( _processStats );
+          //A threaded pipeline may still hold the frame.
+          ready_ = _ffPipeline->process ( );
+        }
+        if ( ready_ )
         {
-          value = avcodec_send_packet ( _inDevice->getCodecContext ( ), _packet );
-          if ( value < 0 )
-          {
-            releaseResources ( "Unable to decode video." );
-          }
-
-          value = avcodec_receive_frame ( _inDevice->getCodecContext ( ), _frame );
-
-          if ( value == AVERROR( EAGAIN ) || value == AVERROR_EOF)
-          {
-            Utils::getInstance ( )
-              ->getLog ( ) ( LOG_LEVEL::INFO, "Error receiving frame." );
-            break;
-          }
-          else if ( value < 0 )
-          {
-            Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
-                                                 "Legitimate decoding error:",
-                                                 value );
-          }
-          else
-          {
-            if ( _ffPipeline != nullptr )
-            {
-              _ffPipeline->process ( );
-            }
-            _outWebStreamer->pushFrame (_frame);
-            ++actNumFrames;
-          }
+          StageTimer pushTimer_ ( _pushStats );
+          _outWebStreamer->pushFrame (_frame);
         }
       }
-      av_packet_unref ( _packet );
     }
-    av_packet_free ( &_packet );
-
-    av_frame_unref ( _frame );
-    av_frame_free ( &_frame );
+    av_packet_unref ( _packet );
 
-    av_frame_unref ( _frameProc );
-    av_frame_free ( &_frameProc );
+    return result_;
   }
 
-  void FlowDeviceToWebStream::finish ( )
+  void FlowDeviceToWebStream::cleanup ( void )
   {
-    _stop = true;
+    if ( _ffPipeline != nullptr )
+    {
+      _ffPipeline->stop ( );
+    }
+
+    _packetPool.releasePacket ( _packet );
+
+    _framePool.releaseFrame ( _frame );
+    _framePool.releaseFrame ( _frameProc );
+
+    _outWebStreamer->stop ( );
+    FramePacer& pacer_ = _outWebStreamer->getFramePacer ( );
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Frame pacing at ", pacer_.getFps ( ),
+                                         " fps, delivered: ", pacer_.getDelivered ( ),
+                                         ", dropped: ", pacer_.getDropped ( ),
+                                         ", duplicated: ", pacer_.getDuplicated ( ),
+                                         ", late: ", pacer_.getLate ( ));
+
+    logStageStats ( );
+    logPoolUsage ( );
   }
 }
 
@@ -41,10 +41,13 @@ namespace remo
       virtual ~FlowDeviceToWebStream ( void ) = default;
 
       virtual void init ( void );
+      //Runs until finish ( ) is called, use start ( ) to run it
+      //asynchronously.
       virtual void processStreams ( void );
-      virtual void finish ( void );
 
-      void loop ( );
+      virtual void prepare ( void );
+      virtual STEP_RESULT step ( void );
+      virtual void cleanup ( void );
 
     private:
       void releaseResources ( const std::string& msg_ );
@@ -52,8 +55,13 @@ namespace remo
       StreamDeviceIn* _inDevice;
       StreamWebStreamer* _outWebStreamer;
 
-      bool _stop;
- 
+      int _packetsToSkip;
+
+      StageStats* _readStats;
+      StageStats* _decodeStats;
+      StageStats* _processStats;
+      StageStats* _pushStats;
+
       AVPacket* _packet;
       AVFrame* _frame;
 
@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <thread>
+
+#include "FlowGraph.h"
+#include "../util/SPSCQueue.h"
+#include "../util/FrameScaler.h"
+#include "../util/ParallelScaler.h"
+#include "../util/Utils.h"
+#include "../pipeline/Encoder.h"
+#include "../pipeline/Muxer.h"
+
+#ifdef REMO_USE_SDL
+#include "../stream/StreamSDLViewerOut.h"
+#include "../media/MediaSDLViewer.h"
+#endif
+
+#ifdef REMO_USE_WEBSTREAMER
+#include "../stream/StreamWebStreamer.h"
+#endif
+
+namespace remo
+{
+  //One output of the graph: a thread consuming frame references from a queue.
+  class FlowBranch
+  {
+    public:
+      FlowBranch ( FramePool& framePool_,
+                   unsigned int queueDepth_,
+                   bool dropWhenFull_ )
+        : _framePool ( framePool_ )
+        , _queue ( queueDepth_ )
+        , _dropWhenFull ( dropWhenFull_ )
+        , _dropped ( 0 )
+      {
+      }
+
+      virtual ~FlowBranch ( void ) = default;
+
+      void start ( void )
+      {
+        _thread = std::thread ( &FlowBranch::run, this );
+      }
+
+      //Lets the branch consume the queued frames and waits for it.
+      void stop ( void )
+      {
+        _queue.close ( );
+        if ( _thread.joinable ( ))
+        {
+          _thread.join ( );
+        }
+      }
+
+      //Takes ownership of the frame reference unless it returns false.
+      bool push ( AVFrame* frame_ )
+      {
+        bool pushed_ = _dropWhenFull ? _queue.tryPush ( frame_ )
+                                     : _queue.push ( frame_ );
+        if ( !pushed_ )
+        {
+          ++_dropped;
+        }
+        return pushed_;
+      }
+
+      unsigned long getDropped ( void ) { return _dropped; }
+
+    protected:
+      virtual void consume ( AVFrame* frame_ ) = 0;
+      virtual void flush ( void ) { }
+
+      FramePool& _framePool;
+
+    private:
+      void run ( void )
+      {
+        AVFrame* frame_ = nullptr;
+        while ( _queue.pop ( frame_ ))
+        {
+          consume ( frame_ );
+          _framePool.releaseFrame ( frame_ );
+        }
+        flush ( );
+      }
+
+      SPSCQueue < AVFrame* > _queue;
+      bool _dropWhenFull;
+      std::atomic < unsigned long > _dropped;
+      std::thread _thread;
+  };
+
+  class VideoFileBranch: public FlowBranch
+  {
+    public:
+      VideoFileBranch ( StreamVideoFileOut* outFile_,
+                        FramePool& framePool_,
+                        unsigned int queueDepth_,
+                        bool dropWhenFull_ )
+        : FlowBranch ( framePool_, queueDepth_, dropWhenFull_ )
+        , _outFile ( outFile_ )
+        , _scaler ( framePool_ )
+        , _pts ( 0 )
+      {
+        AVCodecContext* outCtx_ = _outFile->getCodecContext ( );
+        _muxer.setOutput ( _outFile->getFormatContext ( ),
+                           _outFile->getVideoStream ( ),
+                           outCtx_->time_base );
+        _muxer.init ( );
+
+        //The branch already runs on its own thread.
+        _encoder.setCodecContext ( outCtx_ );
+        _encoder.setMuxer ( &_muxer );
+        _encoder.setOption ( "threaded", "0" );
+        _encoder.init ( );
+      }
+
+    protected:
+      virtual void consume ( AVFrame* frame_ )
+      {
+        AVCodecContext* outCtx_ = _outFile->getCodecContext ( );
+
+        AVFrame* outFrame_ = _scaler.scale ( frame_,
+                                             outCtx_->pix_fmt,
+                                             outCtx_->width,
+                                             outCtx_->height );
+        if ( !outFrame_ )
+        {
+          Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
+                                                                       "reserve "
+                                                                       "output "
+                                                                       "video "
+                                                                       "buffer. " );
+        }
+
+        outFrame_->pts = _pts++;
+
+        _encoder.setFrames ( outFrame_ );
+        _encoder.apply ( );
+        _framePool.releaseFrame ( outFrame_ );
+      }
+
+      virtual void flush ( void )
+      {
+        _encoder.flush ( );
+        if ( _muxer.writeTrailer ( ) < 0 )
+        {
+          Utils::getInstance ( )->getErrorManager ( )
+                                ->criticalError ( "Error writing output file." );
+        }
+      }
+
+    private:
+      StreamVideoFileOut* _outFile;
+      FrameScaler _scaler;
+      int64_t _pts;
+      Muxer _muxer;
+      Encoder _encoder;
+  };
+
+#ifdef REMO_USE_SDL
+  class SDLViewerBranch: public FlowBranch
+  {
+    public:
+      SDLViewerBranch ( StreamSDLViewerOut* outViewer_,
+                        FramePool& framePool_,
+                        unsigned int queueDepth_,
+                        bool dropWhenFull_ )
+        : FlowBranch ( framePool_, queueDepth_, dropWhenFull_ )
+        , _media ( static_cast<MediaSDLViewer*>( outViewer_->getMedia ( )))
+        , _frameYUV ( framePool_.getFrame ( ))
+      {
+      }
+
+      virtual ~SDLViewerBranch ( void )
+      {
+        _framePool.releaseFrame ( _frameYUV );
+      }
+
+    protected:
+      virtual void consume ( AVFrame* frame_ )
+      {
+        //draw ( ) points _frameYUV to the overlay pixels.
+        _media->draw ( _frameYUV );
+        if ( !_scaler.scale ( frame_->data,
+                              frame_->linesize,
+                              frame_->width,
+                              frame_->height,
+                              static_cast<AVPixelFormat>( frame_->format ),
+                              _frameYUV->data,
+                              _frameYUV->linesize,
+                              _media->getOverlayWidth ( ),
+                              _media->getOverlayHeigh ( ),
+                              AV_PIX_FMT_YUV420P,
+                              SWS_BILINEAR ))
+        {
+          Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
+                                                                       "scale "
+                                                                       "frame." );
+        }
+      }
+
+    private:
+      MediaSDLViewer* _media;
+      AVFrame* _frameYUV;
+      ParallelScaler _scaler;
+  };
+#endif //REMO_USE_SDL
+
+#ifdef REMO_USE_WEBSTREAMER
+  class WebStreamBranch: public FlowBranch
+  {
+    public:
+      WebStreamBranch ( StreamWebStreamer* outWebStreamer_,
+                        FramePool& framePool_,
+                        unsigned int queueDepth_,
+                        bool dropWhenFull_ )
+        : FlowBranch ( framePool_, queueDepth_, dropWhenFull_ )
+        , _outWebStreamer ( outWebStreamer_ )
+      {
+      }
+
+    protected:
+      virtual void consume ( AVFrame* frame_ )
+      {
+        _outWebStreamer->pushFrame ( frame_ );
+      }
+
+    private:
+      StreamWebStreamer* _outWebStreamer;
+  };
+#endif //REMO_USE_WEBSTREAMER
+
+  FlowGraph::FlowGraph ( Stream* inStream_,
+                         bool continuousExecution_,
+                         unsigned int numFrames_ )
+    : Flow ( inStream_, nullptr ),
+    _continuousExecution ( continuousExecution_ ),
+    _numFrames ( numFrames_ ),
+    _packet ( nullptr ),
+    _frame ( nullptr )
+  {
+    _readStats = addStage ( "read" );
+    _decodeStats = addStage ( "decode" );
+    _distributeStats = addStage ( "distribute" );
+
+    _description = "Flow Graph";
+    _inDevice = static_cast<StreamDeviceIn*>( _inStream );
+
+    init ( );
+  }
+
+  FlowGraph::~FlowGraph ( void )
+  {
+    for ( auto& branch_ : _branches )
+    {
+      branch_->stop ( );
+    }
+  }
+
+  void FlowGraph::init ( void )
+  {
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Init FFmpeg/libAV functionality on flow graph.",
+                                         this->getDescription ( ));
+
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+    av_register_all ( );
+    avcodec_register_all ( );
+#endif
+
+    avdevice_register_all ( );
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "All required functions are registered successfully." );
+
+    Utils::getInstance ( )
+      ->getLog ( ) ( LOG_LEVEL::INFO, "Init in Stream Flow." );
+    if ( _inStream != nullptr )
+    {
+      _inDevice->init ( );
+    }
+    else
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Error init in Stream." );
+    }
+  }
+
+  void FlowGraph::addOutput ( Stream* outStream_,
+                              unsigned int queueDepth_,
+                              bool dropWhenFull_ )
+  {
+    if ( outStream_ == nullptr )
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Error init out Stream." );
+    }
+
+    Utils::getInstance ( )
+      ->getLog ( ) ( LOG_LEVEL::INFO, "Init out Stream Flow: ",
+                     outStream_->getDescription ( ));
+    if ( StreamVideoFileOut* outFile_ =
+      dynamic_cast<StreamVideoFileOut*>( outStream_ ))
+    {
+      outFile_->setSourceSize ( _inDevice->getCodecContext ( )->width,
+                                _inDevice->getCodecContext ( )->height );
+    }
+    outStream_->init ( );
+
+    if ( StreamVideoFileOut* outFile_ =
+      dynamic_cast<StreamVideoFileOut*>( outStream_ ))
+    {
+      _branches.emplace_back ( new VideoFileBranch ( outFile_,
+                                                     _framePool,
+                                                     queueDepth_,
+                                                     dropWhenFull_ ));
+    }
+#ifdef REMO_USE_SDL
+    else if ( StreamSDLViewerOut* outViewer_ =
+      dynamic_cast<StreamSDLViewerOut*>( outStream_ ))
+    {
+      _branches.emplace_back ( new SDLViewerBranch ( outViewer_,
+                                                     _framePool,
+                                                     queueDepth_,
+                                                     dropWhenFull_ ));
+    }
+#endif
+#ifdef REMO_USE_WEBSTREAMER
+    else if ( StreamWebStreamer* outWebStreamer_ =
+      dynamic_cast<StreamWebStreamer*>( outStream_ ))
+    {
+      _branches.emplace_back ( new WebStreamBranch ( outWebStreamer_,
+                                                     _framePool,
+                                                     queueDepth_,
+                                                     dropWhenFull_ ));
+    }
+#endif
+    else
+    {
+      Utils::getInstance ( )->getErrorManager ( )->criticalError (
+        "Stream not supported as flow graph output." );
+    }
+  }
+
+  unsigned long FlowGraph::getDroppedFrames ( unsigned int output_ )
+  {
+    return output_ < _branches.size ( ) ? _branches[output_]->getDropped ( ) : 0;
+  }
+
+  void FlowGraph::distribute ( AVFrame* frame_ )
+  {
+    //Every output gets its own reference, pixels are never copied here.
+    for ( auto& branch_ : _branches )
+    {
+      AVFrame* ref_ = _framePool.getFrame ( );
+      if ( !ref_ || ( av_frame_ref ( ref_, frame_ ) < 0 ))
+      {
+        Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
+                                                                     "reference "
+                                                                     "working "
+                                                                     "frame." );
+      }
+
+      if ( !branch_->push ( ref_ ))
+      {
+        _framePool.releaseFrame ( ref_ );
+      }
+    }
+  }
+
+  void FlowGraph::processStreams ( void )
+  {
+    runSteps ( );
+  }
+
+  void FlowGraph::prepare ( void )
+  {
+    if ( _branches.empty ( ))
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "Flow graph without outputs." );
+      return;
+    }
+
+    _packet = _packetPool.getPacket ( );
+    _frame = _framePool.getFrame ( );
+    if ( !_packet || !_frame )
+    {
+      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
+                                                                   "reserve "
+                                                                   "resources "
+                                                                   "for "
+                                                                   "working "
+                                                                   "frames." );
+    }
+
+    for ( auto& branch_ : _branches )
+    {
+      branch_->start ( );
+    }
+  }
+
+  Flow::STEP_RESULT FlowGraph::step ( void )
+  {
+    if ( _branches.empty ( ) || ( !_continuousExecution && ( _numFrames == 0 )))
+    {
+      return STEP_DONE;
+    }
+
+    StageTimer readTimer_ ( _readStats );
+    int value = av_read_frame ( _inDevice->getFormatContext ( ), _packet );
+    if ( value < 0 )
+    {
+      readTimer_.cancel ( );
+    }
+    else
+    {
+      readTimer_.setBytes ( _packet->size );
+      readTimer_.stop ( );
+    }
+    if ( value == AVERROR( EAGAIN ))
+    {
+      return STEP_IDLE;
+    }
+    else if ( value < 0 )
+    {
+      return STEP_DONE;
+    }
+
+    if ( !_continuousExecution )
+    {
+      --_numFrames;
+    }
+
+    AVCodecContext* codecCtx_ = _inDevice->getCodecContext ( );
+    if ( _packet->stream_index == _inDevice->getVideoStreamIndx ( ))
+    {
+      StageTimer decodeTimer_ ( _decodeStats );
+      decodeTimer_.setBytes ( _packet->size );
+      if ( avcodec_send_packet ( codecCtx_, _packet ) < 0 )
+      {
+        Utils::getInstance ( )->getErrorManager ( )
+                              ->criticalError ( "Unable to decode video." );
+      }
+
+      while ( avcodec_receive_frame ( codecCtx_, _frame ) >= 0 )
+      {
+        decodeTimer_.stop ( );
+
+        StageTimer distributeTimer_ ( _distributeStats );
+        distribute ( _frame );
+        av_frame_unref ( _frame );
+      }
+    }
+    av_packet_unref ( _packet );
+
+    return STEP_CONTINUE;
+  }
+
+  void FlowGraph::cleanup ( void )
+  {
+    _packetPool.releasePacket ( _packet );
+    _framePool.releaseFrame ( _frame );
+
+    for ( unsigned int i = 0; i < _branches.size ( ); ++i )
+    {
+      _branches[i]->stop ( );
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                           "Flow graph output ", i,
+                                           " dropped frames: ",
+                                           _branches[i]->getDropped ( ));
+    }
+
+    logStageStats ( );
+    logPoolUsage ( );
+  }
+}
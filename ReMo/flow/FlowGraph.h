@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_FLOW_GRAPH_H
+#define REMO_FLOW_GRAPH_H
+
+#include <memory>
+#include <vector>
+
+#include "Flow.h"
+#include "../stream/StreamDeviceIn.h"
+
+namespace remo
+{
+  class FlowBranch;
+
+  //Captures and decodes one input Stream once and hands every decoded frame,
+  //by reference, to any number of output Streams. Each output runs on its
+  //own thread behind its own queue, so a slow sink cannot stall the others.
+  class FlowGraph: public Flow
+  {
+    public:
+      FlowGraph ( Stream* inStream_,
+                  bool continuousExecution_ = false,
+                  unsigned int numFrames_ = 128 );
+      virtual ~FlowGraph ( void );
+
+      virtual void init ( void );
+      virtual void processStreams ( void );
+
+      virtual void prepare ( void );
+      virtual STEP_RESULT step ( void );
+      virtual void cleanup ( void );
+
+      //Supported outputs: StreamVideoFileOut, StreamSDLViewerOut and
+      //StreamWebStreamer. The output Stream is initialized here. When
+      //dropWhenFull_ is false the capture waits for this output instead of
+      //dropping frames for it.
+      void addOutput ( Stream* outStream_,
+                       unsigned int queueDepth_ = 4,
+                       bool dropWhenFull_ = true );
+
+      unsigned int getNumOutputs ( void ) { return _branches.size ( ); }
+      //Frames that did not reach the given output because its queue was full.
+      unsigned long getDroppedFrames ( unsigned int output_ );
+
+      void setNumFramesToCapture ( unsigned int numFrames_ )
+      {
+        _numFrames = numFrames_;
+      };
+
+    private:
+      void distribute ( AVFrame* frame_ );
+
+      StreamDeviceIn* _inDevice;
+
+      bool _continuousExecution;
+      unsigned int _numFrames;
+
+      AVPacket* _packet;
+      AVFrame* _frame;
+
+      StageStats* _readStats;
+      StageStats* _decodeStats;
+      StageStats* _distributeStats;
+
+      std::vector < std::unique_ptr < FlowBranch > > _branches;
+  };
+}
+
+#endif //REMO_FLOW_GRAPH_H
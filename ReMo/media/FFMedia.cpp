@@ -22,7 +22,8 @@
 
 namespace remo
 {
-  FFMedia::FFMedia ( void ): Media ( )
+  FFMedia::FFMedia ( void ): Media ( ),
+    _options ( nullptr )
   {
     _description = "Basic ffmpeg/libAV video Media";
     _ffmpegQualifier = "None";
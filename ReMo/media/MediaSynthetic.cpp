@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "MediaSynthetic.h"
+
+namespace remo
+{
+  MediaSynthetic::MediaSynthetic ( unsigned int width_,
+                                   unsigned int height_,
+                                   unsigned int fps_,
+                                   AVPixelFormat pixelFormat_,
+                                   SYNTHETIC_PATTERN pattern_ ): FFMedia ( ),
+    _width ( width_ ),
+    _height ( height_ ),
+    _fps ( fps_ ),
+    _pixelFormat ( pixelFormat_ ),
+    _pattern ( pattern_ ),
+    _motion ( 0.0f ),
+    _entropy ( 0.0f ),
+    _seed ( 1 ),
+    _realTime ( false )
+  {
+    _description = "Synthetic test pattern.";
+    _ffmpegQualifier = "lavfi";
+  }
+
+  void MediaSynthetic::init ( void )
+  {
+    //The whole configuration goes in the filter graph.
+  }
+
+  void MediaSynthetic::setSize ( unsigned int width_, unsigned int height_ )
+  {
+    _width = width_;
+    _height = height_;
+  }
+
+  void MediaSynthetic::setMotion ( float motion_ )
+  {
+    _motion = std::max ( 0.0f, std::min ( motion_, 1.0f ));
+  }
+
+  void MediaSynthetic::setEntropy ( float entropy_ )
+  {
+    _entropy = std::max ( 0.0f, std::min ( entropy_, 1.0f ));
+  }
+
+  std::string MediaSynthetic::getFilterGraph ( void )
+  {
+    std::ostringstream graph_;
+
+    switch ( _pattern )
+    {
+      case PATTERN_MANDELBROT:
+        graph_ << "mandelbrot";
+        break;
+      case PATTERN_SMPTEBARS:
+        graph_ << "smptebars";
+        break;
+      case PATTERN_TESTSRC2:
+      default:
+        graph_ << "testsrc2";
+        break;
+    }
+    graph_ << "=size=" << _width << "x" << _height << ":rate=" << _fps;
+
+    if ( _motion > 0.0f )
+    {
+      //_motion is in frame widths per second, clamped to [0,1] by
+      //setMotion ( ). scroll takes a fraction of the frame per output frame.
+      graph_ << ",scroll=horizontal=" << _motion / _fps
+             << ":vertical=" << _motion / ( 2 * _fps );
+    }
+
+    if ( _entropy > 0.0f )
+    {
+      graph_ << ",noise=all_seed=" << _seed
+             << ":alls=" << static_cast < int > ( _entropy * 100 )
+             << ":allf=t";
+    }
+
+    const char* format_ = av_get_pix_fmt_name ( _pixelFormat );
+    if ( format_ )
+    {
+      graph_ << ",format=pix_fmts=" << format_;
+    }
+
+    if ( _realTime )
+    {
+      graph_ << ",realtime";
+    }
+
+    return graph_.str ( );
+  }
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_MEDIA_SYNTHETIC_H
+#define REMO_MEDIA_SYNTHETIC_H
+
+#include "FFMedia.h"
+
+namespace remo
+{
+  enum SYNTHETIC_PATTERN
+  {
+    PATTERN_TESTSRC2,
+    PATTERN_MANDELBROT,
+    PATTERN_SMPTEBARS
+  };
+
+  //Test pattern generated by libavfilter (lavfi device), so flows can run
+  //and be measured without display or camera. Unless real time is set the
+  //frames are produced as fast as they are read.
+  class MediaSynthetic: public FFMedia
+  {
+    public:
+      MediaSynthetic ( unsigned int width_ = 1280,
+                       unsigned int height_ = 720,
+                       unsigned int fps_ = 30,
+                       AVPixelFormat pixelFormat_ = AV_PIX_FMT_YUV420P,
+                       SYNTHETIC_PATTERN pattern_ = PATTERN_TESTSRC2 );
+      virtual ~MediaSynthetic ( void ) = default;
+
+      virtual void init ( void );
+
+      void setSize ( unsigned int width_, unsigned int height_ );
+      void setFps ( unsigned int fps_ ) { _fps = fps_; }
+      void setPixelFormat ( AVPixelFormat pixelFormat_ ) { _pixelFormat = pixelFormat_; }
+      void setPattern ( SYNTHETIC_PATTERN pattern_ ) { _pattern = pattern_; }
+
+      //0 still pattern, 1 scrolls one frame width and half a frame height
+      //per second (needs the scroll filter, FFmpeg 4.3 or newer).
+      void setMotion ( float motion_ );
+      //0 clean pattern, 1 strong temporal noise, the hardest to encode.
+      void setEntropy ( float entropy_ );
+      void setSeed ( int seed_ ) { _seed = seed_; }
+      //Delivers the frames at the frame rate, like a device.
+      void setRealTime ( bool realTime_ ) { _realTime = realTime_; }
+
+      unsigned int getWidth ( void ) { return _width; }
+      unsigned int getHeight ( void ) { return _height; }
+      unsigned int getFps ( void ) { return _fps; }
+
+      //lavfi graph description, StreamDeviceIn opens it as its input.
+      std::string getFilterGraph ( void );
+
+    private:
+      unsigned int _width;
+      unsigned int _height;
+      unsigned int _fps;
+      AVPixelFormat _pixelFormat;
+      SYNTHETIC_PATTERN _pattern;
+
+      float _motion;
+      float _entropy;
+      int _seed;
+      bool _realTime;
+  };
+}
+#endif //REMO_MEDIA_SYNTHETIC_H
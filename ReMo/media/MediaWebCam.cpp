@@ -35,6 +35,11 @@ namespace remo
     //Something to do here
   }
 
+  void MediaWebCam::setInputFormat ( const std::string& inputFormat_ )
+  {
+    setOption ( "input_format", inputFormat_ );
+  }
+
   void MediaWebCam::setPhysicalMedia ( const std::string& physicalMedia_ )
   {
     _physicalMedia = physicalMedia_;
@@ -36,6 +36,10 @@ namespace remo
       void setPhysicalMedia ( const std::string& physicalMedia_ = "/dev/video0" );
       std::string getPhysicalMedia ( ) { return _physicalMedia; }
 
+      //Compressed format requested to the camera (mjpeg, h264), that can be
+      //recorded without transcoding.
+      void setInputFormat ( const std::string& inputFormat_ );
+
     private:
       std::string _physicalMedia;
 
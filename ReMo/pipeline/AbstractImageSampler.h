@@ -20,6 +20,18 @@ namespace remo
 				std::uint8_t & r, 
 				std::uint8_t & g, 
 				std::uint8_t & b) = 0;
+
+			// Samples the destination row taken from source row i, columns
+			// holds the source column of each destination pixel. Writes
+			// dstWidth RGB24 pixels. By default calls samplePixels per pixel.
+			virtual void sampleRow(
+				std::uint8_t ** srcBuffer,
+				int srcWidth,
+				int srcHeight,
+				int i,
+				const int * columns,
+				int dstWidth,
+				std::uint8_t * dstRow);
 	};
 
 	class NearImageSampler : public AbstractImageSampler
@@ -36,6 +48,33 @@ namespace remo
 				std::uint8_t & b);
 	};
 
+	// Nearest sampling of whole rows with SSSE3/AVX2 when the CPU has them
+	// (checked once at run time), scalar otherwise. Same output as
+	// NearImageSampler.
+	class SimdNearImageSampler : public NearImageSampler
+	{
+		public:
+			SimdNearImageSampler ( void );
+
+			void sampleRow(
+				std::uint8_t ** srcBuffer,
+				int srcWidth,
+				int srcHeight,
+				int i,
+				const int * columns,
+				int dstWidth,
+				std::uint8_t * dstRow);
+
+		private:
+			typedef void (*RowKernel)(
+				const std::uint8_t * srcRow,
+				const int * columns,
+				int dstWidth,
+				std::uint8_t * dstRow);
+
+			RowKernel kernel;
+	};
+
 	class LinearImageSampler : public AbstractImageSampler
 	{
 		public:
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "ColorAdjust.h"
+#include "../util/Utils.h"
+
+namespace remo
+{
+  ColorAdjust::ColorAdjust ( float brightness_, float contrast_, float gamma_ )
+    : FusableOperation ( )
+    , _brightness ( brightness_ )
+    , _contrast ( contrast_ )
+    , _gamma ( gamma_ )
+    , _identity ( true )
+    , _desc ( nullptr )
+    , _numComponents ( 0 )
+  {
+    _description = "Color Adjust";
+    updateTable ( );
+  }
+
+  void ColorAdjust::init ( void )
+  {
+    AVDictionaryEntry* brightness_ = av_dict_get ( _options, "brightness", nullptr, 0 );
+    if ( brightness_ )
+    {
+      _brightness = std::strtof ( brightness_->value, nullptr );
+    }
+    AVDictionaryEntry* contrast_ = av_dict_get ( _options, "contrast", nullptr, 0 );
+    if ( contrast_ )
+    {
+      _contrast = std::strtof ( contrast_->value, nullptr );
+    }
+    AVDictionaryEntry* gamma_ = av_dict_get ( _options, "gamma", nullptr, 0 );
+    if ( gamma_ )
+    {
+      _gamma = std::strtof ( gamma_->value, nullptr );
+    }
+    updateTable ( );
+
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Initiating Color Adjust, brightness ",
+                                         _brightness, ", contrast ", _contrast,
+                                         ", gamma ", _gamma, "." );
+  }
+
+  void ColorAdjust::setBrightness ( float brightness_ )
+  {
+    _brightness = brightness_;
+    updateTable ( );
+  }
+
+  void ColorAdjust::setContrast ( float contrast_ )
+  {
+    _contrast = contrast_;
+    updateTable ( );
+  }
+
+  void ColorAdjust::setGamma ( float gamma_ )
+  {
+    _gamma = gamma_;
+    updateTable ( );
+  }
+
+  void ColorAdjust::updateTable ( void )
+  {
+    //Contrast around the middle grey, then brightness, then gamma.
+    const float invGamma_ = ( _gamma > 0.0f ) ? 1.0f / _gamma : 1.0f;
+    _identity = true;
+    for ( int i = 0; i < 256; ++i )
+    {
+      float value_ = ( i / 255.0f - 0.5f ) * _contrast + 0.5f + _brightness;
+      value_ = std::pow ( std::min ( 1.0f, std::max ( 0.0f, value_ )), invGamma_ );
+      _table[i] = static_cast < uint8_t > ( std::lround ( value_ * 255.0f ));
+      _identity = _identity && ( _table[i] == i );
+    }
+  }
+
+  bool ColorAdjust::prepare ( const AVFrame* frame_ )
+  {
+    _desc = av_pix_fmt_desc_get ( static_cast<AVPixelFormat>( frame_->format ));
+    if ( !isPlain8Bit ( _desc ))
+    {
+      return false;
+    }
+
+    //Colour channels of RGB, luma otherwise. Alpha is always last.
+    _numComponents = ( _desc->flags & AV_PIX_FMT_FLAG_RGB )
+                     ? std::min ( 3, static_cast < int > ( _desc->nb_components )) : 1;
+    return true;
+  }
+
+  void ColorAdjust::processRows ( AVFrame* frame_, int begin_, int end_ )
+  {
+    if ( _identity )
+    {
+      return;
+    }
+
+    const bool rgb_ = _desc->flags & AV_PIX_FMT_FLAG_RGB;
+    for ( int c = 0; c < _numComponents; ++c )
+    {
+      const AVComponentDescriptor& comp_ = _desc->comp[c];
+      int width_ = ( !rgb_ && (( c == 1 ) || ( c == 2 )))
+                   ? AV_CEIL_RSHIFT ( frame_->width, _desc->log2_chroma_w )
+                   : frame_->width;
+      int first_ = 0;
+      int last_ = 0;
+      planeRows ( _desc, comp_.plane, begin_, end_, first_, last_ );
+
+      for ( int y = first_; y < last_; ++y )
+      {
+        uint8_t* row_ = frame_->data[comp_.plane]
+                        + y * frame_->linesize[comp_.plane] + comp_.offset;
+        if ( comp_.step == 1 )
+        {
+          for ( int x = 0; x < width_; ++x )
+          {
+            row_[x] = _table[row_[x]];
+          }
+        }
+        else
+        {
+          for ( int x = 0; x < width_; ++x )
+          {
+            row_[x * comp_.step] = _table[row_[x * comp_.step]];
+          }
+        }
+      }
+    }
+  }
+}
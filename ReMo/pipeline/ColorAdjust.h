@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef REMO_COLORADJUST_H
+#define REMO_COLORADJUST_H
+
+#include <cstdint>
+
+#include "FusableOperation.h"
+
+namespace remo
+{
+  //Brightness, contrast and gamma through a table, on the luma of YUV and
+  //gray frames and on the colour channels of RGB ones. Options
+  //"brightness" (-1 to 1), "contrast" and "gamma" are read on init ( ).
+  class ColorAdjust: public FusableOperation
+  {
+    public:
+      ColorAdjust ( float brightness_ = 0.0f,
+                    float contrast_ = 1.0f,
+                    float gamma_ = 1.0f );
+      ~ColorAdjust ( void ) = default;
+
+      virtual void init ( void );
+
+      virtual bool prepare ( const AVFrame* frame_ );
+      virtual void processRows ( AVFrame* frame_, int begin_, int end_ );
+
+      void setBrightness ( float brightness_ );
+      void setContrast ( float contrast_ );
+      void setGamma ( float gamma_ );
+      float getBrightness ( void ) { return _brightness; }
+      float getContrast ( void ) { return _contrast; }
+      float getGamma ( void ) { return _gamma; }
+
+    private:
+      void updateTable ( void );
+
+      float _brightness;
+      float _contrast;
+      float _gamma;
+      uint8_t _table[256];
+      bool _identity;
+
+      //Format of the current frame and how many of its components change.
+      const AVPixFmtDescriptor* _desc;
+      int _numComponents;
+  };
+}
+#endif //REMO_COLORADJUST_H
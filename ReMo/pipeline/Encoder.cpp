@@ -18,12 +18,220 @@
  *
  */
 
+
+#include <cstdlib>
+
 #include "Encoder.h"
+#include "../util/Utils.h"
 
 namespace remo
 {
-  Encoder::Encoder ( void ): FFOperation ( )
+  Encoder::Encoder ( AVCodecContext* codecCtx_, Muxer* muxer_ )
+    : FFOperation ( )
+    , _codecCtx ( codecCtx_ )
+    , _muxer ( muxer_ )
+    , _stats ( nullptr )
+    , _threaded ( true )
+    , _queueDepth ( 4 )
+    , _flushed ( false )
+    , _abort ( false )
+    , _packet ( av_packet_alloc ( ))
+    , _numFrames ( 0 )
+    , _numPackets ( 0 )
   {
     _description = "Basic encoding Operation";
   }
-}
\ No newline at end of file
+
+  Encoder::~Encoder ( void )
+  {
+    //Queued frames are dropped, flush ( ) must be called to keep them.
+    stop ( );
+    av_packet_free ( &_packet );
+  }
+
+  void Encoder::init ( void )
+  {
+    if ( _codecCtx == nullptr )
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Encoder without a codec context." );
+    }
+
+    AVDictionaryEntry* entry_ = av_dict_get ( _options, "threaded", nullptr, 0 );
+    if ( entry_ )
+    {
+      _threaded = std::atoi ( entry_->value ) != 0;
+    }
+    entry_ = av_dict_get ( _options, "queue_depth", nullptr, 0 );
+    if ( entry_ )
+    {
+      int depth_ = std::atoi ( entry_->value );
+      _queueDepth = depth_ > 0 ? depth_ : 1;
+    }
+
+    stop ( );
+    _flushed = false;
+    _numFrames = 0;
+    _numPackets = 0;
+
+    if ( _threaded )
+    {
+      _queue.reset ( new SPSCQueue < AVFrame* > ( _queueDepth ));
+      _thread = std::thread ( &Encoder::encoderThread, this );
+    }
+  }
+
+  void Encoder::apply ( void )
+  {
+    if (( _inAVFrame == nullptr ) || !_inAVFrame->data[0] || _flushed )
+    {
+      return;
+    }
+
+    if ( !_thread.joinable ( ))
+    {
+      if ( !encode ( _inAVFrame ))
+      {
+        Utils::getInstance ( )->getErrorManager ( )
+                              ->criticalError ( "Unable to encode video." );
+      }
+      return;
+    }
+
+    //The queue keeps its own reference, the caller may release the frame.
+    AVFrame* frame_ = _framePool.getFrame ( );
+    if ( !frame_ || ( av_frame_ref ( frame_, _inAVFrame ) < 0 ))
+    {
+      _framePool.releaseFrame ( frame_ );
+      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to "
+                                                                   "reserve "
+                                                                   "working "
+                                                                   "frame." );
+    }
+
+    if ( !_queue->push ( frame_ ))
+    {
+      _framePool.releaseFrame ( frame_ );
+    }
+  }
+
+  void Encoder::flush ( void )
+  {
+    if ( _flushed || ( _codecCtx == nullptr ))
+    {
+      return;
+    }
+    _flushed = true;
+
+    if ( _thread.joinable ( ))
+    {
+      //The thread drains the queue and then the codec.
+      _queue->close ( );
+      _thread.join ( );
+    }
+    else if ( !encode ( nullptr ))
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Unable to encode video." );
+    }
+  }
+
+  unsigned int Encoder::getQueueHighWaterMark ( void )
+  {
+    return _queue ? _queue->getHighWaterMark ( ) : 0;
+  }
+
+  void Encoder::stop ( void )
+  {
+    if ( !_thread.joinable ( ))
+    {
+      return;
+    }
+
+    //The thread stays the only consumer, it drops what is left.
+    _abort = true;
+    _queue->close ( );
+    _thread.join ( );
+    _abort = false;
+  }
+
+  void Encoder::encoderThread ( void )
+  {
+    AVFrame* frame_ = nullptr;
+
+    while ( _queue->pop ( frame_ ))
+    {
+      if ( _abort )
+      {
+        _framePool.releaseFrame ( frame_ );
+        continue;
+      }
+
+      bool encoded_ = encode ( frame_ );
+      _framePool.releaseFrame ( frame_ );
+      if ( !encoded_ )
+      {
+        Utils::getInstance ( )->getErrorManager ( )
+                              ->criticalError ( "Unable to encode video." );
+      }
+    }
+
+    if ( !_abort && !encode ( nullptr ))
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Unable to encode video." );
+    }
+  }
+
+  bool Encoder::encode ( AVFrame* frame_ )
+  {
+    StageStats::Clock::time_point start_ = StageStats::Clock::now ( );
+    StageStats::Clock::duration busy_ = StageStats::Clock::duration::zero ( );
+    std::size_t bytes_ = 0;
+
+    if ( frame_ != nullptr )
+    {
+      //A picture type set by the caller is taken as a forced frame type,
+      //the encoder settings (GOP, B-frames) decide it instead.
+      frame_->pict_type = AV_PICTURE_TYPE_NONE;
+      frame_->key_frame = 0;
+    }
+
+    int value = avcodec_send_frame ( _codecCtx, frame_ );
+    if ( value < 0 )
+    {
+      return false;
+    }
+    if ( frame_ != nullptr )
+    {
+      ++_numFrames;
+    }
+
+    //One frame may produce none or several packets, take all of them.
+    while (( value = avcodec_receive_packet ( _codecCtx, _packet )) >= 0 )
+    {
+      busy_ += StageStats::Clock::now ( ) - start_;
+      bytes_ += _packet->size;
+      ++_numPackets;
+
+      if ( _muxer != nullptr )
+      {
+        value = _muxer->writePacket ( _packet );
+      }
+      av_packet_unref ( _packet );
+      if ( value < 0 )
+      {
+        return false;
+      }
+      start_ = StageStats::Clock::now ( );
+    }
+    busy_ += StageStats::Clock::now ( ) - start_;
+
+    if (( _stats != nullptr ) && ( frame_ != nullptr ))
+    {
+      _stats->record ( busy_, bytes_ );
+    }
+
+    return ( value == AVERROR( EAGAIN )) || ( value == AVERROR_EOF );
+  }
+}
@@ -18,23 +18,84 @@
  *
  */
 
+
 #ifndef REMO_ENCODER_H
 #define REMO_ENCODER_H
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
+
 #include "../util/ffdefs.h"
+#include "../util/FramePool.h"
+#include "../util/SPSCQueue.h"
+#include "../util/StageStats.h"
 #include "FFOperation.h"
+#include "Muxer.h"
 
 namespace remo
 {
+  //Encodes _inAVFrame with an opened codec context and hands every packet
+  //the codec produces (none or several per frame, with B-frames) to the
+  //Muxer. By default the codec runs on its own thread behind a bounded
+  //queue, so apply ( ) only takes a reference to the frame and encoding
+  //overlaps with capture and conversion. The frame buffer must not be
+  //written while referenced (see av_frame_make_writable).
+  //
+  //Options, read on init ( ):
+  //  "threaded"     0 encodes inline on apply ( ), 1 (default) on a thread.
+  //  "queue_depth"  frames waiting for the encoder thread, 4 by default.
   class Encoder: public FFOperation
   {
     public:
-      Encoder ( void );
-      virtual ~Encoder ( void ) = default;
+      Encoder ( AVCodecContext* codecCtx_ = nullptr, Muxer* muxer_ = nullptr );
+      virtual ~Encoder ( void );
+
+      Encoder ( const Encoder& ) = delete;
+      Encoder& operator= ( const Encoder& ) = delete;
+
+      virtual void init ( void );
+      virtual void apply ( void );
+      virtual bool writesFrame ( void ) { return false; }
+
+      //Take effect on the next init ( ).
+      void setCodecContext ( AVCodecContext* codecCtx_ ) { _codecCtx = codecCtx_; }
+      void setMuxer ( Muxer* muxer_ ) { _muxer = muxer_; }
+      //Encode time of each frame, and bytes produced, recorded if set.
+      void setStats ( StageStats* stats_ ) { _stats = stats_; }
+
+      //Ends the stream: waits for the queued frames and drains the packets
+      //the codec still holds. The codec cannot take frames afterwards.
+      void flush ( void );
+
+      bool isThreaded ( void ) { return _threaded; }
+      unsigned int getQueueHighWaterMark ( void );
+      unsigned long getNumFrames ( void ) { return _numFrames; }
+      unsigned long getNumPackets ( void ) { return _numPackets; }
+
+    protected:
+      void encoderThread ( void );
+      //nullptr flushes the codec. Returns false on a codec or mux error.
+      bool encode ( AVFrame* frame_ );
+      void stop ( void );
+
+      AVCodecContext* _codecCtx;
+      Muxer* _muxer;
+      StageStats* _stats;
+
+      bool _threaded;
+      unsigned int _queueDepth;
+      bool _flushed;
+      std::atomic < bool > _abort;
+
+      FramePool _framePool;
+      AVPacket* _packet;
+      std::unique_ptr < SPSCQueue < AVFrame* > > _queue;
+      std::thread _thread;
 
-      virtual void init ( void ) = 0;
-      virtual void apply ( void ) = 0;
+      std::atomic < unsigned long > _numFrames;
+      std::atomic < unsigned long > _numPackets;
   };
 }
 #endif //REMO_ENCODER_H
@@ -23,6 +23,12 @@
 namespace remo
 {
   FFOperation::FFOperation ( void ): Operation ( )
+    , _options ( nullptr )
+    , _inAVFrame ( nullptr )
+    , _outAVFrame ( nullptr )
+    , _inAVPacket ( nullptr )
+    , _outAVPacket ( nullptr )
+    , _optional ( false )
   {
     _description = "Basic ffmpeg/libAV Operation";
   }
@@ -36,6 +36,13 @@ namespace remo
 
       virtual void init ( void ) = 0;
       virtual void apply ( void ) = 0;
+      //False when apply ( ) reads _inAVFrame and writes _outAVFrame. In a
+      //pipeline, _outAVFrame is then a pooled frame of the same format and
+      //size, which becomes the input of the next operation.
+      virtual bool isInPlace ( void ) { return true; }
+      //False when apply ( ) only reads the pixels of _inAVFrame, or replaces
+      //its reference. A pipeline does not copy a shared frame for them.
+      virtual bool writesFrame ( void ) { return true; }
 
       void setOptions ( AVDictionary* options_ ) { _options = options_; }
       void setOption ( std::string option_, std::string value_ );
@@ -45,6 +52,10 @@ namespace remo
       void setPackages ( AVPacket* inAVPacket_,
                          AVPacket* outAVPacket_ = nullptr );
 
+      //Optional operations are skipped when a pipeline runs late.
+      void setOptional ( bool optional_ ) { _optional = optional_; }
+      bool isOptional ( void ) { return _optional; }
+
     protected:
       AVDictionary* _options;
 
@@ -53,6 +64,8 @@ namespace remo
 
       AVPacket* _inAVPacket;
       AVPacket* _outAVPacket;
+
+      bool _optional;
   };
 }
 #endif //REMO_FFOPERATION_H
@@ -18,6 +18,9 @@
  *
  */
 
+#include <algorithm>
+#include <map>
+
 #include "FFPipeline.h"
 #include "../util/Utils.h"
 
@@ -25,6 +28,16 @@ namespace remo
 {
   FFPipeline::FFPipeline ( Stream* inStream_, Stream* outStream_ )
     : Pipeline ( )
+    , _mode ( SEQUENTIAL )
+    , _outputOp ( nullptr )
+    , _maxFramesInFlight ( 4 )
+    , _fusion ( true )
+    , _outputStage ( nullptr )
+    , _frameBudget ( 0 )
+    , _frameStats ( "Pipeline" )
+    , _framesInFlight ( 0 )
+    , _running ( false )
+    , _inputClosed ( false )
   {
     _description = "Basic Pipeline";
 
@@ -43,7 +56,17 @@ namespace remo
     _inAVFrame ( inAVFrame_ ),
     _outAVFrame ( outAVFrame_ ),
     _inAVPacket ( inAVPacket_ ),
-    _outAVPacket ( outAVPacket_ )
+    _outAVPacket ( outAVPacket_ ),
+    _mode ( SEQUENTIAL ),
+    _outputOp ( nullptr ),
+    _maxFramesInFlight ( 4 ),
+    _fusion ( true ),
+    _outputStage ( nullptr ),
+    _frameBudget ( 0 ),
+    _frameStats ( "Pipeline" ),
+    _framesInFlight ( 0 ),
+    _running ( false ),
+    _inputClosed ( false )
   {
     _description = "Basic Pipeline";
     
@@ -51,6 +74,55 @@ namespace remo
     _outStream = nullptr;
   }
 
+  FFPipeline::~FFPipeline ( void )
+  {
+    stop ( );
+  }
+
+  void FFPipeline::addOperation ( FFOperation* op_ )
+  {
+    if ( _ops.empty ( ))
+    {
+      addOperation ( op_, { } );
+    }
+    else
+    {
+      addOperation ( op_, { _ops.back ( ) } );
+    }
+  }
+
+  void FFPipeline::addOperation ( FFOperation* op_,
+                                  const std::vector < FFOperation* >& dependencies_ )
+  {
+    //Dependencies must be added first, so the graph has no cycles.
+    for ( FFOperation* dependency_ : dependencies_ )
+    {
+      if ( std::find ( _ops.begin ( ), _ops.end ( ), dependency_ ) == _ops.end ( ))
+      {
+        Utils::getInstance ( )->getErrorManager ( )
+                              ->criticalError ( "Pipeline dependency not added "
+                                                "before the operation." );
+      }
+    }
+
+    std::unique_ptr < Node > node_ ( new Node );
+    node_->op = op_;
+    node_->dependencies = dependencies_;
+    _nodes.push_back ( std::move ( node_ ));
+    _ops.push_back ( op_ );
+
+    //Stages are fused again on the next init ( ).
+    stop ( );
+    _stages.clear ( );
+    _stageOf.clear ( );
+    _fusedOps.clear ( );
+  }
+
+  void FFPipeline::setMaxFramesInFlight ( unsigned int maxFrames_ )
+  {
+    _maxFramesInFlight = std::max ( 1u, maxFrames_ );
+  }
+
   void FFPipeline::connectFramesAndPackages ( AVFrame* inAVFrame_,
                                                AVFrame* outAVFrame_,
                                                AVPacket* inAVPacket_,
@@ -69,10 +141,12 @@ namespace remo
       || ( _inAVPacket != nullptr )
       || ( _outAVPacket != nullptr ))
     {
-      for ( auto& it_ : _ops )
+      stop ( );
+      setupStages ( );
+
+      if ( _mode == GRAPH )
       {
-        it_->setFrames ( _inAVFrame, _outAVFrame );
-        it_->setPackages ( _inAVPacket, _outAVPacket );
+        startGraph ( );
       }
     }
     else
@@ -82,11 +156,467 @@ namespace remo
                           "nullptr." );
   }
 
-  void FFPipeline::process ( void )
+  void FFPipeline::setupStages ( void )
   {
+    buildStages ( );
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO, "Pipeline stages: ",
+                                         _fusionReport );
+
     for ( auto& it_ : _ops )
     {
-      it_->apply ( );
+      it_->setFrames ( _inAVFrame, _outAVFrame );
+      it_->setPackages ( _inAVPacket, _outAVPacket );
+    }
+    for ( auto& it_ : _fusedOps )
+    {
+      it_->setFrames ( _inAVFrame, _outAVFrame );
+      it_->setPackages ( _inAVPacket, _outAVPacket );
+    }
+
+    //Options set with setOption ( ) are read here.
+    for ( auto& stage_ : _stages )
+    {
+      stage_->op->init ( );
+    }
+  }
+
+  bool FFPipeline::process ( void )
+  {
+    if ( _mode == SEQUENTIAL )
+    {
+      if ( _stages.empty ( ) && !_nodes.empty ( ))
+      {
+        setupStages ( );
+      }
+      StageStats::Clock::time_point start_ = StageStats::Clock::now ( );
+      AVFrame* frame_ = _inAVFrame;
+      for ( auto& it_ : _stages )
+      {
+        AVFrame* next_ = runStage ( *it_, frame_, _outAVFrame, start_ );
+        if ( next_ != frame_ )
+        {
+          if ( frame_ != _inAVFrame )
+          {
+            _framePool.releaseFrame ( frame_ );
+          }
+          frame_ = next_;
+        }
+      }
+      //The result goes back to the connected frame.
+      if ( frame_ != _inAVFrame )
+      {
+        av_frame_unref ( _inAVFrame );
+        av_frame_move_ref ( _inAVFrame, frame_ );
+        _framePool.releaseFrame ( frame_ );
+      }
+      _frameStats.record ( start_, StageStats::Clock::now ( ));
+      return true;
+    }
+
+    if ( !_running )
+    {
+      startGraph ( );
+    }
+    if ( !_running || ( _inAVFrame == nullptr ))
+    {
+      return !_running;
+    }
+
+    //The last input takes the frame itself, the others references.
+    StageStats::Clock::time_point start_ = StageStats::Clock::now ( );
+    for ( std::size_t i = 0; i < _graphInputs.size ( ); ++i )
+    {
+      AVFrame* frame_ = _framePool.getFrame ( );
+      if ( !frame_ )
+      {
+        Utils::getInstance ( )->getErrorManager ( )
+                              ->criticalError ( "Unable to reserve pipeline frames." );
+      }
+      if ( i + 1 < _graphInputs.size ( ))
+      {
+        av_frame_ref ( frame_, _inAVFrame );
+      }
+      else
+      {
+        av_frame_move_ref ( frame_, _inAVFrame );
+      }
+      if ( !_graphInputs[i]->push ( GraphFrame { frame_, start_ } ))
+      {
+        _framePool.releaseFrame ( frame_ );
+      }
+    }
+    ++_framesInFlight;
+
+    return receive ( _framesInFlight >= _maxFramesInFlight );
+  }
+
+  bool FFPipeline::flush ( void )
+  {
+    if ( !_running )
+    {
+      return false;
+    }
+
+    if ( !_inputClosed )
+    {
+      for ( FrameQueue* input_ : _graphInputs )
+      {
+        input_->close ( );
+      }
+      _inputClosed = true;
+    }
+
+    if ( receive ( true ))
+    {
+      return true;
+    }
+    stop ( );
+    return false;
+  }
+
+  void FFPipeline::buildStages ( void )
+  {
+    _stages.clear ( );
+    _fusedOps.clear ( );
+    _outputStage = nullptr;
+    _stageOf.clear ( );
+    _fusionReport.clear ( );
+    _frameStats.reset ( );
+    if ( _nodes.empty ( ))
+    {
+      return;
+    }
+
+    FFOperation* outputOp_ = _outputOp ? _outputOp : _nodes.back ( )->op;
+    std::map < FFOperation*, int > dependents_;
+    for ( auto& node_ : _nodes )
+    {
+      for ( FFOperation* dependency_ : node_->dependencies )
+      {
+        ++dependents_[dependency_];
+      }
+    }
+
+    //Runs of adjacent point-wise operations. In GRAPH mode the run must be
+    //a chain nothing else reads from, or the branches would see the fused
+    //result.
+    std::vector < std::vector < FFOperation* > > groups_;
+    std::vector < const Node* > heads_;
+    for ( auto& node_ : _nodes )
+    {
+      bool fuse_ = false;
+      if ( _fusion && !groups_.empty ( ) && isFusable ( node_->op ))
+      {
+        //Optional and required operations are skipped apart.
+        FFOperation* tail_ = groups_.back ( ).back ( );
+        fuse_ = isFusable ( tail_ ) && ( tail_->isOptional ( ) == node_->op->isOptional ( ));
+        if ( _mode == GRAPH )
+        {
+          fuse_ = fuse_ && ( node_->dependencies.size ( ) == 1 )
+            && ( node_->dependencies[0] == tail_ ) && ( dependents_[tail_] == 1 )
+            && ( tail_ != outputOp_ );
+        }
+      }
+
+      if ( fuse_ )
+      {
+        groups_.back ( ).push_back ( node_->op );
+      }
+      else
+      {
+        groups_.push_back ( { node_->op } );
+        heads_.push_back ( node_.get ( ));
+      }
+    }
+
+    //Dependencies on an operation become dependencies on its stage.
+    std::map < FFOperation*, FFOperation* > stageOf_;
+    for ( std::size_t g = 0; g < groups_.size ( ); ++g )
+    {
+      FFOperation* op_ = groups_[g].front ( );
+      if ( groups_[g].size ( ) > 1 )
+      {
+        std::vector < FusableOperation* > fusable_;
+        for ( FFOperation* it_ : groups_[g] )
+        {
+          fusable_.push_back ( static_cast < FusableOperation* > ( it_ ));
+        }
+        _fusedOps.emplace_back ( new FusedOperation ( fusable_ ));
+        _fusedOps.back ( )->setOptional ( groups_[g].front ( )->isOptional ( ));
+        op_ = _fusedOps.back ( ).get ( );
+      }
+
+      std::unique_ptr < Node > stage_ ( new Node );
+      stage_->op = op_;
+      stage_->stats.reset ( new StageStats ( op_->getDescription ( )));
+      for ( FFOperation* it_ : groups_[g] )
+      {
+        stageOf_[it_] = op_;
+        _stageOf[it_] = stage_.get ( );
+      }
+      for ( FFOperation* dependency_ : heads_[g]->dependencies )
+      {
+        stage_->dependencies.push_back ( stageOf_[dependency_] );
+      }
+      _stages.push_back ( std::move ( stage_ ));
+
+      _fusionReport += ( g ? ", " : "" ) + std::to_string ( g + 1 ) + ". "
+        + op_->getDescription ( );
     }
+    _outputStage = stageOf_[outputOp_];
+  }
+
+  std::vector < StageStats* > FFPipeline::getStageStats ( void )
+  {
+    std::vector < StageStats* > stats_;
+    for ( auto& stage_ : _stages )
+    {
+      stats_.push_back ( stage_->stats.get ( ));
+    }
+    return stats_;
+  }
+
+  StageStats* FFPipeline::getStageStats ( FFOperation* op_ )
+  {
+    auto it_ = _stageOf.find ( op_ );
+    return ( it_ != _stageOf.end ( )) ? it_->second->stats.get ( ) : nullptr;
+  }
+
+  bool FFPipeline::isFusable ( FFOperation* op_ )
+  {
+    return dynamic_cast < FusableOperation* > ( op_ ) != nullptr;
+  }
+
+  bool FFPipeline::receive ( bool wait_ )
+  {
+    GraphFrame item_ { nullptr, StageStats::Clock::time_point ( ) };
+    if ( !( wait_ ? _graphOutput->pop ( item_ ) : _graphOutput->tryPop ( item_ )))
+    {
+      return false;
+    }
+
+    --_framesInFlight;
+    av_frame_unref ( _inAVFrame );
+    av_frame_move_ref ( _inAVFrame, item_.frame );
+    _framePool.releaseFrame ( item_.frame );
+    _frameStats.record ( item_.start, StageStats::Clock::now ( ));
+    return true;
+  }
+
+  void FFPipeline::startGraph ( void )
+  {
+    if ( _running )
+    {
+      return;
+    }
+    if ( _stages.empty ( ) && !_nodes.empty ( ))
+    {
+      setupStages ( );
+    }
+    if ( _stages.empty ( ))
+    {
+      return;
+    }
+
+    _graphInputs.clear ( );
+    _graphOutput.reset ( new FrameQueue ( _maxFramesInFlight ));
+
+    bool hasOutput_ = false;
+    for ( auto& node_ : _stages )
+    {
+      node_->inputs.clear ( );
+      node_->outputs.clear ( );
+    }
+    for ( auto& node_ : _stages )
+    {
+      if ( node_->dependencies.empty ( ))
+      {
+        node_->inputs.emplace_back ( new FrameQueue ( _maxFramesInFlight ));
+        _graphInputs.push_back ( node_->inputs.back ( ).get ( ));
+      }
+      for ( FFOperation* dependency_ : node_->dependencies )
+      {
+        node_->inputs.emplace_back ( new FrameQueue ( _maxFramesInFlight ));
+        for ( auto& parent_ : _stages )
+        {
+          if ( parent_->op == dependency_ )
+          {
+            parent_->outputs.push_back ( node_->inputs.back ( ).get ( ));
+            break;
+          }
+        }
+      }
+    }
+    for ( auto& node_ : _stages )
+    {
+      if ( node_->op == _outputStage )
+      {
+        node_->outputs.push_back ( _graphOutput.get ( ));
+        hasOutput_ = true;
+        break;
+      }
+    }
+    if ( !hasOutput_ )
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Pipeline output operation not added." );
+    }
+
+    _framesInFlight = 0;
+    _inputClosed = false;
+    _running = true;
+    for ( auto& node_ : _stages )
+    {
+      node_->thread = std::thread ( &FFPipeline::runNode, this, std::ref ( *node_ ));
+    }
+  }
+
+  void FFPipeline::runNode ( Node& node_ )
+  {
+    GraphFrame item_ { nullptr, StageStats::Clock::time_point ( ) };
+    while ( node_.inputs[0]->pop ( item_ ))
+    {
+      AVFrame* frame_ = item_.frame;
+
+      //The other dependencies only order this operation after them.
+      bool open_ = true;
+      for ( std::size_t i = 1; open_ && ( i < node_.inputs.size ( )); ++i )
+      {
+        GraphFrame other_ { nullptr, item_.start };
+        open_ = node_.inputs[i]->pop ( other_ );
+        _framePool.releaseFrame ( other_.frame );
+      }
+      if ( !open_ )
+      {
+        _framePool.releaseFrame ( frame_ );
+        break;
+      }
+
+      //Copies the pixels when a sibling branch shares them and the
+      //operation writes them.
+      if ( node_.op->isInPlace ( ) && node_.op->writesFrame ( )
+        && ( av_frame_make_writable ( frame_ ) < 0 ))
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                             "Pipeline frame not writable." );
+      }
+      AVFrame* next_ = runStage ( node_, frame_, nullptr, item_.start );
+      if ( next_ != frame_ )
+      {
+        _framePool.releaseFrame ( frame_ );
+        frame_ = next_;
+      }
+
+      for ( std::size_t i = 0; i < node_.outputs.size ( ); ++i )
+      {
+        AVFrame* out_ = frame_;
+        if ( i + 1 < node_.outputs.size ( ))
+        {
+          out_ = _framePool.getFrame ( );
+          if ( !out_ || ( av_frame_ref ( out_, frame_ ) < 0 ))
+          {
+            Utils::getInstance ( )->getErrorManager ( )
+                                  ->criticalError ( "Unable to reserve pipeline frames." );
+          }
+        }
+        if ( !node_.outputs[i]->push ( GraphFrame { out_, item_.start } ))
+        {
+          _framePool.releaseFrame ( out_ );
+        }
+      }
+      if ( node_.outputs.empty ( ))
+      {
+        _framePool.releaseFrame ( frame_ );
+      }
+    }
+
+    for ( FrameQueue* output_ : node_.outputs )
+    {
+      output_->close ( );
+    }
+  }
+
+  AVFrame* FFPipeline::runStage ( Node& node_,
+                                  AVFrame* frame_,
+                                  AVFrame* outAVFrame_,
+                                  StageStats::Clock::time_point start_ )
+  {
+    if ( node_.op->isOptional ( ) && ( _frameBudget.count ( ) > 0 ))
+    {
+      std::chrono::duration < double, std::micro > expected_ ( node_.stats->getRollingMean ( ));
+      if ( StageStats::Clock::now ( ) - start_ + expected_ > _frameBudget )
+      {
+        node_.stats->recordSkip ( );
+        return frame_;
+      }
+    }
+
+    if ( node_.op->isInPlace ( ) || !frame_ || !frame_->data[0] || ( frame_->width <= 0 ))
+    {
+      node_.op->setFrames ( frame_, outAVFrame_ );
+      StageTimer timer_ ( node_.stats.get ( ));
+      node_.op->apply ( );
+      return frame_;
+    }
+
+    //The other frame of the ping-pong pair, its buffer comes back to the
+    //pool once the next stage is done with it.
+    AVFrame* dst_ = _framePool.getFrame ( static_cast<AVPixelFormat>( frame_->format ),
+                                         frame_->width, frame_->height );
+    if ( !dst_ )
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Unable to reserve pipeline frames." );
+    }
+    av_frame_copy_props ( dst_, frame_ );
+    //A new picture, the type the decoder gave the source does not apply.
+    dst_->pict_type = AV_PICTURE_TYPE_NONE;
+    dst_->key_frame = 0;
+
+    node_.op->setFrames ( frame_, dst_ );
+    StageTimer timer_ ( node_.stats.get ( ));
+    node_.op->apply ( );
+    return dst_;
+  }
+
+  void FFPipeline::stop ( void )
+  {
+    if ( !_running )
+    {
+      return;
+    }
+
+    //Every queue is closed, the nodes finish the frames already queued.
+    for ( auto& node_ : _stages )
+    {
+      for ( auto& input_ : node_->inputs )
+      {
+        input_->close ( );
+      }
+    }
+    _graphOutput->close ( );
+
+    for ( auto& node_ : _stages )
+    {
+      node_->thread.join ( );
+    }
+    GraphFrame item_ { nullptr, StageStats::Clock::time_point ( ) };
+    for ( auto& node_ : _stages )
+    {
+      for ( auto& input_ : node_->inputs )
+      {
+        while ( input_->tryPop ( item_ ))
+        {
+          _framePool.releaseFrame ( item_.frame );
+        }
+      }
+    }
+    while ( _graphOutput->tryPop ( item_ ))
+    {
+      _framePool.releaseFrame ( item_.frame );
+    }
+
+    _framesInFlight = 0;
+    _running = false;
   }
 }
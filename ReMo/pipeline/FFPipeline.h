@@ -21,19 +21,40 @@
 #ifndef REMO_FFPIPELINE_H
 #define REMO_FFPIPELINE_H
 
+#include <chrono>
+#include <map>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "../util/ffdefs.h"
+#include "../util/FramePool.h"
+#include "../util/SPSCQueue.h"
+#include "../util/StageStats.h"
 #include "../stream/Stream.h"
 #include "../pipeline/Pipeline.h"
 #include "../pipeline/FFOperation.h"
+#include "../pipeline/FusedOperation.h"
 
 namespace remo
 {
   class FFPipeline: public Pipeline
   {
     public:
+      //SEQUENTIAL applies the operations one after the other on the
+      //connected frames. Operations that are not in place write into pooled
+      //frames that alternate as source and destination, the result ends in
+      //the input frame. GRAPH runs each operation on its own thread, fed
+      //by one queue per dependency, so independent operations run at once
+      //and an operation takes the next frame while the following ones
+      //still work on the previous.
+      enum EXECUTION_MODE
+      {
+        SEQUENTIAL = 0,
+        GRAPH
+      };
+
       FFPipeline ( Stream* inStream_ = nullptr,
                     Stream* outStream_ = nullptr );
 
@@ -42,18 +63,100 @@ namespace remo
                     AVPacket* inAVPacket_ = nullptr,
                     AVPacket* outAVPacket_ = nullptr );
 
-      virtual ~FFPipeline ( void ) = default;
+      virtual ~FFPipeline ( void );
+
+      FFPipeline ( const FFPipeline& ) = delete;
+      FFPipeline& operator= ( const FFPipeline& ) = delete;
 
+      //Connects the operations, fuses the adjacent point-wise ones, calls
+      //init ( ) once on each stage and, in GRAPH mode, starts their threads.
       virtual void init ( void );
-      virtual void process ( void );
+      //True when _inAVFrame holds a processed frame. In GRAPH mode the input
+      //is taken and a frame sent some calls before comes back, false while
+      //the graph fills up.
+      virtual bool process ( void );
+      //GRAPH mode, after the last input: next frame left in the graph,
+      //false once it is empty.
+      bool flush ( void );
+      //GRAPH mode: stops the threads, frames still in the graph are lost.
+      void stop ( void );
+
+      //In GRAPH mode it depends on the operation added before.
+      void addOperation ( FFOperation* op_ );
+      //GRAPH mode. The first dependency gives the input frame, the rest
+      //only order the operation after them. Without dependencies it takes
+      //the pipeline input.
+      void addOperation ( FFOperation* op_,
+                          const std::vector < FFOperation* >& dependencies_ );
+
+      void setExecutionMode ( EXECUTION_MODE mode_ ) { _mode = mode_; }
+      EXECUTION_MODE getExecutionMode ( void ) { return _mode; }
+      //Operation whose frames process ( ) returns, the last added by default.
+      void setOutputOperation ( FFOperation* op_ ) { _outputOp = op_; }
+      //Frames in the graph at once.
+      void setMaxFramesInFlight ( unsigned int maxFrames_ );
+      //Adjacent FusableOperations run as one FusedOperation, on by default.
+      //Applies from the next init ( ).
+      void setFusion ( bool fusion_ ) { _fusion = fusion_; }
+      bool getFusion ( void ) { return _fusion; }
+      //Stages built by the last init ( ), fused operations as one.
+      const std::string& getFusionReport ( void ) { return _fusionReport; }
+
+      //Deadline of a frame from process ( ), 0 disables it. An optional
+      //operation whose rolling average would end past it is skipped for
+      //that frame.
+      void setFrameBudget ( std::chrono::microseconds budget_ ) { _frameBudget = budget_; }
+      std::chrono::microseconds getFrameBudget ( void ) { return _frameBudget; }
+
+      //apply ( ) time of each stage, since the last init ( ).
+      std::vector < StageStats* > getStageStats ( void );
+      //Stage running op_, nullptr if it was not added.
+      StageStats* getStageStats ( FFOperation* op_ );
+      //From process ( ) taking a frame to the frame being processed.
+      StageStats* getFrameStats ( void ) { return &_frameStats; }
 
-      void addOperation ( FFOperation* op_ ) { _ops.push_back ( op_ ); };
       void connectFramesAndPackages ( AVFrame* inAVFrame_ = nullptr,
                                       AVFrame* outAVFrame_ = nullptr,
                                       AVPacket* inAVPacket_ = nullptr,
                                       AVPacket* outAVPacket_ = nullptr );
 
     protected:
+      //A frame and the time it entered the pipeline.
+      struct GraphFrame
+      {
+        AVFrame* frame;
+        StageStats::Clock::time_point start;
+      };
+      typedef SPSCQueue < GraphFrame > FrameQueue;
+
+      //An operation of the graph. Each edge is a queue of frame references
+      //owned by the consumer, frames are made writable before an in place
+      //apply ( ) so branches never share pixels.
+      struct Node
+      {
+        FFOperation* op;
+        std::vector < FFOperation* > dependencies;
+        std::vector < std::unique_ptr < FrameQueue > > inputs;
+        std::vector < FrameQueue* > outputs;
+        std::thread thread;
+        std::unique_ptr < StageStats > stats;
+      };
+
+      void buildStages ( void );
+      //Builds the stages, connects the frames and initializes them. A fused
+      //stage initializes the operations it runs.
+      void setupStages ( void );
+      static bool isFusable ( FFOperation* op_ );
+      void startGraph ( void );
+      void runNode ( Node& node_ );
+      //Applies the stage unless the budget leaves no time for it. Returns
+      //frame_, or the pooled frame an out of place operation wrote.
+      AVFrame* runStage ( Node& node_,
+                          AVFrame* frame_,
+                          AVFrame* outAVFrame_,
+                          StageStats::Clock::time_point start_ );
+      bool receive ( bool wait_ );
+
       std::vector < FFOperation* > _ops;
 
       Stream* _inStream;
@@ -64,6 +167,31 @@ namespace remo
 
       AVPacket* _inAVPacket;
       AVPacket* _outAVPacket;
+
+      EXECUTION_MODE _mode;
+      FFOperation* _outputOp;
+      unsigned int _maxFramesInFlight;
+
+      //Operations as they were added.
+      std::vector < std::unique_ptr < Node > > _nodes;
+      //What runs, _nodes with the fusable runs merged.
+      std::vector < std::unique_ptr < Node > > _stages;
+      std::vector < std::unique_ptr < FusedOperation > > _fusedOps;
+      bool _fusion;
+      FFOperation* _outputStage;
+      std::map < FFOperation*, Node* > _stageOf;
+      std::string _fusionReport;
+
+      std::chrono::microseconds _frameBudget;
+      StageStats _frameStats;
+      //Queues fed by process ( ), one per operation without dependencies.
+      std::vector < FrameQueue* > _graphInputs;
+      std::unique_ptr < FrameQueue > _graphOutput;
+      unsigned int _framesInFlight;
+      bool _running;
+      bool _inputClosed;
+
+      FramePool _framePool;
   };
 }
 #endif //REMO_FFPIPELINE_H
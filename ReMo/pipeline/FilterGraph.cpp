@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <cstdio>
+
+#include "FilterGraph.h"
+#include "../util/Utils.h"
+
+namespace remo
+{
+  FilterGraph::FilterGraph ( const std::string& graphDescription_, int numThreads_ )
+    : Filter ( )
+    , _graphDescription ( graphDescription_ )
+    , _numThreads ( numThreads_ )
+    , _outputFormat ( AV_PIX_FMT_NONE )
+    , _width ( 0 )
+    , _height ( 0 )
+    , _format ( AV_PIX_FMT_NONE )
+    , _timeBase ( AVRational { 1, AV_TIME_BASE } )
+    , _sampleAspectRatio ( AVRational { 0, 1 } )
+    , _graph ( nullptr )
+    , _srcCtx ( nullptr )
+    , _sinkCtx ( nullptr )
+    , _sinkFrame ( av_frame_alloc ( ))
+    , _lastFrame ( av_frame_alloc ( ))
+  {
+    _description = "libavfilter Graph Operation";
+  }
+
+  FilterGraph::~FilterGraph ( void )
+  {
+    release ( );
+    av_frame_free ( &_sinkFrame );
+    av_frame_free ( &_lastFrame );
+  }
+
+  void FilterGraph::setGraphDescription ( const std::string& graphDescription_ )
+  {
+    _graphDescription = graphDescription_;
+    release ( );
+  }
+
+  void FilterGraph::setNumThreads ( int numThreads_ )
+  {
+    _numThreads = numThreads_;
+    release ( );
+  }
+
+  void FilterGraph::setOutputFormat ( AVPixelFormat outputFormat_ )
+  {
+    _outputFormat = outputFormat_;
+    release ( );
+  }
+
+  void FilterGraph::setInputFormat ( int width_,
+                                     int height_,
+                                     AVPixelFormat format_,
+                                     AVRational timeBase_,
+                                     AVRational sampleAspectRatio_ )
+  {
+    _width = width_;
+    _height = height_;
+    _format = format_;
+    _timeBase = timeBase_;
+    _sampleAspectRatio = sampleAspectRatio_;
+    release ( );
+  }
+
+  void FilterGraph::init ( void )
+  {
+    if (( _inAVFrame != nullptr ) && ( _inAVFrame->width > 0 ))
+    {
+      _width = _inAVFrame->width;
+      _height = _inAVFrame->height;
+      _format = static_cast<AVPixelFormat>( _inAVFrame->format );
+      _sampleAspectRatio = _inAVFrame->sample_aspect_ratio;
+    }
+
+    if (( _width > 0 ) && !build ( ))
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Unable to build the filter graph \""
+                                              + _graphDescription + "\"." );
+    }
+  }
+
+  void FilterGraph::apply ( void )
+  {
+    if (( _inAVFrame == nullptr ) || !_inAVFrame->data[0] || filter ( _inAVFrame ))
+    {
+      return;
+    }
+
+    if ( !_graph )
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Unable to build the filter graph \""
+                                              + _graphDescription + "\"." );
+    }
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                         "Filter graph: frame not filtered." );
+  }
+
+  bool FilterGraph::filter ( AVFrame* frame_ )
+  {
+    if ( !_graph || ( frame_->width != _width ) || ( frame_->height != _height )
+      || ( frame_->format != _format ))
+    {
+      _width = frame_->width;
+      _height = frame_->height;
+      _format = static_cast<AVPixelFormat>( frame_->format );
+      _sampleAspectRatio = frame_->sample_aspect_ratio;
+      if ( !build ( ))
+      {
+        return false;
+      }
+    }
+
+    if ( av_buffersrc_add_frame_flags ( _srcCtx, frame_, AV_BUFFERSRC_FLAG_KEEP_REF ) < 0 )
+    {
+      return false;
+    }
+
+    //Keep the newest output, frame_ is only replaced when there is one.
+    while ( av_buffersink_get_frame ( _sinkCtx, _sinkFrame ) >= 0 )
+    {
+      av_frame_unref ( _lastFrame );
+      av_frame_move_ref ( _lastFrame, _sinkFrame );
+    }
+    if ( _lastFrame->buf[0] )
+    {
+      av_frame_unref ( frame_ );
+      return av_frame_ref ( frame_, _lastFrame ) >= 0;
+    }
+    return true;
+  }
+
+  bool FilterGraph::build ( void )
+  {
+    release ( );
+
+    _graph = avfilter_graph_alloc ( );
+    if ( !_graph )
+    {
+      return false;
+    }
+    //Threading is set up when the first filter is created.
+    _graph->nb_threads = _numThreads;
+    _graph->thread_type = AVFILTER_THREAD_SLICE;
+
+    char args_[256];
+    std::snprintf ( args_, sizeof ( args_ ),
+                    "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+                    _width, _height, _format, _timeBase.num, _timeBase.den,
+                    _sampleAspectRatio.num,
+                    _sampleAspectRatio.den ? _sampleAspectRatio.den : 1 );
+
+    std::string description_ = _graphDescription;
+    if ( _outputFormat != AV_PIX_FMT_NONE )
+    {
+      description_ += std::string ( ",format=pix_fmts=" )
+                      + av_get_pix_fmt_name ( _outputFormat );
+    }
+
+    //The open ends of the description: "in" feeds it and "out" drains it.
+    AVFilterInOut* outputs_ = avfilter_inout_alloc ( );
+    AVFilterInOut* inputs_ = avfilter_inout_alloc ( );
+    int value_ = ( outputs_ && inputs_ ) ? 0 : AVERROR( ENOMEM );
+    if ( value_ >= 0 )
+    {
+      value_ = avfilter_graph_create_filter ( &_srcCtx, avfilter_get_by_name ( "buffer" ),
+                                              "in", args_, nullptr, _graph );
+    }
+    if ( value_ >= 0 )
+    {
+      value_ = avfilter_graph_create_filter ( &_sinkCtx, avfilter_get_by_name ( "buffersink" ),
+                                              "out", nullptr, nullptr, _graph );
+    }
+    if ( value_ >= 0 )
+    {
+      outputs_->name = av_strdup ( "in" );
+      outputs_->filter_ctx = _srcCtx;
+      outputs_->pad_idx = 0;
+      outputs_->next = nullptr;
+
+      inputs_->name = av_strdup ( "out" );
+      inputs_->filter_ctx = _sinkCtx;
+      inputs_->pad_idx = 0;
+      inputs_->next = nullptr;
+
+      value_ = avfilter_graph_parse_ptr ( _graph, description_.c_str ( ),
+                                          &inputs_, &outputs_, nullptr );
+    }
+    if ( value_ >= 0 )
+    {
+      value_ = avfilter_graph_config ( _graph, nullptr );
+    }
+    avfilter_inout_free ( &inputs_ );
+    avfilter_inout_free ( &outputs_ );
+
+    if ( value_ < 0 )
+    {
+      char error_[128];
+      av_strerror ( value_, error_, sizeof ( error_ ));
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::ERROR,
+                                           "Filter graph \"", description_, "\": ",
+                                           error_ );
+      release ( );
+      return false;
+    }
+
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Filter graph \"", description_, "\" for ",
+                                         _width, "x", _height, " ",
+                                         av_get_pix_fmt_name ( _format ), "." );
+    return true;
+  }
+
+  void FilterGraph::release ( void )
+  {
+    //The graph owns its filter contexts.
+    avfilter_graph_free ( &_graph );
+    _srcCtx = nullptr;
+    _sinkCtx = nullptr;
+    av_frame_unref ( _lastFrame );
+  }
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef REMO_FILTERGRAPH_H
+#define REMO_FILTERGRAPH_H
+
+#include <string>
+
+#include "Filter.h"
+
+namespace remo
+{
+  //Runs _inAVFrame through a libavfilter graph given as a description
+  //string, "crop=1280:720:0:0,hqdn3d" for instance, and replaces it with
+  //the filtered frame. The graph is built on init ( ), called by the
+  //pipeline init, when the input is known from setInputFormat ( ) or the
+  //connected frame, so a bad description stops the flow before capture.
+  //Otherwise it is built on the first frame. It is rebuilt if the input
+  //changes.
+  //Filters that hold frames back (fps, yadif) repeat the last output
+  //until a new one is ready, when several are ready the newest is kept.
+  class FilterGraph: public Filter
+  {
+    public:
+      //0 threads lets libavfilter use one per core.
+      FilterGraph ( const std::string& graphDescription_ = "null",
+                    int numThreads_ = 0 );
+      virtual ~FilterGraph ( void );
+
+      FilterGraph ( const FilterGraph& ) = delete;
+      FilterGraph& operator= ( const FilterGraph& ) = delete;
+
+      virtual void init ( void );
+      virtual void apply ( void );
+      virtual bool writesFrame ( void ) { return false; }
+
+      //Take effect on the next build of the graph.
+      void setGraphDescription ( const std::string& graphDescription_ );
+      void setNumThreads ( int numThreads_ );
+      //AV_PIX_FMT_NONE keeps the format the last filter produces.
+      void setOutputFormat ( AVPixelFormat outputFormat_ );
+      //Input of the graph, to build it on init ( ) before any frame. Frame
+      //timestamps are in timeBase_, microseconds by default.
+      void setInputFormat ( int width_,
+                            int height_,
+                            AVPixelFormat format_,
+                            AVRational timeBase_ = AVRational { 1, AV_TIME_BASE },
+                            AVRational sampleAspectRatio_ = AVRational { 0, 1 } );
+
+      const std::string& getGraphDescription ( void ) { return _graphDescription; }
+      bool isBuilt ( void ) { return _graph != nullptr; }
+
+      //False when the graph cannot be built or does not accept frame_.
+      bool filter ( AVFrame* frame_ );
+
+    private:
+      bool build ( void );
+      void release ( void );
+
+      std::string _graphDescription;
+      int _numThreads;
+      AVPixelFormat _outputFormat;
+
+      int _width;
+      int _height;
+      AVPixelFormat _format;
+      AVRational _timeBase;
+      AVRational _sampleAspectRatio;
+
+      AVFilterGraph* _graph;
+      AVFilterContext* _srcCtx;
+      AVFilterContext* _sinkCtx;
+      AVFrame* _sinkFrame;
+      //Last filtered frame, repeated while the graph holds frames back.
+      AVFrame* _lastFrame;
+  };
+}
+#endif //REMO_FILTERGRAPH_H
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "FusableOperation.h"
+#include "../util/Utils.h"
+
+namespace remo
+{
+  FusableOperation::FusableOperation ( void ): ImgProc ( )
+  {
+    _description = "Basic fusable Operation";
+  }
+
+  void FusableOperation::apply ( void )
+  {
+    if ( _inAVFrame == nullptr )
+    {
+      return;
+    }
+
+    if (( _inAVFrame->buf[0] && ( av_frame_make_writable ( _inAVFrame ) < 0 ))
+      || !prepare ( _inAVFrame ))
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING, _description,
+                                           ": unsupported frame." );
+      return;
+    }
+    processRows ( _inAVFrame, 0, _inAVFrame->height );
+  }
+
+  void FusableOperation::planeRows ( const AVPixFmtDescriptor* desc_,
+                                     int plane_,
+                                     int begin_,
+                                     int end_,
+                                     int& planeBegin_,
+                                     int& planeEnd_ )
+  {
+    if (( plane_ == 1 ) || ( plane_ == 2 ))
+    {
+      planeBegin_ = AV_CEIL_RSHIFT ( begin_, desc_->log2_chroma_h );
+      planeEnd_ = AV_CEIL_RSHIFT ( end_, desc_->log2_chroma_h );
+    }
+    else
+    {
+      planeBegin_ = begin_;
+      planeEnd_ = end_;
+    }
+  }
+
+  bool FusableOperation::isPlain8Bit ( const AVPixFmtDescriptor* desc_ )
+  {
+    if ( !desc_ || ( desc_->flags & ( AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL
+                                      | AV_PIX_FMT_FLAG_BITSTREAM )))
+    {
+      return false;
+    }
+    for ( int c = 0; c < desc_->nb_components; ++c )
+    {
+      if ( desc_->comp[c].depth != 8 )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef REMO_FUSABLEOPERATION_H
+#define REMO_FUSABLEOPERATION_H
+
+#include "../util/ffdefs.h"
+#include "ImgProc.h"
+
+namespace remo
+{
+  //Point-wise operation on _inAVFrame, in place: every pixel only depends
+  //on itself. FFPipeline fuses consecutive ones into a FusedOperation, which
+  //runs all of them on a band of rows while it is still in cache instead of
+  //a pass over the whole frame each.
+  class FusableOperation: public ImgProc
+  {
+    public:
+      FusableOperation ( void );
+      virtual ~FusableOperation ( void ) = default;
+
+      virtual void init ( void ) = 0;
+      //The whole frame as a single band.
+      virtual void apply ( void );
+
+      //Sets up the per frame state before any band, false when the format
+      //is not supported and the frame must be left as it is.
+      virtual bool prepare ( const AVFrame* frame_ ) = 0;
+      //Luma rows [begin_, end_) and the rows of the other planes under them.
+      //Disjoint bands of a frame run concurrently.
+      virtual void processRows ( AVFrame* frame_, int begin_, int end_ ) = 0;
+
+      //Rows of plane_ under luma rows [begin_, end_).
+      static void planeRows ( const AVPixFmtDescriptor* desc_,
+                              int plane_,
+                              int begin_,
+                              int end_,
+                              int& planeBegin_,
+                              int& planeEnd_ );
+      //8 bit components without palette or hardware frames.
+      static bool isPlain8Bit ( const AVPixFmtDescriptor* desc_ );
+  };
+}
+#endif //REMO_FUSABLEOPERATION_H
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "FusedOperation.h"
+#include "../util/Utils.h"
+
+namespace remo
+{
+  namespace
+  {
+    //Half of a usual per core L2, the band is read and written once per
+    //operation.
+    const int defaultBandBytes = 128 * 1024;
+  }
+
+  FusedOperation::FusedOperation ( const std::vector < FusableOperation* >& ops_ )
+    : ImgProc ( )
+    , _ops ( ops_ )
+    , _workers ( WorkerPool::getShared ( ))
+    , _bandBytes ( defaultBandBytes )
+  {
+    _description = "Fused";
+    for ( std::size_t i = 0; i < _ops.size ( ); ++i )
+    {
+      _description += ( i ? " + " : " " ) + _ops[i]->getDescription ( );
+    }
+  }
+
+  void FusedOperation::init ( void )
+  {
+    for ( auto& it_ : _ops )
+    {
+      it_->init ( );
+    }
+  }
+
+  void FusedOperation::apply ( void )
+  {
+    if (( _inAVFrame != nullptr ) && !process ( _inAVFrame ))
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING, _description,
+                                           ": unsupported frame." );
+    }
+  }
+
+  void FusedOperation::setWorkerPool ( WorkerPool* workers_ )
+  {
+    _workers = workers_ ? workers_ : WorkerPool::getShared ( );
+  }
+
+  void FusedOperation::setBandBytes ( int bandBytes_ )
+  {
+    _bandBytes = ( bandBytes_ > 0 ) ? bandBytes_ : defaultBandBytes;
+  }
+
+  bool FusedOperation::process ( AVFrame* frame_ )
+  {
+    const AVPixFmtDescriptor* desc_ =
+      av_pix_fmt_desc_get ( static_cast<AVPixelFormat>( frame_->format ));
+    if ( !desc_ || ( frame_->height <= 0 )
+      || ( frame_->buf[0] && ( av_frame_make_writable ( frame_ ) < 0 )))
+    {
+      return false;
+    }
+
+    _active.clear ( );
+    for ( auto& it_ : _ops )
+    {
+      if ( it_->prepare ( frame_ ))
+      {
+        _active.push_back ( it_ );
+      }
+    }
+    if ( _active.empty ( ))
+    {
+      return false;
+    }
+
+    //Bytes under a luma row, chroma planes count by their share of rows.
+    const int chromaRows_ = 1 << desc_->log2_chroma_h;
+    int rowBytes_ = 0;
+    for ( int p = 0; ( p < 4 ) && frame_->data[p]; ++p )
+    {
+      int linesize_ = std::abs ( frame_->linesize[p] );
+      rowBytes_ += (( p == 1 ) || ( p == 2 )) ? linesize_ / chromaRows_ : linesize_;
+    }
+    int bandRows_ = std::max ( 1, _bandBytes / std::max ( 1, rowBytes_ ));
+    bandRows_ = std::max ( chromaRows_, bandRows_ / chromaRows_ * chromaRows_ );
+    const int height_ = frame_->height;
+    unsigned int numBands_ = ( height_ + bandRows_ - 1 ) / bandRows_;
+
+    _workers->parallelFor ( numBands_, 1,
+      [ this, frame_, bandRows_, height_ ] ( unsigned int begin_, unsigned int end_ )
+      {
+        for ( unsigned int b = begin_; b < end_; ++b )
+        {
+          int first_ = b * bandRows_;
+          int last_ = std::min ( height_, first_ + bandRows_ );
+          for ( auto& it_ : _active )
+          {
+            it_->processRows ( frame_, first_, last_ );
+          }
+        }
+      } );
+    return true;
+  }
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef REMO_FUSEDOPERATION_H
+#define REMO_FUSEDOPERATION_H
+
+#include <vector>
+
+#include "FusableOperation.h"
+#include "../util/WorkerPool.h"
+
+namespace remo
+{
+  //Consecutive point-wise operations run as one pass. The frame is split
+  //in bands of rows small enough to stay in cache, every operation is
+  //applied to a band before moving to the next one, and bands run on the
+  //worker pool. The operations are not owned.
+  class FusedOperation: public ImgProc
+  {
+    public:
+      FusedOperation ( const std::vector < FusableOperation* >& ops_ );
+      ~FusedOperation ( void ) = default;
+
+      virtual void init ( void );
+      virtual void apply ( void );
+
+      //Without a pool, WorkerPool::getShared ( ).
+      void setWorkerPool ( WorkerPool* workers_ );
+      //Bytes of all planes in a band, 0 restores the default.
+      void setBandBytes ( int bandBytes_ );
+
+      const std::vector < FusableOperation* >& getOperations ( void ) { return _ops; }
+
+      //False when no operation could be applied.
+      bool process ( AVFrame* frame_ );
+
+    private:
+      std::vector < FusableOperation* > _ops;
+      //Operations that accepted the current frame.
+      std::vector < FusableOperation* > _active;
+      WorkerPool* _workers;
+      int _bandBytes;
+  };
+}
+#endif //REMO_FUSEDOPERATION_H
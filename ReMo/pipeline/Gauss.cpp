@@ -18,25 +18,476 @@
  *
  */
 
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "Gauss.h"
 #include "../util/Utils.h"
 
 namespace remo
 {
-  Gauss::Gauss ( void ): Filter ( )
+  namespace
+  {
+    //Fixed point of the taps and of the horizontally filtered lines. Two
+    //lines add up without overflowing 16 bits.
+    const int weightBits = 14;
+    const int lineBits = 6;
+    const int maxRadius = 32;
+    //Rows per tile, more when the kernel is large so the context rows
+    //stay a small part of the work.
+    const int minTileRows = 128;
+
+    //Filtered line of a plane row, padded to whole SIMD blocks.
+    inline int lineSize ( int bytes_ )
+    {
+      return (( bytes_ + 15 ) & ~15 ) + 16;
+    }
+
+    inline int pairWeight ( const int32_t* weightPairs_, int j_ )
+    {
+      int32_t pair_ = weightPairs_[j_ / 2];
+      return ( j_ & 1 ) ? ( pair_ >> 16 ) : static_cast < int16_t > ( pair_ );
+    }
+
+    //The kernel is symmetric, taps j and 2 * radius - j are added before
+    //their shared weight multiplies them.
+    void filterRow ( const uint8_t* src_,
+                     int bytes_,
+                     int step_,
+                     int radius_,
+                     const int32_t* weightPairs_,
+                     int16_t* line_ )
+    {
+      //Replicated edge pixels on both sides, and slack for the last block.
+      static thread_local std::vector < uint8_t > padded_;
+      const int margin_ = radius_ * step_;
+      padded_.resize ( lineSize ( bytes_ ) + 2 * margin_ + 16 );
+      uint8_t* row_ = padded_.data ( );
+      for ( int i = 0; i < margin_; ++i )
+      {
+        row_[i] = src_[i % step_];
+        row_[margin_ + bytes_ + i] = src_[bytes_ - step_ + i % step_];
+      }
+      std::memcpy ( row_ + margin_, src_, bytes_ );
+      std::memset ( row_ + 2 * margin_ + bytes_, 0,
+                    padded_.size ( ) - 2 * margin_ - bytes_ );
+
+      const int shift_ = weightBits - lineBits;
+      const int round_ = 1 << ( shift_ - 1 );
+      const int last_ = 2 * radius_ * step_;
+      int x = 0;
+#ifdef __SSE2__
+      const __m128i zero_ = _mm_setzero_si128 ( );
+      const __m128i roundV_ = _mm_set1_epi32 ( round_ );
+      for ( ; x < bytes_; x += 16 )
+      {
+        const uint8_t* p_ = row_ + x;
+        //Folded tap j as two vectors of 8 words, the center when j is the
+        //radius and zero past it.
+        auto fold_ = [ & ] ( int j_, __m128i& lo_, __m128i& hi_ )
+        {
+          if ( j_ > radius_ )
+          {
+            lo_ = zero_;
+            hi_ = zero_;
+            return;
+          }
+          __m128i a_ = _mm_loadu_si128 ( reinterpret_cast < const __m128i* > ( p_ + j_ * step_ ));
+          lo_ = _mm_unpacklo_epi8 ( a_, zero_ );
+          hi_ = _mm_unpackhi_epi8 ( a_, zero_ );
+          if ( j_ < radius_ )
+          {
+            __m128i b_ = _mm_loadu_si128 (
+              reinterpret_cast < const __m128i* > ( p_ + last_ - j_ * step_ ));
+            lo_ = _mm_add_epi16 ( lo_, _mm_unpacklo_epi8 ( b_, zero_ ));
+            hi_ = _mm_add_epi16 ( hi_, _mm_unpackhi_epi8 ( b_, zero_ ));
+          }
+        };
+
+        __m128i acc0_ = roundV_;
+        __m128i acc1_ = roundV_;
+        __m128i acc2_ = roundV_;
+        __m128i acc3_ = roundV_;
+        for ( int j = 0; j <= radius_; j += 2 )
+        {
+          __m128i lo0_, hi0_, lo1_, hi1_;
+          fold_ ( j, lo0_, hi0_ );
+          fold_ ( j + 1, lo1_, hi1_ );
+          const __m128i w_ = _mm_set1_epi32 ( weightPairs_[j / 2] );
+          acc0_ = _mm_add_epi32 ( acc0_, _mm_madd_epi16 ( _mm_unpacklo_epi16 ( lo0_, lo1_ ), w_ ));
+          acc1_ = _mm_add_epi32 ( acc1_, _mm_madd_epi16 ( _mm_unpackhi_epi16 ( lo0_, lo1_ ), w_ ));
+          acc2_ = _mm_add_epi32 ( acc2_, _mm_madd_epi16 ( _mm_unpacklo_epi16 ( hi0_, hi1_ ), w_ ));
+          acc3_ = _mm_add_epi32 ( acc3_, _mm_madd_epi16 ( _mm_unpackhi_epi16 ( hi0_, hi1_ ), w_ ));
+        }
+        _mm_storeu_si128 ( reinterpret_cast < __m128i* > ( line_ + x ),
+                           _mm_packs_epi32 ( _mm_srai_epi32 ( acc0_, shift_ ),
+                                             _mm_srai_epi32 ( acc1_, shift_ )));
+        _mm_storeu_si128 ( reinterpret_cast < __m128i* > ( line_ + x + 8 ),
+                           _mm_packs_epi32 ( _mm_srai_epi32 ( acc2_, shift_ ),
+                                             _mm_srai_epi32 ( acc3_, shift_ )));
+      }
+#endif
+      for ( ; x < bytes_; ++x )
+      {
+        int acc_ = round_ + pairWeight ( weightPairs_, radius_ ) * row_[x + radius_ * step_];
+        for ( int j = 0; j < radius_; ++j )
+        {
+          acc_ += pairWeight ( weightPairs_, j )
+                * ( row_[x + j * step_] + row_[x + last_ - j * step_] );
+        }
+        line_[x] = static_cast < int16_t > ( acc_ >> shift_ );
+      }
+    }
+
+    //Vertical taps over the filtered lines, back to 8 bits.
+    void filterColumns ( const int16_t* const* lines_,
+                         int bytes_,
+                         int radius_,
+                         const int32_t* weightPairs_,
+                         uint8_t* dst_ )
+    {
+      const int shift_ = weightBits + lineBits;
+      const int round_ = 1 << ( shift_ - 1 );
+      const int last_ = 2 * radius_;
+      int x = 0;
+#ifdef __SSE2__
+      const __m128i zero_ = _mm_setzero_si128 ( );
+      const __m128i roundV_ = _mm_set1_epi32 ( round_ );
+      for ( ; x + 16 <= bytes_; x += 16 )
+      {
+        //Folded tap j of 16 words, as in filterRow ( ).
+        auto fold_ = [ & ] ( int j_, __m128i& lo_, __m128i& hi_ )
+        {
+          if ( j_ > radius_ )
+          {
+            lo_ = zero_;
+            hi_ = zero_;
+            return;
+          }
+          const __m128i* a_ = reinterpret_cast < const __m128i* > ( lines_[j_] + x );
+          lo_ = _mm_loadu_si128 ( a_ );
+          hi_ = _mm_loadu_si128 ( a_ + 1 );
+          if ( j_ < radius_ )
+          {
+            const __m128i* b_ = reinterpret_cast < const __m128i* > ( lines_[last_ - j_] + x );
+            lo_ = _mm_add_epi16 ( lo_, _mm_loadu_si128 ( b_ ));
+            hi_ = _mm_add_epi16 ( hi_, _mm_loadu_si128 ( b_ + 1 ));
+          }
+        };
+
+        __m128i acc0_ = roundV_;
+        __m128i acc1_ = roundV_;
+        __m128i acc2_ = roundV_;
+        __m128i acc3_ = roundV_;
+        for ( int j = 0; j <= radius_; j += 2 )
+        {
+          __m128i lo0_, hi0_, lo1_, hi1_;
+          fold_ ( j, lo0_, hi0_ );
+          fold_ ( j + 1, lo1_, hi1_ );
+          const __m128i w_ = _mm_set1_epi32 ( weightPairs_[j / 2] );
+          acc0_ = _mm_add_epi32 ( acc0_, _mm_madd_epi16 ( _mm_unpacklo_epi16 ( lo0_, lo1_ ), w_ ));
+          acc1_ = _mm_add_epi32 ( acc1_, _mm_madd_epi16 ( _mm_unpackhi_epi16 ( lo0_, lo1_ ), w_ ));
+          acc2_ = _mm_add_epi32 ( acc2_, _mm_madd_epi16 ( _mm_unpacklo_epi16 ( hi0_, hi1_ ), w_ ));
+          acc3_ = _mm_add_epi32 ( acc3_, _mm_madd_epi16 ( _mm_unpackhi_epi16 ( hi0_, hi1_ ), w_ ));
+        }
+        __m128i lo_ = _mm_packs_epi32 ( _mm_srai_epi32 ( acc0_, shift_ ),
+                                        _mm_srai_epi32 ( acc1_, shift_ ));
+        __m128i hi_ = _mm_packs_epi32 ( _mm_srai_epi32 ( acc2_, shift_ ),
+                                        _mm_srai_epi32 ( acc3_, shift_ ));
+        _mm_storeu_si128 ( reinterpret_cast < __m128i* > ( dst_ + x ),
+                           _mm_packus_epi16 ( lo_, hi_ ));
+      }
+#endif
+      for ( ; x < bytes_; ++x )
+      {
+        int acc_ = round_ + pairWeight ( weightPairs_, radius_ ) * lines_[radius_][x];
+        for ( int j = 0; j < radius_; ++j )
+        {
+          acc_ += pairWeight ( weightPairs_, j ) * ( lines_[j][x] + lines_[last_ - j][x] );
+        }
+        dst_[x] = static_cast < uint8_t > ( std::min ( 255, acc_ >> shift_ ));
+      }
+    }
+  }
+
+  Gauss::Gauss ( float sigma_, int radius_ )
+    : Filter ( )
+    , _sigma ( sigma_ )
+    , _radius ( radius_ )
+    , _taps ( 0 )
+    , _workers ( WorkerPool::getShared ( ))
   {
     _description = "Basic Gauss Filter Operation";
+    updateKernel ( );
   }
 
   void Gauss::init ( void )
   {
-    Utils::getInstance ( )
-      ->getLog ( ) ( LOG_LEVEL::INFO, "Initiating Gauss Filter." );
+    AVDictionaryEntry* sigma_ = av_dict_get ( _options, "sigma", nullptr, 0 );
+    if ( sigma_ )
+    {
+      _sigma = std::strtof ( sigma_->value, nullptr );
+    }
+    AVDictionaryEntry* radius_ = av_dict_get ( _options, "radius", nullptr, 0 );
+    if ( radius_ )
+    {
+      _radius = std::atoi ( radius_->value );
+    }
+    updateKernel ( );
+
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Initiating Gauss Filter, sigma ", _sigma,
+                                         ", ", _taps, " taps." );
   }
 
   void Gauss::apply ( void )
   {
-    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
-                                         "Applying Gauss Filter -> Not implemented yet!" );
+    if ( _inAVFrame == nullptr )
+    {
+      return;
+    }
+    bool done_ = ( _outAVFrame != nullptr ) ? blur ( _inAVFrame, _outAVFrame )
+                                            : blur ( _inAVFrame );
+    if ( !done_ )
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "Gauss Filter: unsupported frame." );
+    }
+  }
+
+  void Gauss::setSigma ( float sigma_ )
+  {
+    _sigma = sigma_;
+    updateKernel ( );
+  }
+
+  void Gauss::setRadius ( int radius_ )
+  {
+    _radius = radius_;
+    updateKernel ( );
+  }
+
+  void Gauss::setWorkerPool ( WorkerPool* workers_ )
+  {
+    _workers = workers_ ? workers_ : WorkerPool::getShared ( );
+  }
+
+  void Gauss::updateKernel ( void )
+  {
+    _weightPairs.clear ( );
+    _taps = 0;
+    if ( _sigma <= 0.0f )
+    {
+      return;
+    }
+
+    int radius_ = ( _radius > 0 ) ? _radius
+                                  : static_cast < int > ( std::ceil ( 3.0f * _sigma ));
+    radius_ = std::min ( radius_, maxRadius );
+    _taps = 2 * radius_ + 1;
+
+    std::vector < double > kernel_ ( _taps );
+    double sum_ = 0.0;
+    for ( int k = 0; k < _taps; ++k )
+    {
+      double d_ = k - radius_;
+      kernel_[k] = std::exp ( -d_ * d_ / ( 2.0 * _sigma * _sigma ));
+      sum_ += kernel_[k];
+    }
+
+    //Rounded taps, the center one takes the rounding error so they add up
+    //to exactly one.
+    std::vector < int > weights_ ( _taps + 1, 0 );
+    int total_ = 0;
+    for ( int k = 0; k < _taps; ++k )
+    {
+      weights_[k] = static_cast < int > ( std::lround ( kernel_[k] / sum_ * ( 1 << weightBits )));
+      total_ += weights_[k];
+    }
+    weights_[radius_] += ( 1 << weightBits ) - total_;
+
+    //Half the kernel and the center, as it is applied.
+    for ( int j = 0; j <= radius_; j += 2 )
+    {
+      int next_ = ( j + 1 <= radius_ ) ? weights_[j + 1] : 0;
+      _weightPairs.push_back ( static_cast < int32_t > (
+        ( static_cast < uint32_t > ( next_ ) << 16 ) | weights_[j] ));
+    }
+  }
+
+  bool Gauss::blur ( AVFrame* frame_ )
+  {
+    if ( frame_->buf[0] && ( av_frame_make_writable ( frame_ ) < 0 ))
+    {
+      return false;
+    }
+    return blur ( frame_, frame_ );
+  }
+
+  bool Gauss::blur ( const AVFrame* src_, AVFrame* dst_ )
+  {
+    const AVPixFmtDescriptor* desc_ =
+      av_pix_fmt_desc_get ( static_cast<AVPixelFormat>( src_->format ));
+    if ( !desc_ || ( desc_->flags & ( AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL
+                                      | AV_PIX_FMT_FLAG_BITSTREAM ))
+      || ( dst_->format != src_->format ) || ( dst_->width != src_->width )
+      || ( dst_->height != src_->height ))
+    {
+      return false;
+    }
+    for ( int c = 0; c < desc_->nb_components; ++c )
+    {
+      if ( desc_->comp[c].depth != 8 )
+      {
+        return false;
+      }
+    }
+
+    //Bytes between pixels of each plane. Packed 4:2:2 formats, with
+    //different steps in one plane, are not supported.
+    int steps_[4] = { 0, 0, 0, 0 };
+    for ( int c = 0; c < desc_->nb_components; ++c )
+    {
+      int& step_ = steps_[desc_->comp[c].plane];
+      if ( step_ && ( step_ != desc_->comp[c].step ))
+      {
+        return false;
+      }
+      step_ = desc_->comp[c].step;
+    }
+
+    if ( _taps <= 1 )
+    {
+      return ( src_ == dst_ ) || ( av_frame_copy ( dst_, src_ ) >= 0 );
+    }
+
+    const int radius_ = _taps / 2;
+    const int tileRows_ = std::max ( minTileRows, 8 * radius_ );
+    unsigned int numTiles_ = 0;
+    for ( int p = 0; p < 4; ++p )
+    {
+      if ( !steps_[p] || !src_->data[p] )
+      {
+        continue;
+      }
+      bool chroma_ = ( p == 1 ) || ( p == 2 );
+      int width_ = chroma_ ? AV_CEIL_RSHIFT ( src_->width, desc_->log2_chroma_w )
+                           : src_->width;
+      int height_ = chroma_ ? AV_CEIL_RSHIFT ( src_->height, desc_->log2_chroma_h )
+                            : src_->height;
+      for ( int begin_ = 0; begin_ < height_; begin_ += tileRows_ )
+      {
+        if ( _tiles.size ( ) <= numTiles_ )
+        {
+          _tiles.emplace_back ( );
+        }
+        Tile& tile_ = _tiles[numTiles_++];
+        tile_.src = src_->data[p];
+        tile_.srcLinesize = src_->linesize[p];
+        tile_.dst = dst_->data[p];
+        tile_.dstLinesize = dst_->linesize[p];
+        tile_.bytes = width_ * steps_[p];
+        tile_.height = height_;
+        tile_.step = steps_[p];
+        tile_.begin = begin_;
+        tile_.end = std::min ( height_, begin_ + tileRows_ );
+      }
+    }
+
+    //In place, tiles overwrite rows their neighbours read, the rows around
+    //each tile are filtered before any of them is written.
+    if ( src_ == dst_ )
+    {
+      _workers->parallelFor ( numTiles_, 1,
+        [ this ] ( unsigned int begin_, unsigned int end_ )
+        {
+          for ( unsigned int t = begin_; t < end_; ++t )
+          {
+            saveContext ( _tiles[t] );
+          }
+        } );
+    }
+    _workers->parallelFor ( numTiles_, 1,
+      [ this ] ( unsigned int begin_, unsigned int end_ )
+      {
+        for ( unsigned int t = begin_; t < end_; ++t )
+        {
+          blurTile ( _tiles[t] );
+        }
+      } );
+    return true;
+  }
+
+  void Gauss::saveContext ( Tile& tile_ )
+  {
+    const int radius_ = _taps / 2;
+    const int size_ = lineSize ( tile_.bytes );
+    tile_.context.resize ( 2 * radius_ * size_ );
+
+    //radius_ rows above the tile, then radius_ rows below, clamped.
+    for ( int i = 0; i < 2 * radius_; ++i )
+    {
+      int y_ = ( i < radius_ ) ? ( tile_.begin - radius_ + i )
+                               : ( tile_.end + i - radius_ );
+      y_ = std::min ( std::max ( y_, 0 ), tile_.height - 1 );
+      filterRow ( tile_.src + y_ * tile_.srcLinesize, tile_.bytes, tile_.step,
+                  radius_, _weightPairs.data ( ),
+                  tile_.context.data ( ) + i * size_ );
+    }
+  }
+
+  void Gauss::blurTile ( Tile& tile_ )
+  {
+    const int radius_ = _taps / 2;
+    const int size_ = lineSize ( tile_.bytes );
+    //Into another frame, the rows around the tile are read as they are.
+    const bool inPlace_ = tile_.src == tile_.dst;
+    const int top_ = inPlace_ ? tile_.begin : tile_.begin - radius_;
+    const int bottom_ = inPlace_ ? tile_.end : tile_.end + radius_;
+
+    //Filtered rows of the tile, the last _taps of them.
+    static thread_local std::vector < int16_t > ring_;
+    static thread_local std::vector < const int16_t* > lines_;
+    ring_.resize ( _taps * size_ );
+    lines_.resize ( _taps );
+
+    auto line_ = [ & ] ( int y_ ) -> const int16_t*
+    {
+      if ( y_ < top_ )
+      {
+        return tile_.context.data ( ) + ( y_ - tile_.begin + radius_ ) * size_;
+      }
+      if ( y_ >= bottom_ )
+      {
+        return tile_.context.data ( ) + ( radius_ + y_ - tile_.end ) * size_;
+      }
+      return ring_.data ( ) + (( y_ - top_ ) % _taps ) * size_;
+    };
+
+    //Each row is read into the ring before it is overwritten, in place.
+    int next_ = top_;
+    for ( int y = tile_.begin; y < tile_.end; ++y )
+    {
+      for ( ; next_ < std::min ( y + radius_ + 1, bottom_ ); ++next_ )
+      {
+        int row_ = std::min ( std::max ( next_, 0 ), tile_.height - 1 );
+        filterRow ( tile_.src + row_ * tile_.srcLinesize, tile_.bytes, tile_.step,
+                    radius_, _weightPairs.data ( ),
+                    ring_.data ( ) + (( next_ - top_ ) % _taps ) * size_ );
+      }
+      for ( int k = 0; k < _taps; ++k )
+      {
+        lines_[k] = line_ ( y + k - radius_ );
+      }
+      filterColumns ( lines_.data ( ), tile_.bytes, radius_, _weightPairs.data ( ),
+                      tile_.dst + y * tile_.dstLinesize );
+    }
   }
 }
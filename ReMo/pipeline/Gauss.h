@@ -23,18 +23,74 @@
 #define REMO_GAUSSFILTER_H
 
 #include <string>
+#include <vector>
+
 #include "Filter.h"
+#include "../util/WorkerPool.h"
 
 namespace remo
 {
+  //Separable Gaussian blur of the 8 bit planes of _inAVFrame into
+  //_outAVFrame, or in place without an output frame.
+  //Planar YUV/RGB, NV12 and packed RGB are supported, the channels of
+  //packed planes are filtered apart. Options "sigma" and "radius" are read
+  //on init ( ), radius 0 takes three sigmas.
   class Gauss: public Filter
   {
     public:
-      Gauss ( void );
+      Gauss ( float sigma_ = 1.5f, int radius_ = 0 );
       ~Gauss ( void ) = default;
 
       virtual void init ( void );
       virtual void apply ( void );
+      //Blurring into another frame saves the rows each tile would overwrite.
+      virtual bool isInPlace ( void ) { return false; }
+
+      void setSigma ( float sigma_ );
+      void setRadius ( int radius_ );
+      float getSigma ( void ) { return _sigma; }
+      int getRadius ( void ) { return _radius; }
+
+      //Without a pool, WorkerPool::getShared ( ).
+      void setWorkerPool ( WorkerPool* workers_ );
+
+      //False when the format is not supported or the frame cannot be made
+      //writable.
+      bool blur ( AVFrame* frame_ );
+      //dst_ has the format and size of src_, and writable planes.
+      bool blur ( const AVFrame* src_, AVFrame* dst_ );
+
+    private:
+      //Rows [begin, end) of a plane, blurred as one task.
+      struct Tile
+      {
+        const uint8_t* src;
+        int srcLinesize;
+        uint8_t* dst;
+        int dstLinesize;
+        int bytes;
+        int height;
+        int step;
+        int begin;
+        int end;
+        //In place, horizontally filtered rows around the tile, saved before
+        //the neighbours overwrite them.
+        std::vector < int16_t > context;
+      };
+
+      void updateKernel ( void );
+      void saveContext ( Tile& tile_ );
+      void blurTile ( Tile& tile_ );
+
+      float _sigma;
+      int _radius;
+      //Q14 taps from the edge to the center, in pairs for the SIMD
+      //multiply-add.
+      std::vector < int32_t > _weightPairs;
+      int _taps;
+
+      WorkerPool* _workers;
+      std::vector < Tile > _tiles;
   };
 }
 #endif //REMO_GAUSSFILTER_H
@@ -7,11 +7,16 @@ namespace remo
 		int targetHeight)
 	: dstWidth(targetWidth)
 	, dstHeight(targetHeight)
+	, tablesSrcWidth(0)
+	, tablesSrcHeight(0)
+	, bandHeight(1)
+	, samplingPolicy(SAMPLING_NEAREST)
+	, workers(nullptr)
 	{
 		int imgSize = dstHeight * (((dstWidth * 3) + 3) / 4) * 4;
 		dstBuffer.resize(imgSize);
 
-		setImageSampler<NearImageSampler>();
+		setImageSampler<SimdNearImageSampler>();
 	}
 
 	void ImageConverter::convert(
@@ -19,30 +24,109 @@ namespace remo
 		int srcWidth, 
 		int srcHeight)
 	{
-		// Build webstreamer readable image		
-		#pragma omp parallel
+		updateTables(srcWidth, srcHeight);
+
+		// Build webstreamer readable image, a band of rows per task
+		std::uint8_t * dst = reinterpret_cast<std::uint8_t *>(dstBuffer.data());
+		getWorkers()->parallelFor(dstHeight, bandHeight,
+			[this, srcBuffer, srcWidth, srcHeight, dst](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; i++)
+			{
+				sampler->sampleRow(srcBuffer, srcWidth, srcHeight, tables.rows[i],
+					tables.columns.data(), dstWidth, dst + i * dstWidth * 3);
+			}
+		});
+	}
+
+	bool ImageConverter::convert(
+		const AVFrame * frame)
+	{
+		AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+		bool packed = (format == AV_PIX_FMT_BGRA || format == AV_PIX_FMT_BGR0)
+			&& frame->linesize[0] == frame->width * 4;
+		if (packed && samplingPolicy == SAMPLING_NEAREST)
+		{
+			convert(const_cast<std::uint8_t **>(frame->data), frame->width, frame->height);
+			return true;
+		}
+
+		RowConverter rowConverter = findRowConverter(samplingPolicy, format);
+		if (!rowConverter)
+		{
+			return false;
+		}
+
+		updateTables(frame->width, frame->height);
+
+		ConverterSource src;
+		for (int p = 0; p < 3; p++)
+		{
+			src.data[p] = frame->data[p];
+			src.linesize[p] = frame->linesize[p];
+		}
+		src.width = frame->width;
+		src.height = frame->height;
+
+		std::uint8_t * dst = reinterpret_cast<std::uint8_t *>(dstBuffer.data());
+		getWorkers()->parallelFor(dstHeight, bandHeight,
+			[this, &src, rowConverter, dst](unsigned int begin, unsigned int end)
 		{
-			#pragma omp for schedule(static)
-		  for (int i = 0; i < dstHeight; i++) 
+			for (unsigned int i = begin; i < end; i++)
 			{
-		    for (int j = 0; j < dstWidth; j++) 
-				{
-		      int tempI = ((i * dstWidth) + j);
-		      int index = tempI * 3;
+				rowConverter(src, tables, i, dstWidth, dst + i * dstWidth * 3);
+			}
+		});
+		return true;
+	}
 
-					int frameI, frameJ;
-					remapIndexes(i, j, dstWidth, dstHeight, srcWidth, srcHeight, frameI, frameJ);
+	void ImageConverter::setWorkerPool ( WorkerPool * workerPool )
+	{
+		ownWorkers.reset();
+		workers = workerPool;
+	}
 
-					std::uint8_t r, g, b;
+	WorkerPool * ImageConverter::getWorkers ( void )
+	{
+		if (!workers)
+		{
+			ownWorkers.reset(new WorkerPool());
+			workers = ownWorkers.get();
+		}
+		return workers;
+	}
 
-					sampler->samplePixels(srcBuffer, srcWidth, srcHeight, frameI, frameJ, r, g, b);
+	void ImageConverter::updateTables(
+		int srcWidth,
+		int srcHeight)
+	{
+		if (srcWidth == tablesSrcWidth && srcHeight == tablesSrcHeight)
+		{
+			return;
+		}
 
-					dstBuffer[index] = r;
-					dstBuffer[index + 1] = g;
-					dstBuffer[index + 2] = b;
-		    }
-		  }
+		int unused;
+		tables.rows.resize(dstHeight);
+		for (int i = 0; i < dstHeight; i++)
+		{
+			remapIndexes(i, 0, dstWidth, dstHeight, srcWidth, srcHeight, tables.rows[i], unused);
 		}
+		tables.columns.resize(dstWidth);
+		for (int j = 0; j < dstWidth; j++)
+		{
+			remapIndexes(0, j, dstWidth, dstHeight, srcWidth, srcHeight, unused, tables.columns[j]);
+		}
+		tables.buildFilters(srcWidth, srcHeight, dstWidth, dstHeight);
+
+		// Bands sized so the source and destination rows they touch stay in
+		// a 256 KB L2 cache
+		const int cacheBytes = 256 * 1024;
+		int srcRowsPerRow = std::max(1, srcHeight / std::max(1, dstHeight));
+		int bytesPerRow = dstWidth * 3 + srcRowsPerRow * srcWidth * 4;
+		bandHeight = std::max(1, cacheBytes / std::max(1, bytesPerRow));
+
+		tablesSrcWidth = srcWidth;
+		tablesSrcHeight = srcHeight;
 	}
 
 	void ImageConverter::remapIndexes(
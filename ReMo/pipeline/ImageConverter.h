@@ -7,6 +7,8 @@
 #include <iostream>
 
 #include "AbstractImageSampler.h"
+#include "RowConverters.h"
+#include "../util/WorkerPool.h"
 
 namespace remo
 {
@@ -17,7 +19,20 @@ namespace remo
 			int dstWidth;
 			int dstHeight;
 
+			// Source coordinates of every destination row and column,
+			// valid for the tablesSrc size
+			ConverterTables tables;
+			int tablesSrcWidth;
+			int tablesSrcHeight;
+			// Destination rows converted per task
+			int bandHeight;
+
 			std::unique_ptr<AbstractImageSampler> sampler;
+
+			SAMPLING_POLICY samplingPolicy;
+
+			WorkerPool * workers;
+			std::unique_ptr<WorkerPool> ownWorkers;
 		public:
 			ImageConverter(
 				int targetWidth,
@@ -28,8 +43,21 @@ namespace remo
 				int srcWidth, 
 				int srcHeight);
 
+			// Converts a frame of any format supported by findRowConverter,
+			// with the sampling policy. BGRA frames sampled with nearest go
+			// through the image sampler. Returns false for other formats.
+			bool convert(
+				const AVFrame * frame);
+
 			std::vector<char> & getImage ( void );
 
+			void setSamplingPolicy ( SAMPLING_POLICY policy ) { samplingPolicy = policy; }
+			SAMPLING_POLICY getSamplingPolicy ( void ) { return samplingPolicy; }
+
+			// Pool running the row bands, by default the converter creates
+			// its own with a thread per core on the first conversion.
+			void setWorkerPool ( WorkerPool * workerPool );
+
 			template<class ImgSamplerType>
 			void setImageSampler ( void )
 			{
@@ -43,6 +71,12 @@ namespace remo
 			}
 
 		private:
+			WorkerPool * getWorkers ( void );
+
+			void updateTables(
+				int srcWidth,
+				int srcHeight);
+
 			void remapIndexes(
 				int i, int j, 
 				int dstWidth_, int dstHeight_, 
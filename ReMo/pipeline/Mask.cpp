@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Mask.h"
+#include "../util/Utils.h"
+
+namespace remo
+{
+  Mask::Mask ( void )
+    : FusableOperation ( )
+    , _rgb { 0, 0, 0 }
+    , _desc ( nullptr )
+    , _numComponents ( 0 )
+    , _values { 0, 0, 0 }
+  {
+    _description = "Mask";
+  }
+
+  void Mask::init ( void )
+  {
+    AVDictionaryEntry* regions_ = av_dict_get ( _options, "regions", nullptr, 0 );
+    if ( regions_ )
+    {
+      _regions.clear ( );
+      const char* it_ = regions_->value;
+      while ( it_ && *it_ )
+      {
+        Region region_ { 0, 0, 0, 0 };
+        if ( std::sscanf ( it_, "%d:%d:%d:%d", &region_.x, &region_.y,
+                           &region_.width, &region_.height ) == 4 )
+        {
+          addRegion ( region_.x, region_.y, region_.width, region_.height );
+        }
+        it_ = std::strchr ( it_, ',' );
+        it_ = it_ ? it_ + 1 : nullptr;
+      }
+    }
+    AVDictionaryEntry* color_ = av_dict_get ( _options, "color", nullptr, 0 );
+    if ( color_ )
+    {
+      unsigned long rgb_ = std::strtoul ( color_->value, nullptr, 16 );
+      setColor (( rgb_ >> 16 ) & 0xff, ( rgb_ >> 8 ) & 0xff, rgb_ & 0xff );
+    }
+
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO, "Initiating Mask, ",
+                                         _regions.size ( ), " regions." );
+  }
+
+  void Mask::addRegion ( int x_, int y_, int width_, int height_ )
+  {
+    if (( width_ > 0 ) && ( height_ > 0 ))
+    {
+      _regions.push_back ( Region { x_, y_, width_, height_ } );
+    }
+  }
+
+  void Mask::setColor ( uint8_t red_, uint8_t green_, uint8_t blue_ )
+  {
+    _rgb[0] = red_;
+    _rgb[1] = green_;
+    _rgb[2] = blue_;
+  }
+
+  bool Mask::prepare ( const AVFrame* frame_ )
+  {
+    _desc = av_pix_fmt_desc_get ( static_cast<AVPixelFormat>( frame_->format ));
+    if ( !isPlain8Bit ( _desc ))
+    {
+      return false;
+    }
+
+    const int r_ = _rgb[0];
+    const int g_ = _rgb[1];
+    const int b_ = _rgb[2];
+    if ( _desc->flags & AV_PIX_FMT_FLAG_RGB )
+    {
+      _numComponents = std::min ( 3, static_cast < int > ( _desc->nb_components ));
+      std::copy ( _rgb, _rgb + 3, _values );
+    }
+    else if ( _desc->nb_components < 3 )
+    {
+      //Gray is full range.
+      _numComponents = 1;
+      _values[0] = static_cast < uint8_t > (( 77 * r_ + 150 * g_ + 29 * b_ + 128 ) >> 8 );
+    }
+    else
+    {
+      //BT.601, limited range.
+      _numComponents = 3;
+      _values[0] = static_cast < uint8_t > (( 66 * r_ + 129 * g_ + 25 * b_ + 128 ) / 256 + 16 );
+      _values[1] = static_cast < uint8_t > (( -38 * r_ - 74 * g_ + 112 * b_ + 128 ) / 256 + 128 );
+      _values[2] = static_cast < uint8_t > (( 112 * r_ - 94 * g_ - 18 * b_ + 128 ) / 256 + 128 );
+    }
+    return true;
+  }
+
+  void Mask::processRows ( AVFrame* frame_, int begin_, int end_ )
+  {
+    const bool rgb_ = _desc->flags & AV_PIX_FMT_FLAG_RGB;
+    for ( const Region& region_ : _regions )
+    {
+      int x0_ = std::max ( 0, region_.x );
+      int x1_ = std::min ( frame_->width, region_.x + region_.width );
+      int y0_ = std::max ( begin_, region_.y );
+      int y1_ = std::min ( end_, region_.y + region_.height );
+      if (( x0_ >= x1_ ) || ( y0_ >= y1_ ))
+      {
+        continue;
+      }
+
+      for ( int c = 0; c < _numComponents; ++c )
+      {
+        const AVComponentDescriptor& comp_ = _desc->comp[c];
+        bool chroma_ = !rgb_ && (( c == 1 ) || ( c == 2 ));
+        int shiftW_ = chroma_ ? _desc->log2_chroma_w : 0;
+        bool chromaRows_ = ( comp_.plane == 1 ) || ( comp_.plane == 2 );
+        int shiftH_ = chromaRows_ ? _desc->log2_chroma_h : 0;
+
+        //Bands start on whole chroma rows, rounding out stays in the band.
+        int first_ = y0_ >> shiftH_;
+        int last_ = AV_CEIL_RSHIFT ( y1_, shiftH_ );
+        int left_ = x0_ >> shiftW_;
+        int right_ = AV_CEIL_RSHIFT ( x1_, shiftW_ );
+
+        for ( int y = first_; y < last_; ++y )
+        {
+          uint8_t* row_ = frame_->data[comp_.plane]
+                          + y * frame_->linesize[comp_.plane] + comp_.offset;
+          if ( comp_.step == 1 )
+          {
+            std::memset ( row_ + left_, _values[c], right_ - left_ );
+          }
+          else
+          {
+            for ( int x = left_; x < right_; ++x )
+            {
+              row_[x * comp_.step] = _values[c];
+            }
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef REMO_MASK_H
+#define REMO_MASK_H
+
+#include <cstdint>
+#include <vector>
+
+#include "FusableOperation.h"
+
+namespace remo
+{
+  //Fills rectangles of the frame with a solid colour, to hide parts of
+  //the desktop. Chroma samples touching a region are covered too. Options
+  //"regions" ("x:y:w:h,x:y:w:h...") and "color" (hex RRGGBB) are read on
+  //init ( ).
+  class Mask: public FusableOperation
+  {
+    public:
+      struct Region
+      {
+        int x;
+        int y;
+        int width;
+        int height;
+      };
+
+      Mask ( void );
+      ~Mask ( void ) = default;
+
+      virtual void init ( void );
+
+      virtual bool prepare ( const AVFrame* frame_ );
+      virtual void processRows ( AVFrame* frame_, int begin_, int end_ );
+
+      void addRegion ( int x_, int y_, int width_, int height_ );
+      void clearRegions ( void ) { _regions.clear ( ); }
+      const std::vector < Region >& getRegions ( void ) { return _regions; }
+      void setColor ( uint8_t red_, uint8_t green_, uint8_t blue_ );
+
+    private:
+      std::vector < Region > _regions;
+      uint8_t _rgb[3];
+
+      //Format of the current frame and the colour in its components.
+      const AVPixFmtDescriptor* _desc;
+      int _numComponents;
+      uint8_t _values[3];
+  };
+}
+#endif //REMO_MASK_H
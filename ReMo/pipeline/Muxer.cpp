@@ -18,12 +18,135 @@
  *
  */
 
+
 #include "Muxer.h"
+#include "../util/Utils.h"
 
 namespace remo
 {
-  Muxer::Muxer ( void ): FFOperation ( )
+  Muxer::Muxer ( AVFormatContext* formatCtx_,
+                 AVStream* stream_,
+                 AVRational timeBase_ )
+    : FFOperation ( )
+    , _formatCtx ( formatCtx_ )
+    , _stream ( stream_ )
+    , _timeBase ( timeBase_ )
+    , _stats ( nullptr )
+    , _numPackets ( 0 )
+    , _numBytes ( 0 )
   {
     _description = "Basic muxing Operation";
   }
+
+  void Muxer::setOutput ( AVFormatContext* formatCtx_,
+                          AVStream* stream_,
+                          AVRational timeBase_ )
+  {
+    std::lock_guard < std::mutex > lock_ ( _mtx );
+    _formatCtx = formatCtx_;
+    _stream = stream_;
+    _timeBase = timeBase_;
+  }
+
+  void Muxer::init ( void )
+  {
+    if (( _formatCtx == nullptr ) || ( _stream == nullptr ))
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Muxer without an output stream." );
+    }
+
+    _numPackets = 0;
+    _numBytes = 0;
+  }
+
+  void Muxer::apply ( void )
+  {
+    if (( _inAVPacket == nullptr ) || ( _inAVPacket->size == 0 ))
+    {
+      return;
+    }
+
+    if ( writePacket ( _inAVPacket ) < 0 )
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Error writing video frame." );
+    }
+  }
+
+  int Muxer::writePacket ( AVPacket* packet_ )
+  {
+    std::lock_guard < std::mutex > lock_ ( _mtx );
+
+    if ( _timeBase.num != 0 )
+    {
+      av_packet_rescale_ts ( packet_, _timeBase, _stream->time_base );
+    }
+    packet_->stream_index = _stream->index;
+
+    ++_numPackets;
+    _numBytes += packet_->size;
+
+    StageTimer writeTimer_ ( _stats );
+    writeTimer_.setBytes ( packet_->size );
+    return av_write_frame ( _formatCtx, packet_ );
+  }
+
+  int Muxer::writeTrailer ( void )
+  {
+    std::lock_guard < std::mutex > lock_ ( _mtx );
+    return av_write_trailer ( _formatCtx );
+  }
+
+  AVFormatContext* Muxer::openFormat ( const std::string& url_,
+                                       const AVCodecContext* codecCtx_,
+                                       const std::string& format_,
+                                       AVDictionary** options_ )
+  {
+    AVFormatContext* formatCtx_ = nullptr;
+    avformat_alloc_output_context2 ( &formatCtx_,
+                                     nullptr,
+                                     format_.empty ( ) ? nullptr : format_.c_str ( ),
+                                     url_.c_str ( ));
+    if ( !formatCtx_ )
+    {
+      return nullptr;
+    }
+
+    AVStream* stream_ = avformat_new_stream ( formatCtx_, nullptr );
+    bool opened_ = ( stream_ != nullptr )
+      && ( avcodec_parameters_from_context ( stream_->codecpar, codecCtx_ ) >= 0 );
+    if ( opened_ )
+    {
+      stream_->time_base = codecCtx_->time_base;
+      opened_ = ( formatCtx_->oformat->flags & AVFMT_NOFILE )
+        || ( avio_open2 ( &formatCtx_->pb,
+                          url_.c_str ( ),
+                          AVIO_FLAG_WRITE,
+                          nullptr,
+                          nullptr ) >= 0 );
+    }
+    opened_ = opened_ && ( avformat_write_header ( formatCtx_, options_ ) >= 0 );
+
+    if ( !opened_ )
+    {
+      closeFormat ( formatCtx_ );
+    }
+    return formatCtx_;
+  }
+
+  void Muxer::closeFormat ( AVFormatContext*& formatCtx_ )
+  {
+    if ( formatCtx_ == nullptr )
+    {
+      return;
+    }
+
+    if ( !( formatCtx_->oformat->flags & AVFMT_NOFILE ))
+    {
+      avio_closep ( &formatCtx_->pb );
+    }
+    avformat_free_context ( formatCtx_ );
+    formatCtx_ = nullptr;
+  }
 }
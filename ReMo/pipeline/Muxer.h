@@ -18,23 +18,76 @@
  *
  */
 
+
 #ifndef REMO_MUXER_H
 #define REMO_MUXER_H
 
+#include <atomic>
+#include <mutex>
 #include <string>
+
 #include "../util/ffdefs.h"
+#include "../util/StageStats.h"
 #include "FFOperation.h"
 
 namespace remo
 {
+  //Writes encoded packets into one stream of an opened output (the header
+  //already written). apply ( ) muxes _inAVPacket, the Encoder calls
+  //writePacket ( ) from its own thread. Packets come in timeBase_ (the one
+  //of the codec) and are rescaled to the one of the stream.
   class Muxer: public FFOperation
   {
     public:
-      Muxer ( void );
+      Muxer ( AVFormatContext* formatCtx_ = nullptr,
+              AVStream* stream_ = nullptr,
+              AVRational timeBase_ = AVRational { 0, 1 } );
       virtual ~Muxer ( void ) = default;
 
-      virtual void init ( void ) = 0;
-      virtual void apply ( void ) = 0;
+      Muxer ( const Muxer& ) = delete;
+      Muxer& operator= ( const Muxer& ) = delete;
+
+      virtual void init ( void );
+      virtual void apply ( void );
+      virtual bool writesFrame ( void ) { return false; }
+
+      //A timeBase_ of 0/1 leaves the timestamps as they come.
+      void setOutput ( AVFormatContext* formatCtx_,
+                       AVStream* stream_,
+                       AVRational timeBase_ = AVRational { 0, 1 } );
+
+      //Write time of each packet, and its size, recorded if set.
+      void setStats ( StageStats* stats_ ) { _stats = stats_; }
+
+      //Time base of the packets written, the one of the codec.
+      void setTimeBase ( AVRational timeBase_ ) { _timeBase = timeBase_; }
+
+      //Thread safe. The packet is rescaled and left referenced.
+      virtual int writePacket ( AVPacket* packet_ );
+      virtual int writeTrailer ( void );
+
+      unsigned long getNumPackets ( void ) { return _numPackets; }
+      unsigned long long getNumBytes ( void ) { return _numBytes; }
+
+    protected:
+      //Output with one stream of the codec parameters, its header written.
+      //The container is guessed from url_ when format_ is empty. nullptr
+      //on error.
+      static AVFormatContext* openFormat ( const std::string& url_,
+                                           const AVCodecContext* codecCtx_,
+                                           const std::string& format_ = "",
+                                           AVDictionary** options_ = nullptr );
+      //Closes and frees an output of openFormat ( ), sets it to nullptr.
+      static void closeFormat ( AVFormatContext*& formatCtx_ );
+
+      AVFormatContext* _formatCtx;
+      AVStream* _stream;
+      AVRational _timeBase;
+      StageStats* _stats;
+
+      std::mutex _mtx;
+      std::atomic < unsigned long > _numPackets;
+      std::atomic < unsigned long long > _numBytes;
   };
 }
 #endif //REMO_MUXER_H
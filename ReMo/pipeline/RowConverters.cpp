@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+
+#include "RowConverters.h"
+
+namespace remo
+{
+  namespace
+  {
+    //Without branches, noisy YUV makes them unpredictable.
+    inline uint8_t clampByte ( int value_ )
+    {
+      value_ &= ~( value_ >> 31 );
+      return static_cast < uint8_t > ( value_ | (( 255 - value_ ) >> 31 ));
+    }
+
+    //Formats read three native channels of a source pixel and turn them
+    //into RGB. Sampling works on the native channels, YUV to RGB is affine
+    //so filtering before the conversion gives the same result.
+    //The separable filters run the vertical pass on the raw bytes of each
+    //plane (PLANES, planeBytes, planeRow) and read the native channels
+    //back from the filtered lines with fetch.
+    template < int R, int G, int B, int BYTES >
+    struct PackedFormat
+    {
+      static const int PLANES = 1;
+
+      static inline void read ( const ConverterSource& src_, int x_, int y_, int* c_ )
+      {
+        const uint8_t* pixel_ = src_.data[0] + y_ * src_.linesize[0] + x_ * BYTES;
+        c_[0] = pixel_[R];
+        c_[1] = pixel_[G];
+        c_[2] = pixel_[B];
+      }
+
+      static inline int planeBytes ( const ConverterSource& src_, int )
+      {
+        return src_.width * BYTES;
+      }
+
+      static inline int planeRow ( int y_, int ) { return y_; }
+
+      static inline void fetch ( uint16_t* const* lines_, int x_, uint32_t* c_ )
+      {
+        const uint16_t* pixel_ = lines_[0] + x_ * BYTES;
+        c_[0] = pixel_[R];
+        c_[1] = pixel_[G];
+        c_[2] = pixel_[B];
+      }
+
+      static inline void toRGB ( const int* c_, uint8_t* rgb_ )
+      {
+        rgb_[0] = static_cast < uint8_t > ( c_[0] );
+        rgb_[1] = static_cast < uint8_t > ( c_[1] );
+        rgb_[2] = static_cast < uint8_t > ( c_[2] );
+      }
+    };
+
+    typedef PackedFormat < 2, 1, 0, 4 > BGRAFormat;
+    typedef PackedFormat < 0, 1, 2, 3 > RGB24Format;
+
+    //BT.601 in 8-bit fixed point, limited (video) or full (JPEG) range.
+    template < bool FULL_RANGE >
+    struct YUVToRGB
+    {
+      static inline void toRGB ( const int* c_, uint8_t* rgb_ )
+      {
+        int u_ = c_[1] - 128;
+        int v_ = c_[2] - 128;
+        if ( FULL_RANGE )
+        {
+          int y_ = c_[0] << 8;
+          rgb_[0] = clampByte (( y_ + 359 * v_ + 128 ) >> 8 );
+          rgb_[1] = clampByte (( y_ - 88 * u_ - 183 * v_ + 128 ) >> 8 );
+          rgb_[2] = clampByte (( y_ + 454 * u_ + 128 ) >> 8 );
+        }
+        else
+        {
+          int y_ = 298 * ( c_[0] - 16 );
+          rgb_[0] = clampByte (( y_ + 409 * v_ + 128 ) >> 8 );
+          rgb_[1] = clampByte (( y_ - 100 * u_ - 208 * v_ + 128 ) >> 8 );
+          rgb_[2] = clampByte (( y_ + 516 * u_ + 128 ) >> 8 );
+        }
+      }
+
+      //Chroma rows are shared by two luma rows.
+      static inline int planeRow ( int y_, int plane_ ) { return plane_ ? y_ >> 1 : y_; }
+    };
+
+    template < bool FULL_RANGE >
+    struct YUV420PFormat: public YUVToRGB < FULL_RANGE >
+    {
+      static const int PLANES = 3;
+
+      static inline void read ( const ConverterSource& src_, int x_, int y_, int* c_ )
+      {
+        int chromaY_ = y_ >> 1;
+        int chromaX_ = x_ >> 1;
+        c_[0] = src_.data[0][y_ * src_.linesize[0] + x_];
+        c_[1] = src_.data[1][chromaY_ * src_.linesize[1] + chromaX_];
+        c_[2] = src_.data[2][chromaY_ * src_.linesize[2] + chromaX_];
+      }
+
+      static inline int planeBytes ( const ConverterSource& src_, int plane_ )
+      {
+        return plane_ ? ( src_.width + 1 ) >> 1 : src_.width;
+      }
+
+      static inline void fetch ( uint16_t* const* lines_, int x_, uint32_t* c_ )
+      {
+        c_[0] = lines_[0][x_];
+        c_[1] = lines_[1][x_ >> 1];
+        c_[2] = lines_[2][x_ >> 1];
+      }
+    };
+
+    struct NV12Format: public YUVToRGB < false >
+    {
+      static const int PLANES = 2;
+
+      static inline void read ( const ConverterSource& src_, int x_, int y_, int* c_ )
+      {
+        const uint8_t* uv_ = src_.data[1] + ( y_ >> 1 ) * src_.linesize[1] + ( x_ & ~1 );
+        c_[0] = src_.data[0][y_ * src_.linesize[0] + x_];
+        c_[1] = uv_[0];
+        c_[2] = uv_[1];
+      }
+
+      static inline int planeBytes ( const ConverterSource& src_, int plane_ )
+      {
+        return plane_ ? ( src_.width + 1 ) & ~1 : src_.width;
+      }
+
+      static inline void fetch ( uint16_t* const* lines_, int x_, uint32_t* c_ )
+      {
+        c_[0] = lines_[0][x_];
+        c_[1] = lines_[1][x_ & ~1];
+        c_[2] = lines_[1][x_ | 1];
+      }
+    };
+
+    template < class Format >
+    struct NearestSampling
+    {
+      static void convert ( const ConverterSource& src_,
+                            const ConverterTables& tables_,
+                            int i_,
+                            int dstWidth_,
+                            uint8_t* dstRow_ )
+      {
+        const int y_ = tables_.rows[i_];
+        int c_[3];
+        for ( int j = 0; j < dstWidth_; ++j, dstRow_ += 3 )
+        {
+          Format::read ( src_, tables_.columns[j], y_, c_ );
+          Format::toRGB ( c_, dstRow_ );
+        }
+      }
+    };
+
+    //Per thread output of the vertical pass, one line per plane. They
+    //only grow, so steady conversion does not allocate.
+    template < class Format >
+    uint16_t* const* getFilterLines ( const ConverterSource& src_ )
+    {
+      static thread_local std::vector < uint16_t > planes_[3];
+      static thread_local uint16_t* lines_[3];
+      for ( int p = 0; p < Format::PLANES; ++p )
+      {
+        std::size_t size_ = Format::planeBytes ( src_, p );
+        if ( planes_[p].size ( ) < size_ )
+        {
+          planes_[p].resize ( size_ );
+        }
+        lines_[p] = planes_[p].data ( );
+      }
+      return lines_;
+    }
+
+    inline const uint8_t* planeLine ( const ConverterSource& src_, int plane_, int row_ )
+    {
+      return src_.data[plane_] + row_ * src_.linesize[plane_];
+    }
+
+    //Separable area average. The vertical pass sums the source rows of
+    //the destination row (at most 256, so 16 bits hold the sum), the
+    //horizontal one sums the columns and scales by both spans at once.
+    template < class Format >
+    struct BoxSampling
+    {
+      static void convert ( const ConverterSource& src_,
+                            const ConverterTables& tables_,
+                            int i_,
+                            int dstWidth_,
+                            uint8_t* dstRow_ )
+      {
+        uint16_t* const* lines_ = getFilterLines < Format > ( src_ );
+        const int y0_ = tables_.rowStarts[i_];
+        const int y1_ = tables_.rowEnds[i_];
+
+        for ( int p = 0; p < Format::PLANES; ++p )
+        {
+          uint16_t* sum_ = lines_[p];
+          const int size_ = Format::planeBytes ( src_, p );
+          const uint8_t* first_ = planeLine ( src_, p, Format::planeRow ( y0_, p ));
+          if ( y1_ - y0_ == 1 )
+          {
+            for ( int k = 0; k < size_; ++k )
+            {
+              sum_[k] = first_[k];
+            }
+            continue;
+          }
+
+          const uint8_t* second_ = planeLine ( src_, p, Format::planeRow ( y0_ + 1, p ));
+          for ( int k = 0; k < size_; ++k )
+          {
+            sum_[k] = static_cast < uint16_t > ( first_[k] + second_[k] );
+          }
+          for ( int y = y0_ + 2; y < y1_; ++y )
+          {
+            const uint8_t* row_ = planeLine ( src_, p, Format::planeRow ( y, p ));
+            for ( int k = 0; k < size_; ++k )
+            {
+              sum_[k] = static_cast < uint16_t > ( sum_[k] + row_[k] );
+            }
+          }
+        }
+
+        const uint64_t rowScale_ = tables_.rowScales[i_];
+        int c_[3];
+        uint32_t pixel_[3];
+        for ( int j = 0; j < dstWidth_; ++j, dstRow_ += 3 )
+        {
+          uint32_t acc_[3] = { 0, 0, 0 };
+          for ( int x = tables_.columnStarts[j]; x < tables_.columnEnds[j]; ++x )
+          {
+            Format::fetch ( lines_, x, pixel_ );
+            acc_[0] += pixel_[0];
+            acc_[1] += pixel_[1];
+            acc_[2] += pixel_[2];
+          }
+          //65536 / rows * 65536 / columns.
+          const uint64_t scale_ = rowScale_ * tables_.columnScales[j];
+          for ( int k = 0; k < 3; ++k )
+          {
+            c_[k] = static_cast < int > (( acc_[k] * scale_ + ( 1ull << 31 )) >> 32 );
+          }
+          Format::toRGB ( c_, dstRow_ );
+        }
+      }
+    };
+
+    //Separable 2-tap filter with 8-bit weights, the vertical pass blends
+    //two source rows into 8.8 fixed point.
+    template < class Format >
+    struct BilinearSampling
+    {
+      static void convert ( const ConverterSource& src_,
+                            const ConverterTables& tables_,
+                            int i_,
+                            int dstWidth_,
+                            uint8_t* dstRow_ )
+      {
+        uint16_t* const* lines_ = getFilterLines < Format > ( src_ );
+        const int y0_ = tables_.rowTaps[i_];
+        const int y1_ = std::min ( y0_ + 1, src_.height - 1 );
+        const uint32_t wy_ = tables_.rowWeights[i_];
+
+        for ( int p = 0; p < Format::PLANES; ++p )
+        {
+          uint16_t* blend_ = lines_[p];
+          const int size_ = Format::planeBytes ( src_, p );
+          const uint8_t* top_ = planeLine ( src_, p, Format::planeRow ( y0_, p ));
+          const uint8_t* bottom_ = planeLine ( src_, p, Format::planeRow ( y1_, p ));
+          for ( int k = 0; k < size_; ++k )
+          {
+            blend_[k] = static_cast < uint16_t > ( top_[k] * ( 256 - wy_ ) +
+                                                   bottom_[k] * wy_ );
+          }
+        }
+
+        const int lastColumn_ = src_.width - 1;
+        int c_[3];
+        uint32_t left_[3];
+        uint32_t right_[3];
+        for ( int j = 0; j < dstWidth_; ++j, dstRow_ += 3 )
+        {
+          const int x0_ = tables_.columnTaps[j];
+          const uint32_t wx_ = tables_.columnWeights[j];
+          Format::fetch ( lines_, x0_, left_ );
+          Format::fetch ( lines_, std::min ( x0_ + 1, lastColumn_ ), right_ );
+          for ( int k = 0; k < 3; ++k )
+          {
+            c_[k] = static_cast < int > (
+              ( left_[k] * ( 256 - wx_ ) + right_[k] * wx_ + ( 1 << 15 )) >> 16 );
+          }
+          Format::toRGB ( c_, dstRow_ );
+        }
+      }
+    };
+
+    template < class Format >
+    RowConverter rowConverterFor ( SAMPLING_POLICY policy_ )
+    {
+      switch ( policy_ )
+      {
+        case SAMPLING_NEAREST:
+          return NearestSampling < Format >::convert;
+        case SAMPLING_BOX:
+          return BoxSampling < Format >::convert;
+        case SAMPLING_BILINEAR:
+          return BilinearSampling < Format >::convert;
+        default:
+          return nullptr;
+      }
+    }
+  }
+
+  void ConverterTables::buildFilters ( int srcWidth_, int srcHeight_,
+                                       int dstWidth_, int dstHeight_ )
+  {
+    auto buildAxis_ = [ ] ( int src_, int dst_,
+                            std::vector < int >& starts_,
+                            std::vector < int >& ends_,
+                            std::vector < int >& scales_,
+                            std::vector < int >& taps_,
+                            std::vector < int >& weights_ )
+    {
+      starts_.resize ( dst_ );
+      scales_.resize ( dst_ );
+      ends_.resize ( dst_ );
+      taps_.resize ( dst_ );
+      weights_.resize ( dst_ );
+      for ( int i = 0; i < dst_; ++i )
+      {
+        //At least one source pixel when upscaling, at most 256.
+        int start_ = static_cast < int > ( int64_t ( i ) * src_ / dst_ );
+        int end_ = static_cast < int > ( int64_t ( i + 1 ) * src_ / dst_ );
+        starts_[i] = std::min ( start_, src_ - 1 );
+        ends_[i] = std::max ( starts_[i] + 1, std::min ( end_, src_ ));
+        ends_[i] = std::min ( ends_[i], starts_[i] + 256 );
+        scales_[i] = ( 1 << 16 ) / ( ends_[i] - starts_[i] );
+
+        //Pixel centers aligned, in 1/256 of source pixel.
+        int64_t pos_ = ( int64_t ( 2 * i + 1 ) * src_ * 256 ) / ( 2 * dst_ ) - 128;
+        pos_ = std::max < int64_t > ( 0, pos_ );
+        int tap_ = static_cast < int > ( pos_ >> 8 );
+        if ( tap_ >= src_ - 1 )
+        {
+          taps_[i] = src_ - 1;
+          weights_[i] = 0;
+        }
+        else
+        {
+          taps_[i] = tap_;
+          weights_[i] = static_cast < int > ( pos_ & 255 );
+        }
+      }
+    };
+
+    buildAxis_ ( srcWidth_, dstWidth_, columnStarts, columnEnds, columnScales,
+                 columnTaps, columnWeights );
+    buildAxis_ ( srcHeight_, dstHeight_, rowStarts, rowEnds, rowScales,
+                 rowTaps, rowWeights );
+  }
+
+  RowConverter findRowConverter ( SAMPLING_POLICY policy_, AVPixelFormat format_ )
+  {
+    switch ( format_ )
+    {
+      case AV_PIX_FMT_BGRA:
+      case AV_PIX_FMT_BGR0:
+        return rowConverterFor < BGRAFormat > ( policy_ );
+      case AV_PIX_FMT_RGB24:
+        return rowConverterFor < RGB24Format > ( policy_ );
+      case AV_PIX_FMT_YUV420P:
+        return rowConverterFor < YUV420PFormat < false > > ( policy_ );
+      case AV_PIX_FMT_YUVJ420P:
+        return rowConverterFor < YUV420PFormat < true > > ( policy_ );
+      case AV_PIX_FMT_NV12:
+        return rowConverterFor < NV12Format > ( policy_ );
+      default:
+        return nullptr;
+    }
+  }
+}
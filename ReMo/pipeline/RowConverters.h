@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_ROWCONVERTERS_H
+#define REMO_ROWCONVERTERS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../util/ffdefs.h"
+
+namespace remo
+{
+  enum SAMPLING_POLICY
+  {
+    SAMPLING_NEAREST = 0,
+    //Average of the source area covered by the destination pixel.
+    SAMPLING_BOX,
+    SAMPLING_BILINEAR,
+    NUM_SAMPLING_POLICIES
+  };
+
+  //Planes of the source frame, strides in bytes.
+  struct ConverterSource
+  {
+    const uint8_t* data[3];
+    int linesize[3];
+    int width;
+    int height;
+  };
+
+  //Source coordinates of each destination row and column for one
+  //geometry, shared by all the formats.
+  struct ConverterTables
+  {
+    //Nearest source row/column.
+    std::vector < int > rows;
+    std::vector < int > columns;
+    //Box: source range [start, end) of each destination row/column, and
+    //65536 / its length.
+    std::vector < int > rowStarts;
+    std::vector < int > rowEnds;
+    std::vector < int > rowScales;
+    std::vector < int > columnStarts;
+    std::vector < int > columnEnds;
+    std::vector < int > columnScales;
+    //Bilinear: first tap and the weight (0-256) of the next one.
+    std::vector < int > rowTaps;
+    std::vector < int > rowWeights;
+    std::vector < int > columnTaps;
+    std::vector < int > columnWeights;
+
+    //rows and columns are filled by the caller.
+    void buildFilters ( int srcWidth_, int srcHeight_,
+                        int dstWidth_, int dstHeight_ );
+  };
+
+  //Writes dstWidth_ RGB24 pixels of destination row i_.
+  typedef void ( *RowConverter ) ( const ConverterSource& src_,
+                                   const ConverterTables& tables_,
+                                   int i_,
+                                   int dstWidth_,
+                                   uint8_t* dstRow_ );
+
+  //Converter compiled for the policy and format, nullptr when the format
+  //is not supported (BGRA/BGR0, RGB24, YUV420P/YUVJ420P and NV12 are).
+  RowConverter findRowConverter ( SAMPLING_POLICY policy_, AVPixelFormat format_ );
+}
+
+#endif //REMO_ROWCONVERTERS_H
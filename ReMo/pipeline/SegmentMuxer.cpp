@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+
+#include "SegmentMuxer.h"
+#include "../util/Utils.h"
+
+namespace remo
+{
+  SegmentMuxer::SegmentMuxer ( const std::string& prefix_,
+                               const std::string& extension_,
+                               const AVCodecContext* codecCtx_ )
+    : Muxer ( )
+    , _prefix ( prefix_ )
+    , _extension ( extension_ )
+    , _codecCtx ( nullptr )
+    , _segmentDuration ( 10.0 )
+    , _segmentSize ( 0 )
+    , _quota ( 0 )
+    , _fragmented ( true )
+    , _firstSequence ( 1 )
+    , _nextSequence ( 1 )
+    , _diskUsage ( 0 )
+    , _maxDuration ( 0.0 )
+    , _startTs ( AV_NOPTS_VALUE )
+    , _lastTs ( AV_NOPTS_VALUE )
+    , _bytes ( 0 )
+  {
+    _description = "Segmented output " + getPlaylistName ( );
+    setCodecContext ( codecCtx_ );
+  }
+
+  SegmentMuxer::~SegmentMuxer ( void )
+  {
+    if ( _formatCtx != nullptr )
+    {
+      closeSegment ( _lastTs, false );
+    }
+  }
+
+  void SegmentMuxer::setCodecContext ( const AVCodecContext* codecCtx_ )
+  {
+    _codecCtx = codecCtx_;
+    if ( _codecCtx != nullptr )
+    {
+      _timeBase = _codecCtx->time_base;
+    }
+  }
+
+  void SegmentMuxer::init ( void )
+  {
+    if ( _codecCtx == nullptr )
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Segment muxer without a codec context." );
+    }
+
+    AVDictionaryEntry* entry_ = av_dict_get ( _options, "segment_time", nullptr, 0 );
+    if ( entry_ )
+    {
+      _segmentDuration = std::max ( 0.0, std::atof ( entry_->value ));
+    }
+    entry_ = av_dict_get ( _options, "segment_size", nullptr, 0 );
+    if ( entry_ )
+    {
+      _segmentSize = std::strtoull ( entry_->value, nullptr, 10 );
+    }
+    entry_ = av_dict_get ( _options, "quota", nullptr, 0 );
+    if ( entry_ )
+    {
+      _quota = std::strtoull ( entry_->value, nullptr, 10 );
+    }
+    entry_ = av_dict_get ( _options, "fragmented", nullptr, 0 );
+    if ( entry_ )
+    {
+      _fragmented = std::atoi ( entry_->value ) != 0;
+    }
+
+    std::lock_guard < std::mutex > lock_ ( _mtx );
+    if ( _formatCtx != nullptr )
+    {
+      closeSegment ( _lastTs, true );
+    }
+
+    //The first segment is opened by the first packet, its start time.
+    _segments.clear ( );
+    _firstSequence = 1;
+    _nextSequence = 1;
+    _diskUsage = 0;
+    _maxDuration = 0.0;
+    _numPackets = 0;
+    _numBytes = 0;
+  }
+
+  std::string SegmentMuxer::segmentName ( unsigned long sequence_ )
+  {
+    char number_[32];
+    std::snprintf ( number_, sizeof ( number_ ), "_%06lu.", sequence_ );
+    return _prefix + number_ + _extension;
+  }
+
+  bool SegmentMuxer::openSegment ( int64_t startTs_ )
+  {
+    std::string fileName_ = segmentName ( _nextSequence );
+
+    AVDictionary* options_ = nullptr;
+    if ( _fragmented )
+    {
+      //Left unused by the containers other than MP4/MOV.
+      av_dict_set ( &options_, "movflags",
+                    "frag_keyframe+empty_moov+default_base_moof", 0 );
+    }
+    _formatCtx = openFormat ( fileName_, _codecCtx, "", &options_ );
+    av_dict_free ( &options_ );
+    if ( _formatCtx == nullptr )
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "Unable to open segment ", fileName_ );
+      return false;
+    }
+
+    _stream = _formatCtx->streams[0];
+    _startTs = startTs_;
+    _lastTs = startTs_;
+    _bytes = 0;
+    return true;
+  }
+
+  int SegmentMuxer::closeSegment ( int64_t endTs_, bool ended_ )
+  {
+    int value = av_write_trailer ( _formatCtx );
+    uint64_t bytes_ = _formatCtx->pb ? avio_tell ( _formatCtx->pb ) : _bytes;
+    closeFormat ( _formatCtx );
+    _stream = nullptr;
+
+    double duration_ = 0.0;
+    if (( _startTs != AV_NOPTS_VALUE ) && ( endTs_ != AV_NOPTS_VALUE ))
+    {
+      duration_ = ( endTs_ - _startTs ) * av_q2d ( _timeBase );
+    }
+    _segments.push_back ( Segment { segmentName ( _nextSequence ), duration_, bytes_ } );
+    ++_nextSequence;
+    _diskUsage += bytes_;
+    _maxDuration = std::max ( _maxDuration, duration_ );
+
+    applyQuota ( );
+    writePlaylist ( ended_ );
+    return value;
+  }
+
+  void SegmentMuxer::applyQuota ( void )
+  {
+    //The newest segment is always kept.
+    while (( _quota > 0 ) && ( _diskUsage > _quota ) && ( _segments.size ( ) > 1 ))
+    {
+      const Segment& oldest_ = _segments.front ( );
+      if ( std::remove ( oldest_.fileName.c_str ( )) != 0 )
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                             "Unable to delete segment ",
+                                             oldest_.fileName );
+      }
+      _diskUsage -= oldest_.bytes;
+      _segments.pop_front ( );
+      ++_firstSequence;
+    }
+  }
+
+  void SegmentMuxer::writePlaylist ( bool ended_ )
+  {
+    //Written aside and renamed, a reader never sees half a playlist.
+    std::string playlist_ = getPlaylistName ( );
+    std::string temp_ = playlist_ + ".tmp";
+    {
+      std::ofstream file_ ( temp_ );
+      file_ << "#EXTM3U\n"
+            << "#EXT-X-VERSION:3\n"
+            << "#EXT-X-TARGETDURATION:" << std::ceil ( _maxDuration ) << "\n"
+            << "#EXT-X-MEDIA-SEQUENCE:" << _firstSequence << "\n";
+      for ( const Segment& segment_ : _segments )
+      {
+        //Relative to the playlist, that is next to the segments.
+        std::string::size_type slash_ = segment_.fileName.find_last_of ( "/\\" );
+        file_ << "#EXTINF:" << std::fixed << std::setprecision ( 3 )
+              << segment_.duration << ",\n"
+              << ( slash_ == std::string::npos ? segment_.fileName
+                                               : segment_.fileName.substr ( slash_ + 1 ))
+              << "\n";
+      }
+      if ( ended_ )
+      {
+        file_ << "#EXT-X-ENDLIST\n";
+      }
+      if ( !file_ )
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                             "Unable to write the playlist ",
+                                             playlist_ );
+        return;
+      }
+    }
+
+    if ( std::rename ( temp_.c_str ( ), playlist_.c_str ( )) != 0 )
+    {
+      std::remove ( playlist_.c_str ( ));
+      std::rename ( temp_.c_str ( ), playlist_.c_str ( ));
+    }
+  }
+
+  int SegmentMuxer::writePacket ( AVPacket* packet_ )
+  {
+    std::lock_guard < std::mutex > lock_ ( _mtx );
+
+    int64_t ts_ = ( packet_->pts != AV_NOPTS_VALUE ) ? packet_->pts : packet_->dts;
+
+    //A segment only starts on a keyframe, to be decodable on its own.
+    if (( _formatCtx != nullptr ) && ( packet_->flags & AV_PKT_FLAG_KEY )
+      && ( ts_ != AV_NOPTS_VALUE ) && ( _startTs != AV_NOPTS_VALUE ))
+    {
+      double elapsed_ = ( ts_ - _startTs ) * av_q2d ( _timeBase );
+      if ((( _segmentDuration > 0.0 ) && ( elapsed_ >= _segmentDuration ))
+        || (( _segmentSize > 0 ) && ( _bytes >= _segmentSize )))
+      {
+        int value = closeSegment ( ts_, false );
+        if ( value < 0 )
+        {
+          return value;
+        }
+      }
+    }
+
+    if (( _formatCtx == nullptr ) && !openSegment ( ts_ ))
+    {
+      return AVERROR( EIO );
+    }
+
+    if ( ts_ != AV_NOPTS_VALUE )
+    {
+      if ( _startTs == AV_NOPTS_VALUE )
+      {
+        _startTs = ts_;
+      }
+      int64_t end_ = ts_ + packet_->duration;
+      _lastTs = ( _lastTs == AV_NOPTS_VALUE ) ? end_ : std::max ( _lastTs, end_ );
+    }
+
+    av_packet_rescale_ts ( packet_, _timeBase, _stream->time_base );
+    packet_->stream_index = _stream->index;
+
+    ++_numPackets;
+    _numBytes += packet_->size;
+    _bytes += packet_->size;
+
+    StageTimer writeTimer_ ( _stats );
+    writeTimer_.setBytes ( packet_->size );
+    return av_write_frame ( _formatCtx, packet_ );
+  }
+
+  int SegmentMuxer::writeTrailer ( void )
+  {
+    std::lock_guard < std::mutex > lock_ ( _mtx );
+    if ( _formatCtx == nullptr )
+    {
+      return 0;
+    }
+    return closeSegment ( _lastTs, true );
+  }
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef REMO_SEGMENTMUXER_H
+#define REMO_SEGMENTMUXER_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "Muxer.h"
+
+namespace remo
+{
+  //Rolling recording: the packets of one Encoder go to a sequence of
+  //files, prefix_000001.ts, prefix_000002.ts..., started on a keyframe
+  //once the current one is long or big enough. An HLS playlist,
+  //prefix.m3u8, lists the segments on disk and is rewritten after each
+  //one. With a quota the oldest segments are deleted, so a 24/7 run keeps
+  //flat memory and disk. MPEG-TS segments, the default, play in any HLS
+  //player. Other extensions are written as standalone files, fragmented
+  //in MP4 so a crash only loses the last fragment, but the version 3
+  //playlist is not valid HLS for them. Timestamps are kept continuous
+  //across segments.
+  //
+  //Options, read on init ( ):
+  //  "segment_time"  seconds per segment, 10 by default (0 no limit).
+  //  "segment_size"  bytes per segment (0, the default, no limit).
+  //  "quota"         bytes of segments kept on disk (0, the default, all).
+  //                  Only closed segments count, the one being written can
+  //                  take the disk use over it by up to one segment.
+  //  "fragmented"    0 writes plain MP4 segments.
+  class SegmentMuxer: public Muxer
+  {
+    public:
+      //The container is guessed from extension_.
+      SegmentMuxer ( const std::string& prefix_ = "segment",
+                     const std::string& extension_ = "ts",
+                     const AVCodecContext* codecCtx_ = nullptr );
+      virtual ~SegmentMuxer ( void );
+
+      virtual void init ( void );
+
+      //Stream parameters and time base of the packets. Before init ( ).
+      void setCodecContext ( const AVCodecContext* codecCtx_ );
+      void setSegmentDuration ( double seconds_ ) { _segmentDuration = seconds_; }
+      void setSegmentSize ( uint64_t bytes_ ) { _segmentSize = bytes_; }
+      //Checked when a segment closes, see the "quota" option.
+      void setQuota ( uint64_t bytes_ ) { _quota = bytes_; }
+      void setFragmented ( bool fragmented_ ) { _fragmented = fragmented_; }
+
+      //Starts a new segment on the keyframes that reach the limits.
+      virtual int writePacket ( AVPacket* packet_ );
+      //Closes the last segment and ends the playlist.
+      virtual int writeTrailer ( void );
+
+      std::string getPlaylistName ( void ) { return _prefix + ".m3u8"; }
+      unsigned int getNumSegments ( void ) { return _segments.size ( ); }
+      unsigned long getNumDeleted ( void ) { return _firstSequence - 1; }
+      uint64_t getDiskUsage ( void ) { return _diskUsage; }
+
+    protected:
+      struct Segment
+      {
+        std::string fileName;
+        double duration;
+        uint64_t bytes;
+      };
+
+      bool openSegment ( int64_t startTs_ );
+      //Adds the segment to the playlist, ended_ closes the playlist too.
+      int closeSegment ( int64_t endTs_, bool ended_ );
+      void applyQuota ( void );
+      void writePlaylist ( bool ended_ );
+      std::string segmentName ( unsigned long sequence_ );
+
+      std::string _prefix;
+      std::string _extension;
+      const AVCodecContext* _codecCtx;
+
+      double _segmentDuration;
+      uint64_t _segmentSize;
+      uint64_t _quota;
+      bool _fragmented;
+
+      //Segments on disk, the first one is _firstSequence.
+      std::deque < Segment > _segments;
+      unsigned long _firstSequence;
+      unsigned long _nextSequence;
+      uint64_t _diskUsage;
+      double _maxDuration;
+
+      //Segment being written.
+      int64_t _startTs;
+      int64_t _lastTs;
+      uint64_t _bytes;
+  };
+}
+#endif //REMO_SEGMENTMUXER_H
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "TeeMuxer.h"
+#include "../util/Utils.h"
+
+namespace remo
+{
+  TeeMuxer::TeeMuxer ( AVRational timeBase_ )
+    : Muxer ( nullptr, nullptr, timeBase_ )
+    , _running ( false )
+  {
+    _description = "Tee muxing Operation";
+  }
+
+  TeeMuxer::~TeeMuxer ( void )
+  {
+    stop ( );
+    for ( auto& output_ : _outputs )
+    {
+      if ( output_->owned )
+      {
+        closeFormat ( output_->formatCtx );
+      }
+    }
+  }
+
+  void TeeMuxer::init ( void )
+  {
+    if ( _outputs.empty ( ))
+    {
+      Utils::getInstance ( )->getErrorManager ( )
+                            ->criticalError ( "Tee muxer without outputs." );
+    }
+
+    stop ( );
+    _numPackets = 0;
+    _numBytes = 0;
+
+    for ( auto& output_ : _outputs )
+    {
+      output_->queue.reset ( new SPSCQueue < AVPacket* > ( output_->queueDepth ));
+      output_->waitKeyframe = false;
+      output_->dropped = 0;
+      output_->failed = false;
+      output_->stats->reset ( );
+      if ( output_->muxer != nullptr )
+      {
+        output_->muxer->init ( );
+      }
+      output_->thread = std::thread ( &TeeMuxer::writerThread, this, output_.get ( ));
+    }
+    _running = true;
+  }
+
+  int TeeMuxer::addOutput ( AVFormatContext* formatCtx_,
+                            AVStream* stream_,
+                            unsigned int queueDepth_,
+                            bool dropWhenFull_ )
+  {
+    if (( formatCtx_ == nullptr ) || ( stream_ == nullptr ) || _running )
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "Tee muxer: output not added." );
+      return -1;
+    }
+
+    std::string name_ = formatCtx_->url ? formatCtx_->url
+                                        : "output " + std::to_string ( _outputs.size ( ));
+
+    std::unique_ptr < Output > output_ ( new Output ( ));
+    output_->formatCtx = formatCtx_;
+    output_->stream = stream_;
+    output_->muxer = nullptr;
+    output_->owned = false;
+    output_->queueDepth = queueDepth_ > 0 ? queueDepth_ : 1;
+    output_->dropWhenFull = dropWhenFull_;
+    output_->waitKeyframe = false;
+    output_->stats.reset ( new StageStats ( name_ ));
+    output_->dropped = 0;
+    output_->failed = false;
+    _outputs.push_back ( std::move ( output_ ));
+
+    return _outputs.size ( ) - 1;
+  }
+
+  int TeeMuxer::addOutput ( Muxer* muxer_,
+                            unsigned int queueDepth_,
+                            bool dropWhenFull_ )
+  {
+    if (( muxer_ == nullptr ) || ( muxer_ == this ) || _running )
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "Tee muxer: output not added." );
+      return -1;
+    }
+
+    std::unique_ptr < Output > output_ ( new Output ( ));
+    output_->formatCtx = nullptr;
+    output_->stream = nullptr;
+    output_->muxer = muxer_;
+    output_->owned = false;
+    output_->queueDepth = queueDepth_ > 0 ? queueDepth_ : 1;
+    output_->dropWhenFull = dropWhenFull_;
+    output_->waitKeyframe = false;
+    output_->stats.reset ( new StageStats ( muxer_->getDescription ( )));
+    output_->dropped = 0;
+    output_->failed = false;
+    _outputs.push_back ( std::move ( output_ ));
+
+    return _outputs.size ( ) - 1;
+  }
+
+  int TeeMuxer::openOutput ( const std::string& url_,
+                             const AVCodecContext* codecCtx_,
+                             const std::string& format_,
+                             unsigned int queueDepth_,
+                             bool dropWhenFull_ )
+  {
+    AVFormatContext* formatCtx_ = openFormat ( url_, codecCtx_, format_ );
+    if ( !formatCtx_ )
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "Tee muxer: unable to open ", url_ );
+      return -1;
+    }
+
+    int index_ = addOutput ( formatCtx_, formatCtx_->streams[0],
+                             queueDepth_, dropWhenFull_ );
+    if ( index_ < 0 )
+    {
+      closeFormat ( formatCtx_ );
+      return -1;
+    }
+
+    _outputs[index_]->owned = true;
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Tee muxer output ", index_, ": ", url_,
+                                         " (", formatCtx_->oformat->name, ")" );
+    return index_;
+  }
+
+  int TeeMuxer::writePacket ( AVPacket* packet_ )
+  {
+    std::lock_guard < std::mutex > lock_ ( _mtx );
+    if ( !_running )
+    {
+      return AVERROR( EINVAL );
+    }
+
+    ++_numPackets;
+    _numBytes += packet_->size;
+
+    //Time spent queueing, it grows when an output that does not drop is
+    //slower than the encoder.
+    StageTimer queueTimer_ ( _stats );
+    queueTimer_.setBytes ( packet_->size );
+
+    bool active_ = false;
+    for ( auto& output_ : _outputs )
+    {
+      if ( output_->failed )
+      {
+        continue;
+      }
+      active_ = true;
+
+      //What follows a dropped packet cannot be decoded until a keyframe.
+      if ( output_->waitKeyframe && !( packet_->flags & AV_PKT_FLAG_KEY ))
+      {
+        ++output_->dropped;
+        continue;
+      }
+
+      AVPacket* ref_ = _packetPool.getPacket ( );
+      if ( !ref_ || ( av_packet_ref ( ref_, packet_ ) < 0 ))
+      {
+        _packetPool.releasePacket ( ref_ );
+        return AVERROR( ENOMEM );
+      }
+
+      if ( output_->dropWhenFull )
+      {
+        if ( !output_->queue->tryPush ( ref_ ))
+        {
+          _packetPool.releasePacket ( ref_ );
+          ++output_->dropped;
+          output_->waitKeyframe = true;
+          continue;
+        }
+      }
+      else if ( !output_->queue->push ( ref_ ))
+      {
+        _packetPool.releasePacket ( ref_ );
+        continue;
+      }
+      output_->waitKeyframe = false;
+    }
+
+    //A failed output does not stop the others.
+    return active_ ? 0 : AVERROR( EIO );
+  }
+
+  void TeeMuxer::writerThread ( Output* output_ )
+  {
+    AVPacket* packet_ = nullptr;
+
+    while ( output_->queue->pop ( packet_ ))
+    {
+      if ( !output_->failed )
+      {
+        StageTimer writeTimer_ ( output_->stats.get ( ));
+        writeTimer_.setBytes ( packet_->size );
+        int value = 0;
+        if ( output_->muxer != nullptr )
+        {
+          //It takes the packets in the codec time base too.
+          value = output_->muxer->writePacket ( packet_ );
+        }
+        else
+        {
+          if ( _timeBase.num != 0 )
+          {
+            av_packet_rescale_ts ( packet_, _timeBase, output_->stream->time_base );
+          }
+          packet_->stream_index = output_->stream->index;
+          value = av_write_frame ( output_->formatCtx, packet_ );
+        }
+        writeTimer_.stop ( );
+        if ( value < 0 )
+        {
+          output_->failed = true;
+          Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                               "Tee muxer: writing to ",
+                                               output_->stats->getName ( ),
+                                               " failed, output closed: ", value );
+        }
+      }
+      _packetPool.releasePacket ( packet_ );
+    }
+  }
+
+  void TeeMuxer::stop ( void )
+  {
+    if ( !_running )
+    {
+      return;
+    }
+
+    //The writers finish the packets already queued.
+    for ( auto& output_ : _outputs )
+    {
+      output_->queue->close ( );
+    }
+    for ( auto& output_ : _outputs )
+    {
+      output_->thread.join ( );
+    }
+    _running = false;
+  }
+
+  int TeeMuxer::writeTrailer ( void )
+  {
+    std::lock_guard < std::mutex > lock_ ( _mtx );
+    if ( !_running )
+    {
+      return 0;
+    }
+    stop ( );
+
+    int result_ = 0;
+    for ( auto& output_ : _outputs )
+    {
+      if ( output_->failed )
+      {
+        continue;
+      }
+
+      int value = ( output_->muxer != nullptr ) ? output_->muxer->writeTrailer ( )
+                                                : av_write_trailer ( output_->formatCtx );
+      if (( value < 0 ) && ( result_ == 0 ))
+      {
+        result_ = value;
+      }
+      if ( output_->dropped > 0 )
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                             "Tee muxer: ", output_->dropped.load ( ),
+                                             " packets dropped on ",
+                                             output_->stats->getName ( ));
+      }
+    }
+    return result_;
+  }
+
+  unsigned long TeeMuxer::getDropped ( unsigned int output_ )
+  {
+    return output_ < _outputs.size ( ) ? _outputs[output_]->dropped.load ( ) : 0;
+  }
+
+  bool TeeMuxer::isOutputActive ( unsigned int output_ )
+  {
+    return ( output_ < _outputs.size ( )) && !_outputs[output_]->failed;
+  }
+
+  StageStats* TeeMuxer::getOutputStats ( unsigned int output_ )
+  {
+    return output_ < _outputs.size ( ) ? _outputs[output_]->stats.get ( ) : nullptr;
+  }
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef REMO_TEEMUXER_H
+#define REMO_TEEMUXER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../util/FramePool.h"
+#include "../util/SPSCQueue.h"
+#include "Muxer.h"
+
+namespace remo
+{
+  //Encode once, write many: every packet of one encoder goes to several
+  //outputs (a file, an RTP/UDP endpoint, a pipe...). The outputs take a
+  //new reference to the packet, its payload is not copied, and each one
+  //has its own queue and writer thread, so a slow disk does not stall a
+  //network output. Outputs that drop when their queue is full skip the
+  //packets up to the next keyframe, the others make the encoder wait.
+  class TeeMuxer: public Muxer
+  {
+    public:
+      TeeMuxer ( AVRational timeBase_ = AVRational { 0, 1 } );
+      virtual ~TeeMuxer ( void );
+
+      //Starts the writer threads.
+      virtual void init ( void );
+
+      //Output opened by the caller, with its header written. Returns its
+      //index. Outputs are added before init ( ).
+      int addOutput ( AVFormatContext* formatCtx_,
+                      AVStream* stream_,
+                      unsigned int queueDepth_ = 32,
+                      bool dropWhenFull_ = false );
+      //Another muxer, a SegmentMuxer for instance, written from the thread
+      //of the output. It is initialized by init ( ) and not owned.
+      int addOutput ( Muxer* muxer_,
+                      unsigned int queueDepth_ = 32,
+                      bool dropWhenFull_ = false );
+      //Opens url_ with one stream of the codec parameters and writes its
+      //header, the container is guessed from url_ when format_ is empty
+      //("mpegts" for udp://, "rtp"...). The output is closed by the muxer.
+      //Returns its index, or -1 if it could not be opened.
+      int openOutput ( const std::string& url_,
+                       const AVCodecContext* codecCtx_,
+                       const std::string& format_ = "",
+                       unsigned int queueDepth_ = 32,
+                       bool dropWhenFull_ = true );
+
+      //Queues a reference of the packet on every output, setStats ( )
+      //records the time it takes.
+      virtual int writePacket ( AVPacket* packet_ );
+      //Waits for the queued packets and writes the trailer of every output.
+      virtual int writeTrailer ( void );
+
+      unsigned int getNumOutputs ( void ) { return _outputs.size ( ); }
+      unsigned long getDropped ( unsigned int output_ );
+      //False once writing to the output failed, it gets no more packets.
+      bool isOutputActive ( unsigned int output_ );
+      //Write time of the output, named after its url.
+      StageStats* getOutputStats ( unsigned int output_ );
+
+    protected:
+      struct Output
+      {
+        AVFormatContext* formatCtx;
+        AVStream* stream;
+        Muxer* muxer;
+        bool owned;
+        unsigned int queueDepth;
+        bool dropWhenFull;
+        //Producer side: dropping until the next keyframe.
+        bool waitKeyframe;
+        std::unique_ptr < SPSCQueue < AVPacket* > > queue;
+        std::unique_ptr < StageStats > stats;
+        std::thread thread;
+        std::atomic < unsigned long > dropped;
+        std::atomic < bool > failed;
+      };
+
+      void writerThread ( Output* output_ );
+      void stop ( void );
+
+      std::vector < std::unique_ptr < Output > > _outputs;
+      PacketPool _packetPool;
+      bool _running;
+  };
+}
+#endif //REMO_TEEMUXER_H
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "EncoderSettings.h"
+#include "../util/Utils.h"
+
+namespace remo
+{
+  EncoderSettings::EncoderSettings ( void )
+    : _codec ( "mpeg4" )
+    , _rateControl ( RC_VBR )
+    , _crf ( 23 )
+    , _bitRate ( 40000000 )
+    , _maxBitRate ( 0 )
+    , _gopSize ( 6 )
+    , _maxBFrames ( 4 )
+    , _width ( 0 )
+    , _height ( 0 )
+    , _frameRate ( 30 )
+    , _pixelFormat ( AV_PIX_FMT_YUV420P )
+    , _threadCount ( 0 )
+    , _threading ( THREADING_AUTO ) {}
+
+  EncoderSettings EncoderSettings::fromProfile ( const std::string& profile_ )
+  {
+    EncoderSettings settings_;
+
+    if ( profile_ == "realtime-lowcpu" )
+    {
+      //H.264 at a tenth of the default bitrate, no B-frames and slice
+      //threads to keep the latency low.
+      settings_.setCodec ( "libx264", { "mpeg4" } );
+      settings_.setPreset ( "veryfast" );
+      settings_.setTune ( "zerolatency" );
+      settings_.setVBR ( 4000000, 6000000 );
+      settings_.setGopSize ( 60 );
+      settings_.setMaxBFrames ( 0 );
+      settings_.setThreads ( 0, THREADING_SLICE );
+    }
+    else if ( profile_ == "archive-quality" )
+    {
+      settings_.setCodec ( "libx265", { "libx264", "mpeg4" } );
+      settings_.setPreset ( "slow" );
+      settings_.setCRF ( 22 );
+      settings_.setGopSize ( 250 );
+      settings_.setMaxBFrames ( 4 );
+      settings_.setThreads ( 0, THREADING_FRAME );
+    }
+    else if ( profile_ != "default" )
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "Unknown encoder profile ", profile_,
+                                           ", using the default one." );
+    }
+
+    return settings_;
+  }
+
+  void EncoderSettings::setCodec ( const std::string& codec_,
+                                   const std::vector < std::string >& fallbacks_ )
+  {
+    _codec = codec_;
+    _fallbacks = fallbacks_;
+  }
+
+  void EncoderSettings::setCRF ( int crf_ )
+  {
+    _rateControl = RC_CRF;
+    _crf = std::max ( 0, std::min ( crf_, 51 ));
+  }
+
+  void EncoderSettings::setCBR ( int64_t bitRate_ )
+  {
+    _rateControl = RC_CBR;
+    _bitRate = bitRate_;
+    _maxBitRate = bitRate_;
+  }
+
+  void EncoderSettings::setVBR ( int64_t bitRate_, int64_t maxBitRate_ )
+  {
+    _rateControl = RC_VBR;
+    _bitRate = bitRate_;
+    _maxBitRate = maxBitRate_;
+  }
+
+  void EncoderSettings::setSize ( int width_, int height_ )
+  {
+    _width = width_;
+    _height = height_;
+  }
+
+  void EncoderSettings::setThreads ( int threadCount_, ENCODER_THREADING threading_ )
+  {
+    _threadCount = std::max ( 0, threadCount_ );
+    _threading = threading_;
+  }
+
+  AVCodec* EncoderSettings::findEncoder ( void )
+  {
+    AVCodec* codec_ = avcodec_find_encoder_by_name ( _codec.c_str ( ));
+    for ( unsigned int i = 0; !codec_ && ( i < _fallbacks.size ( )); ++i )
+    {
+      codec_ = avcodec_find_encoder_by_name ( _fallbacks[i].c_str ( ));
+    }
+
+    if ( codec_ && ( _codec != codec_->name ))
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "Encoder ", _codec,
+                                           " not available, using ",
+                                           codec_->name );
+    }
+    return codec_;
+  }
+
+  void EncoderSettings::apply ( AVCodecContext* codecCtx_, AVDictionary** options_ )
+  {
+    const AVCodec* codec_ = codecCtx_->codec;
+
+    codecCtx_->codec_type = AVMEDIA_TYPE_VIDEO;
+    codecCtx_->width = _width;
+    codecCtx_->height = _height;
+    codecCtx_->time_base = AVRational { 1, _frameRate };
+    codecCtx_->framerate = AVRational { _frameRate, 1 };
+    codecCtx_->gop_size = _gopSize;
+    codecCtx_->max_b_frames = _maxBFrames;
+
+    //Keep the requested format when the encoder supports it.
+    codecCtx_->pix_fmt = _pixelFormat;
+    if ( codec_ && codec_->pix_fmts )
+    {
+      const AVPixelFormat* fmt_ = codec_->pix_fmts;
+      while (( *fmt_ != AV_PIX_FMT_NONE ) && ( *fmt_ != _pixelFormat ))
+      {
+        ++fmt_;
+      }
+      codecCtx_->pix_fmt = ( *fmt_ != AV_PIX_FMT_NONE ) ? _pixelFormat
+                                                         : codec_->pix_fmts[0];
+    }
+
+    codecCtx_->thread_count = _threadCount;
+    if ( _threading == THREADING_FRAME )
+    {
+      codecCtx_->thread_type = FF_THREAD_FRAME;
+    }
+    else if ( _threading == THREADING_SLICE )
+    {
+      codecCtx_->thread_type = FF_THREAD_SLICE;
+    }
+
+    //Private options only apply when the encoder knows them.
+    void* priv_ = codecCtx_->priv_data;
+    auto hasOption_ = [ priv_ ] ( const char* name_ )
+    {
+      return priv_ && av_opt_find ( priv_, name_, nullptr, 0, 0 );
+    };
+
+    if ( !_preset.empty ( ) && hasOption_ ( "preset" ))
+    {
+      av_dict_set ( options_, "preset", _preset.c_str ( ), 0 );
+    }
+    if ( !_tune.empty ( ) && hasOption_ ( "tune" ))
+    {
+      av_dict_set ( options_, "tune", _tune.c_str ( ), 0 );
+    }
+
+    switch ( _rateControl )
+    {
+      case RC_CRF:
+        if ( hasOption_ ( "crf" ))
+        {
+          av_dict_set_int ( options_, "crf", _crf, 0 );
+          codecCtx_->bit_rate = 0;
+        }
+        else
+        {
+          //Fixed quantizer, 2 (best) to 31 (worst).
+          codecCtx_->flags |= AV_CODEC_FLAG_QSCALE;
+          codecCtx_->global_quality = FF_QP2LAMBDA
+            * std::max ( 2, std::min ( 2 + _crf * 29 / 51, 31 ));
+        }
+        break;
+
+      case RC_CBR:
+        codecCtx_->bit_rate = _bitRate;
+        codecCtx_->rc_min_rate = _bitRate;
+        codecCtx_->rc_max_rate = _bitRate;
+        codecCtx_->rc_buffer_size = _bitRate;
+        break;
+
+      case RC_VBR:
+        codecCtx_->bit_rate = _bitRate;
+        if ( _maxBitRate > 0 )
+        {
+          codecCtx_->rc_max_rate = _maxBitRate;
+          codecCtx_->rc_buffer_size = _maxBitRate;
+        }
+        break;
+    }
+  }
+
+  std::string EncoderSettings::getDescription ( void )
+  {
+    std::ostringstream desc_;
+    desc_ << _codec;
+    if ( !_preset.empty ( ))
+    {
+      desc_ << " preset " << _preset;
+    }
+    if ( !_tune.empty ( ))
+    {
+      desc_ << " tune " << _tune;
+    }
+    switch ( _rateControl )
+    {
+      case RC_CRF: desc_ << " crf " << _crf; break;
+      case RC_CBR: desc_ << " cbr " << _bitRate; break;
+      case RC_VBR: desc_ << " vbr " << _bitRate; break;
+    }
+    desc_ << " gop " << _gopSize << " bframes " << _maxBFrames << " ";
+    if ( _width > 0 && _height > 0 )
+    {
+      desc_ << _width << "x" << _height;
+    }
+    else
+    {
+      desc_ << "source size";
+    }
+    desc_ << "@" << _frameRate;
+    return desc_.str ( );
+  }
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_ENCODERSETTINGS_H
+#define REMO_ENCODERSETTINGS_H
+
+#include <string>
+#include <vector>
+
+#include "../util/ffdefs.h"
+
+namespace remo
+{
+  enum RATE_CONTROL
+  {
+    RC_CRF,   //Constant quality.
+    RC_CBR,
+    RC_VBR
+  };
+
+  enum ENCODER_THREADING
+  {
+    THREADING_AUTO,
+    THREADING_FRAME,  //Best throughput, one frame of latency per thread.
+    THREADING_SLICE   //Lower latency, for live outputs.
+  };
+
+  //Encoder configuration used by StreamVideoFileOut. The defaults match the
+  //previous fixed setup (MPEG-4 at 40 Mbit/s), at the capture size.
+  class EncoderSettings
+  {
+    public:
+      EncoderSettings ( void );
+
+      //Named profiles: "default", "realtime-lowcpu" and "archive-quality".
+      static EncoderSettings fromProfile ( const std::string& profile_ );
+
+      //Encoder name as in ffmpeg (mpeg4, libx264, libx265, libvpx-vp9...),
+      //or "copy" to store the source packets without transcoding.
+      //The fallbacks are tried in order when it is not available.
+      void setCodec ( const std::string& codec_,
+                      const std::vector < std::string >& fallbacks_ = { } );
+      const std::string& getCodec ( void ) { return _codec; }
+
+      void setPreset ( const std::string& preset_ ) { _preset = preset_; }
+      void setTune ( const std::string& tune_ ) { _tune = tune_; }
+
+      //CRF value in the x264 scale (0-51), mapped to qscale for encoders
+      //without CRF support.
+      void setCRF ( int crf_ );
+      void setCBR ( int64_t bitRate_ );
+      //maxBitRate_ 0 leaves the peak unconstrained.
+      void setVBR ( int64_t bitRate_, int64_t maxBitRate_ = 0 );
+      RATE_CONTROL getRateControl ( void ) { return _rateControl; }
+      int64_t getBitRate ( void ) { return _bitRate; }
+
+      void setGopSize ( int gopSize_ ) { _gopSize = gopSize_; }
+      void setMaxBFrames ( int maxBFrames_ ) { _maxBFrames = maxBFrames_; }
+
+      //0x0 keeps the size of the captured frames.
+      void setSize ( int width_, int height_ );
+      int getWidth ( void ) { return _width; }
+      int getHeight ( void ) { return _height; }
+      void setFrameRate ( int frameRate_ ) { _frameRate = frameRate_; }
+      int getFrameRate ( void ) { return _frameRate; }
+      void setPixelFormat ( AVPixelFormat pixelFormat_ ) { _pixelFormat = pixelFormat_; }
+
+      //0 threads lets the encoder choose.
+      void setThreads ( int threadCount_, ENCODER_THREADING threading_ = THREADING_AUTO );
+
+      //First available encoder among the codec and its fallbacks.
+      AVCodec* findEncoder ( void );
+      //Configures the context of a codec returned by findEncoder ( ) and
+      //adds its private options (preset, tune, crf) for avcodec_open2.
+      void apply ( AVCodecContext* codecCtx_, AVDictionary** options_ );
+
+      std::string getDescription ( void );
+
+    private:
+      std::string _codec;
+      std::vector < std::string > _fallbacks;
+      std::string _preset;
+      std::string _tune;
+
+      RATE_CONTROL _rateControl;
+      int _crf;
+      int64_t _bitRate;
+      int64_t _maxBitRate;
+
+      int _gopSize;
+      int _maxBFrames;
+      int _width;
+      int _height;
+      int _frameRate;
+      AVPixelFormat _pixelFormat;
+
+      int _threadCount;
+      ENCODER_THREADING _threading;
+  };
+}
+
+#endif //REMO_ENCODERSETTINGS_H
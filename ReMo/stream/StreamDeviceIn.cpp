@@ -43,48 +43,7 @@ namespace remo
                                                                    "context " );
     }
 
-    //Both Media could be treated as the same Media!
-    if ( MediaDesktop* vMediaD_ = dynamic_cast<MediaDesktop*>(_media))
-    {
-      _AVInputFormat =
-        av_find_input_format ( vMediaD_->getQualifier ( ).c_str ( ));
-      AVDictionary* aux = vMediaD_->getOptions ( );
-      value = avformat_open_input ( &_AVFormatContext,
-                                    vMediaD_->getDesktopConfigAsString ( )
-                                           .c_str ( ),
-                                    _AVInputFormat,
-                                    &aux );
-      if ( value != 0 )
-      {
-        avformat_close_input ( &_AVFormatContext );
-        Utils::getInstance ( )->getErrorManager ( )
-                              ->criticalError (
-                                "Couldn't open input Stream for desktop grabber." );
-      }
-    }
-    else if ( MediaWebCam* vMediaWC_ = dynamic_cast<MediaWebCam*>(_media))
-    {
-      _AVInputFormat =
-        av_find_input_format ( vMediaWC_->getQualifier ( ).c_str ( ));
-      value = avformat_open_input ( &_AVFormatContext,
-                                    vMediaWC_->getPhysicalMedia ( ).c_str ( ),
-                                    _AVInputFormat,
-                                    nullptr );
-      if ( value != 0 )
-      {
-        avformat_close_input ( &_AVFormatContext );
-        Utils::getInstance ( )->getErrorManager ( )->criticalError (
-          "Couldn't open input Stream for web cam." );
-      }
-
-    }
-    else
-    {
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError (
-        "Media not supported for input Stream." );
-    }
-
+    value = openInput ( );
     if ( value != 0 )
     {
       avformat_close_input ( &_AVFormatContext );
@@ -154,4 +113,76 @@ namespace remo
                             ->criticalError ( "Unable to open the av codec." );
     }
   }
+
+  int StreamDeviceIn::openInput ( void )
+  {
+    int value = 0;
+
+    //Both Media could be treated as the same Media!
+    if ( MediaDesktop* vMediaD_ = dynamic_cast<MediaDesktop*>(_media))
+    {
+      _AVInputFormat =
+        av_find_input_format ( vMediaD_->getQualifier ( ).c_str ( ));
+      AVDictionary* aux = vMediaD_->getOptions ( );
+      value = avformat_open_input ( &_AVFormatContext,
+                                    vMediaD_->getDesktopConfigAsString ( )
+                                           .c_str ( ),
+                                    _AVInputFormat,
+                                    &aux );
+      if ( value != 0 )
+      {
+        avformat_close_input ( &_AVFormatContext );
+        Utils::getInstance ( )->getErrorManager ( )
+                              ->criticalError (
+                                "Couldn't open input Stream for desktop grabber." );
+      }
+    }
+    else if ( MediaWebCam* vMediaWC_ = dynamic_cast<MediaWebCam*>(_media))
+    {
+      _AVInputFormat =
+        av_find_input_format ( vMediaWC_->getQualifier ( ).c_str ( ));
+      AVDictionary* aux = vMediaWC_->getOptions ( );
+      value = avformat_open_input ( &_AVFormatContext,
+                                    vMediaWC_->getPhysicalMedia ( ).c_str ( ),
+                                    _AVInputFormat,
+                                    &aux );
+      if ( value != 0 )
+      {
+        avformat_close_input ( &_AVFormatContext );
+        Utils::getInstance ( )->getErrorManager ( )->criticalError (
+          "Couldn't open input Stream for web cam." );
+      }
+
+    }
+    else if ( MediaSynthetic* vMediaS_ = dynamic_cast<MediaSynthetic*>(_media))
+    {
+      _AVInputFormat =
+        av_find_input_format ( vMediaS_->getQualifier ( ).c_str ( ));
+      if ( !_AVInputFormat )
+      {
+        avformat_close_input ( &_AVFormatContext );
+        Utils::getInstance ( )->getErrorManager ( )->criticalError (
+          "FFmpeg built without the lavfi device." );
+      }
+      AVDictionary* aux = vMediaS_->getOptions ( );
+      value = avformat_open_input ( &_AVFormatContext,
+                                    vMediaS_->getFilterGraph ( ).c_str ( ),
+                                    _AVInputFormat,
+                                    &aux );
+      if ( value != 0 )
+      {
+        avformat_close_input ( &_AVFormatContext );
+        Utils::getInstance ( )->getErrorManager ( )->criticalError (
+          "Couldn't open input Stream for synthetic pattern." );
+      }
+    }
+    else
+    {
+      avformat_close_input ( &_AVFormatContext );
+      Utils::getInstance ( )->getErrorManager ( )->criticalError (
+        "Media not supported for input Stream." );
+    }
+
+    return value;
+  }
 }
@@ -23,6 +23,7 @@
 #include "FFStream.h"
 #include "../media/MediaDesktop.h"
 #include "../media/MediaWebCam.h"
+#include "../media/MediaSynthetic.h"
 
 namespace remo
 {
@@ -34,7 +35,14 @@ namespace remo
 
       virtual void init ( void );
 
-    private:
+      AVStream* getVideoStream ( void )
+      {
+        return _AVFormatContext->streams[_videoStreamIndx];
+      }
+
+    protected:
+      //Opens _AVFormatContext for the Media, returns the avformat result.
+      virtual int openInput ( void );
   };
 }
 
@@ -24,24 +24,61 @@
 
 namespace remo
 {
-  StreamVideoFileOut::StreamVideoFileOut ( Media* outMedia_ ):
-    FFStream ( outMedia_ )
+  StreamVideoFileOut::StreamVideoFileOut ( Media* outMedia_,
+                                           const EncoderSettings& settings_ ):
+    FFStream ( outMedia_ ),
+    _settings ( settings_ ),
+    _sourceWidth ( 0 ),
+    _sourceHeight ( 0 ),
+    _sourceStream ( nullptr ),
+    _passthrough ( false ),
+    _fragmented ( false ),
+    _firstSourceDts ( AV_NOPTS_VALUE )
   {
     _videoStream = nullptr;
     _options = nullptr;
     _description = "Out Video Stream";
   }
 
+  StreamVideoFileOut::~StreamVideoFileOut ( void )
+  {
+    avcodec_free_context ( &_AVCodecContext );
+  }
+
+  void StreamVideoFileOut::setSourceSize ( int width_, int height_ )
+  {
+    _sourceWidth = width_;
+    _sourceHeight = height_;
+  }
+
+  void StreamVideoFileOut::setSourceStream ( AVStream* sourceStream_ )
+  {
+    _sourceStream = sourceStream_;
+    if ( _sourceStream )
+    {
+      setSourceSize ( _sourceStream->codecpar->width,
+                      _sourceStream->codecpar->height );
+    }
+  }
+
+  void StreamVideoFileOut::closeOnError ( const std::string& msg_ )
+  {
+    avcodec_free_context ( &_AVCodecContext );
+    avformat_free_context ( _AVFormatContext );
+    _AVFormatContext = nullptr;
+    Utils::getInstance ( )->getErrorManager ( )->criticalError ( msg_ );
+  }
+
   void StreamVideoFileOut::init ( void )
   {
     _AVFormatContext = nullptr;
+    _AVCodecContext = nullptr;
     _options = nullptr;
-    int codec_id = 0;
     int value = 0;
-    const char* output_file =
-      static_cast<MediaVideoFile*>(_media)->getFileName ( ).c_str ( );
+    const std::string output_file =
+      static_cast<MediaVideoFile*>(_media)->getFileName ( );
 
-    _outputFormat = av_guess_format ( nullptr, output_file, nullptr );
+    _outputFormat = av_guess_format ( nullptr, output_file.c_str ( ), nullptr );
     if ( !_outputFormat )
     {
       Utils::getInstance ( )->getErrorManager ( )
@@ -53,7 +90,7 @@ namespace remo
     avformat_alloc_output_context2 ( &_AVFormatContext,
                                      nullptr,
                                      nullptr,
-                                     output_file );
+                                     output_file.c_str ( ));
     if ( !_AVFormatContext )
     {
       Utils::getInstance ( )->getErrorManager ( )->criticalError (
@@ -63,135 +100,205 @@ namespace remo
     _videoStream = avformat_new_stream ( _AVFormatContext, nullptr );
     if ( !_videoStream )
     {
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError (
-        "Error in creating a av format new Stream." );
+      closeOnError ( "Error in creating a av format new Stream." );
     }
 
-    _AVCodec = avcodec_find_encoder ( AV_CODEC_ID_MPEG4 );
-    if ( !_AVCodec )
+    if ( usePassthrough ( ))
     {
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )
-                            ->criticalError (
-                              "Error in finding the av codecs. try again with correct codec." );
+      copySourceParameters ( );
+    }
+    else
+    {
+      openEncoder ( );
     }
 
-    _AVCodecContext = avcodec_alloc_context3 ( _AVCodec );
-    if ( !_AVCodecContext )
+    if ( !( _AVFormatContext->oformat->flags & AVFMT_NOFILE ))
     {
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError (
-        "Error in allocating the codec contexts." );
+      if ( avio_open2 ( &_AVFormatContext->pb,
+                        output_file.c_str ( ),
+                        AVIO_FLAG_WRITE,
+                        nullptr,
+                        nullptr ) < 0 )
+      {
+        closeOnError ( "Error in creating the video file." );
+      }
     }
 
+    if ( _fragmented )
+    {
+      //The MP4 family of muxers, the ones with movflags.
+      if ( av_opt_find ( const_cast < AVClass** > ( &_AVFormatContext->oformat->priv_class ),
+                         "movflags", nullptr, 0, AV_OPT_SEARCH_FAKE_OBJ ))
+      {
+        av_dict_set ( &_options, "movflags",
+                      "frag_keyframe+empty_moov+default_base_moof", 0 );
+      }
+      else
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                             "Fragmented output needs MP4/MOV, ",
+                                             _AVFormatContext->oformat->name,
+                                             " written as is." );
+      }
+    }
 
-    //https://stackoverflow.com/questions/33981707/ffmpeg-copy-streams-without-transcode
-    value = avcodec_parameters_to_context ( _AVCodecContext, _videoStream->codecpar);
-    if (value < 0)
+    value = avformat_write_header ( _AVFormatContext, &_options );
+    if ( value < 0 )
     {
-      avcodec_free_context( &_AVCodecContext );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Unable to set parameters to context." );
+      closeOnError ( "Error in writing the header context." );
     }
+  }
 
-    _AVCodecContext = _videoStream->codec;
+  bool StreamVideoFileOut::usePassthrough ( void )
+  {
+    if ( !_sourceStream )
+    {
+      if ( _passthrough || _settings.getCodec ( ) == "copy" )
+      {
+        Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                             "Stream copy needs the source stream, "
+                                             "encoding instead." );
+      }
+      return false;
+    }
 
-    //### set property of the video file multiple properties needs to be evaluated here!
-    //Alternatives: AV_CODEC_ID_MPEG4; // AV_CODEC_ID_H264 //AV_CODEC_ID_MPEG1VIDEO
-    _AVCodecContext->codec_id = AV_CODEC_ID_MPEG4;
-    _AVCodecContext->codec_type = AVMEDIA_TYPE_VIDEO;
-    _AVCodecContext->bit_rate = 4e7;
-    _AVCodecContext->gop_size = 6;
-    _AVCodecContext->max_b_frames = 4;
-    _AVCodecContext->width = 1024;
-    _AVCodecContext->height = 768;
-    _AVCodecContext->pix_fmt = AV_PIX_FMT_YUV420P;
-    _AVCodecContext->time_base = ( AVRational ) { 1, 30 };
+    AVCodecID sourceCodec_ = _sourceStream->codecpar->codec_id;
+    bool passthrough_ = _passthrough || ( _settings.getCodec ( ) == "copy" );
+    if ( !passthrough_ )
+    {
+      //The selected encoder would produce the same codec, and the size is
+      //kept, so the packets can be copied as they are.
+      AVCodec* encoder_ = _settings.findEncoder ( );
+      bool sameSize_ = ( _settings.getWidth ( ) <= 0 )
+        || (( _settings.getWidth ( ) == _sourceStream->codecpar->width )
+          && ( _settings.getHeight ( ) == _sourceStream->codecpar->height ));
+      passthrough_ = encoder_ && ( encoder_->id == sourceCodec_ ) && sameSize_;
+    }
 
-    //av_codec_get_tag2(_AVFormatContext->oformat->codec_tag, _AVCodec->id, &_AVCodecContext->codec_tag);
-//    value = avcodec_open2(_AVCodecContext, _AVCodec, nullptr);
-//    if (value < 0)
-//      Utils::getInstance ( )->getErrorManager ( )->criticalError ( "Cannot open video Encoder for Stream." );
-//
-//    //_AVCodecContext->sample_aspect_ratio = ->sample_aspect_ratio;
-//    _AVCodecContext->sample_rate = 64e3;
-//    _AVCodecContext->channels = 1;
-//    av_opt_set(_AVCodecContext->priv_data, "preset", "ultrafast", 0);
-//    av_opt_set(_AVCodecContext->priv_data, "tune", "zerolatency", 0);
+    if ( passthrough_
+      && ( avformat_query_codec ( _AVFormatContext->oformat,
+                                  sourceCodec_,
+                                  FF_COMPLIANCE_NORMAL ) == 0 ))
+    {
+      Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::WARNING,
+                                           "The output format can not store ",
+                                           avcodec_get_name ( sourceCodec_ ),
+                                           ", encoding instead." );
+      passthrough_ = false;
+    }
 
+    return passthrough_;
+  }
 
-    if ( codec_id == AV_CODEC_ID_H264 )
-      av_opt_set ( _AVCodecContext->priv_data, "preset", "slow", 0 );
+  void StreamVideoFileOut::copySourceParameters ( void )
+  {
+    if ( avcodec_parameters_copy ( _videoStream->codecpar,
+                                   _sourceStream->codecpar ) < 0 )
+    {
+      closeOnError ( "Unable to copy the source stream parameters." );
+    }
+    //The source tag belongs to its container.
+    _videoStream->codecpar->codec_tag = 0;
+    _videoStream->time_base = _sourceStream->time_base;
 
-    //Header definition
-    if ( _AVFormatContext->oformat->flags & AVFMT_GLOBALHEADER )
-      _AVCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    _passthrough = true;
+    _firstSourceDts = AV_NOPTS_VALUE;
 
-    value = avcodec_open2 ( _AVCodecContext, _AVCodec, nullptr );
-    if ( value < 0 )
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Stream copy of ",
+                                         avcodec_get_name ( _sourceStream->codecpar->codec_id ),
+                                         ", no transcoding." );
+  }
+
+  void StreamVideoFileOut::openEncoder ( void )
+  {
+    int value = 0;
+    _passthrough = false;
+
+    EncoderSettings settings_ = _settings;
+    if ( settings_.getCodec ( ) == "copy" )
     {
-      avcodec_close ( _AVCodecContext );
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )
-                            ->criticalError ( "Error in opening the avcodec." );
+      settings_.setCodec ( EncoderSettings ( ).getCodec ( ));
     }
 
-    if ( !( _AVFormatContext->flags & AVFMT_NOFILE ))
+    _AVCodec = settings_.findEncoder ( );
+    if ( !_AVCodec )
     {
-      if ( avio_open2 ( &_AVFormatContext->pb,
-                        output_file,
-                        AVIO_FLAG_WRITE,
-                        nullptr,
-                        nullptr ) < 0 )
-      {
-        avcodec_close ( _AVCodecContext );
-        avformat_close_input ( &_AVFormatContext );
-        Utils::getInstance ( )->getErrorManager ( )->criticalError (
-          "Error in creating the video file." );
-      }
+      closeOnError ( "Error in finding the av codecs. try again with correct codec." );
     }
 
-    if ( !_AVFormatContext->nb_streams )
+    _AVCodecContext = avcodec_alloc_context3 ( _AVCodec );
+    if ( !_AVCodecContext )
     {
-      avcodec_close ( _AVCodecContext );
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError (
-        "Output file dose not contain any Stream." );
+      closeOnError ( "Error in allocating the codec contexts." );
     }
 
-    value = av_dict_set ( &_options, "framerate", "30", 0 );
-    if ( value < 0 )
+    //Without an explicit size the output keeps the capture one, even sized
+    //for the chroma subsampling.
+    if ( settings_.getWidth ( ) <= 0 || settings_.getHeight ( ) <= 0 )
     {
-      avcodec_close ( _AVCodecContext );
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError (
-        "Error in setting dictionary value." );
+      if ( _sourceWidth > 0 && _sourceHeight > 0 )
+      {
+        settings_.setSize ( _sourceWidth & ~1, _sourceHeight & ~1 );
+      }
+      else
+      {
+        settings_.setSize ( 1024, 768 );
+      }
     }
 
-    value = av_dict_set ( &_options, "preset", "medium", 0 );
+    AVDictionary* codecOptions_ = nullptr;
+    settings_.apply ( _AVCodecContext, &codecOptions_ );
+
+    //Header definition
+    if ( _AVFormatContext->oformat->flags & AVFMT_GLOBALHEADER )
+      _AVCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    value = avcodec_open2 ( _AVCodecContext, _AVCodec, &codecOptions_ );
+    av_dict_free ( &codecOptions_ );
     if ( value < 0 )
     {
-      avcodec_close ( _AVCodecContext );
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )
-                            ->criticalError ( "Error in setting preset values." );
+      closeOnError ( "Error in opening the avcodec." );
     }
 
+    value = avcodec_parameters_from_context ( _videoStream->codecpar, _AVCodecContext );
     if ( value < 0 )
     {
-      avcodec_close ( _AVCodecContext );
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError (
-        "Unable to find the Stream information." );
+      closeOnError ( "Unable to set the stream parameters from the codec." );
     }
+    _videoStream->time_base = _AVCodecContext->time_base;
 
-    value = avformat_write_header ( _AVFormatContext, &_options );
-    if ( value < 0 )
+    Utils::getInstance ( )->getLog ( ) ( LOG_LEVEL::INFO,
+                                         "Encoder: ", _AVCodec->name, " (",
+                                         settings_.getDescription ( ), ")" );
+  }
+
+  int StreamVideoFileOut::writeSourcePacket ( AVPacket* packet_ )
+  {
+    //Device timestamps are wall clock based, the file starts at 0.
+    if ( _firstSourceDts == AV_NOPTS_VALUE )
     {
-      avcodec_close ( _AVCodecContext );
-      avformat_close_input ( &_AVFormatContext );
-      Utils::getInstance ( )->getErrorManager ( )->criticalError (
-        "Error in writing the header context." );
+      _firstSourceDts = ( packet_->dts != AV_NOPTS_VALUE ) ? packet_->dts
+                                                           : packet_->pts;
+    }
+    if ( packet_->pts != AV_NOPTS_VALUE )
+    {
+      packet_->pts -= _firstSourceDts;
     }
+    packet_->dts = ( packet_->dts != AV_NOPTS_VALUE )
+                   ? packet_->dts - _firstSourceDts : packet_->pts;
+
+    av_packet_rescale_ts ( packet_,
+                           _sourceStream->time_base,
+                           _videoStream->time_base );
+    packet_->stream_index = _videoStream->index;
+    packet_->pos = -1;
+
+    return av_write_frame ( _AVFormatContext, packet_ );
+  }
+
+  int StreamVideoFileOut::writeTrailer ( void )
+  {
+    return av_write_trailer ( _AVFormatContext );
   }
 }
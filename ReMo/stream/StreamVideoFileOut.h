@@ -22,21 +22,61 @@
 #define REMO_STREAM_VIDEOFILEOUT_H
 
 #include "FFStream.h"
+#include "EncoderSettings.h"
 
 namespace remo
 {
   class StreamVideoFileOut: public FFStream
   {
     public:
-      StreamVideoFileOut ( Media* outMedia_ );
-      virtual ~StreamVideoFileOut ( void ) = default;
+      StreamVideoFileOut ( Media* outMedia_,
+                           const EncoderSettings& settings_ = EncoderSettings ( ));
+      virtual ~StreamVideoFileOut ( void );
 
       virtual void init ( void );
 
+      //Must be set before init ( ), that the flows call on construction.
+      void setEncoderSettings ( const EncoderSettings& settings_ ) { _settings = settings_; }
+      EncoderSettings& getEncoderSettings ( void ) { return _settings; }
+      //Size of the captured frames, used when the settings do not set one.
+      void setSourceSize ( int width_, int height_ );
+      //Stream the captured packets come from, it also sets the source size.
+      void setSourceStream ( AVStream* sourceStream_ );
+
+      //Stream copy (remux): the source packets are muxed as they come, with
+      //no decode or encode. Also selected with the "copy" codec, and
+      //automatically when the encoder would produce the source codec.
+      void setPassthrough ( bool passthrough_ ) { _passthrough = passthrough_; }
+      //Valid after init ( ).
+      bool isPassthrough ( void ) { return _passthrough; }
+
+      //MP4/MOV written as fragments after an empty moov, a fragment per
+      //keyframe. Memory stays flat and a crash only loses the last one.
+      //Must be set before init ( ).
+      void setFragmented ( bool fragmented_ ) { _fragmented = fragmented_; }
+      bool isFragmented ( void ) { return _fragmented; }
+
       std::string getDescription ( void );
       AVStream* getVideoStream ( void ) { return _videoStream; }
 
+      //Rescales a packet of the source stream to the output one and muxes it.
+      int writeSourcePacket ( AVPacket* packet_ );
+      int writeTrailer ( void );
+
     private:
+      void closeOnError ( const std::string& msg_ );
+      bool usePassthrough ( void );
+      void copySourceParameters ( void );
+      void openEncoder ( void );
+
+      EncoderSettings _settings;
+      int _sourceWidth;
+      int _sourceHeight;
+
+      AVStream* _sourceStream;
+      bool _passthrough;
+      bool _fragmented;
+      int64_t _firstSourceDts;
 
       AVOutputFormat* _outputFormat;
       AVStream* _videoStream;
@@ -26,13 +26,23 @@ namespace remo
 {
   StreamWebStreamer::StreamWebStreamer ( Media* outMedia_ ):
     FFStream ( outMedia_ )
+    , _mediaWebStreamer ( nullptr )
+    , _imageConverter ( nullptr )
+    , _framePacer ( 0.0, LATEST_WINS )
+    , _pacedFrame ( av_frame_alloc ( ))
+    , _stopSender ( false )
+    , _frameReady ( false )
+    , _samplingPolicy ( SAMPLING_NEAREST )
+    , _scaler ( _framePool, SWS_POINT )
   {
     _description = "Web Stream";
   }
 
   StreamWebStreamer::~StreamWebStreamer ( void )
   {
+    stop ( );
     delete _imageConverter;
+    av_frame_free ( &_pacedFrame );
   }
 
   void StreamWebStreamer::init ( void )
@@ -40,29 +50,108 @@ namespace remo
     _media->init ( );
     _mediaWebStreamer = static_cast<MediaWebStreamer*>(_media);
     _imageConverter = new ImageConverter( _mediaWebStreamer->getImageWidth (), _mediaWebStreamer->getImageHeigh ());
-
-    unsigned int fps = 0;
-    frame_interval = fps == 0 ? std::chrono::microseconds(0)
-                                : std::chrono::microseconds(static_cast<unsigned int>(
-                                     1000.0 * 1000.0 / static_cast<double>(fps)));
-    frame_stopwatch.Start ();
+    _imageConverter->setSamplingPolicy ( _samplingPolicy );
   }
 
-  bool StreamWebStreamer::isSync ( void )
+  void StreamWebStreamer::setSamplingPolicy ( SAMPLING_POLICY policy_ )
   {
-    bool sync_=false;
-    if (frame_stopwatch.elapsed_time() < frame_interval)
+    _samplingPolicy = policy_;
+    if ( _imageConverter )
     {
-      sync_=true;
-      frame_stopwatch.Subtract(frame_interval);
+      _imageConverter->setSamplingPolicy ( policy_ );
     }
-    return sync_;
+  }
+
+  void StreamWebStreamer::setFramePacing ( double fps_,
+                                           PACING_POLICY policy_,
+                                           unsigned int maxPending_,
+                                           bool duplicate_ )
+  {
+    //The sender thread is started again by the next push if still needed.
+    stop ( );
+    _framePacer.setFps ( fps_ );
+    _framePacer.setPolicy ( policy_, maxPending_ );
+    _framePacer.setDuplicate ( duplicate_ );
   }
 
   void StreamWebStreamer::pushFrame ( AVFrame* frame_ )
   {
-    _imageConverter->convert(frame_->data, frame_->width, frame_->height);
-    _mediaWebStreamer->pushImage (_imageConverter);
+    _framePacer.push ( frame_ );
+    if ( _framePacer.getFps ( ) <= 0.0 )
+    {
+      sendPaced ( );
+      return;
+    }
+
+    if ( !_sender.joinable ( ))
+    {
+      _stopSender = false;
+      _sender = std::thread ( &StreamWebStreamer::senderThread, this );
+    }
+    std::unique_lock < std::mutex > lock ( _senderMtx );
+    _frameReady = true;
+    _senderCv.notify_one ( );
+  }
+
+  void StreamWebStreamer::stop ( void )
+  {
+    if ( !_sender.joinable ( ))
+    {
+      return;
+    }
+    {
+      std::unique_lock < std::mutex > lock ( _senderMtx );
+      _stopSender = true;
+      _senderCv.notify_one ( );
+    }
+    _sender.join ( );
+  }
+
+  void StreamWebStreamer::senderThread ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _senderMtx );
+    while ( !_stopSender )
+    {
+      _frameReady = false;
+      lock.unlock ( );
+      bool sent_ = sendPaced ( );
+      lock.lock ( );
+
+      if ( !sent_ && _framePacer.isDue ( ))
+      {
+        //The slot is open but empty, it goes to the next frame pushed.
+        _senderCv.wait ( lock, [this] { return _stopSender || _frameReady; } );
+      }
+      else
+      {
+        _senderCv.wait_until ( lock, _framePacer.getNextDue ( ),
+                               [this] { return _stopSender; } );
+      }
+    }
+  }
+
+  bool StreamWebStreamer::sendPaced ( void )
+  {
+    //Only the frames the pacer lets through are converted and sent.
+    if ( _framePacer.poll ( _pacedFrame ) == SKIP )
+    {
+      return false;
+    }
+
+    if ( !_imageConverter->convert ( _pacedFrame ))
+    {
+      //Same size, the converter still does the resize.
+      AVFrame* bgra_ = _scaler.scale ( _pacedFrame, AV_PIX_FMT_BGRA,
+                                       _pacedFrame->width, _pacedFrame->height );
+      if ( bgra_ )
+      {
+        _imageConverter->convert ( bgra_ );
+        _framePool.releaseFrame ( bgra_ );
+      }
+    }
+    _mediaWebStreamer->pushImage ( _imageConverter );
+    av_frame_unref ( _pacedFrame );
+    return true;
   }
 }
 #endif //REMO_USE_WEBSTREAMER defined
\ No newline at end of file
@@ -23,8 +23,14 @@
 #ifndef REMO_STREAM_WEBSTREAMER_H
 #define REMO_STREAM_WEBSTREAMER_H
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "FFStream.h"
 #include "../media/MediaWebStreamer.h"
+#include "../util/FramePacer.h"
+#include "../util/FrameScaler.h"
 
 namespace remo
 {
@@ -38,18 +44,49 @@ namespace remo
 
       virtual void init ( void );
 
-      bool isSync ( void );
+      //Caps the stream to fps_ frames per second on the wall clock. Frames
+      //arriving faster are dropped following policy_, and with duplicate_
+      //an empty slot repeats the last frame. 0 (the default) sends every
+      //frame as it is pushed.
+      void setFramePacing ( double fps_,
+                            PACING_POLICY policy_ = LATEST_WINS,
+                            unsigned int maxPending_ = 2,
+                            bool duplicate_ = false );
+      FramePacer& getFramePacer ( void ) { return _framePacer; }
 
+      //BGRA, RGB24, YUV420P and NV12 frames are sampled directly, other
+      //formats go through swscale to BGRA first. Without pacing the frame
+      //is sent before returning, otherwise it is queued for the sender
+      //thread, which wakes up on the pacer slots.
       void pushFrame ( AVFrame* frame_ );
+      //Stops the sender thread, pending frames are not sent.
+      void stop ( void );
+
+      //Filter used when resizing to the web stream size.
+      void setSamplingPolicy ( SAMPLING_POLICY policy_ );
 
       Media* getMedia ( ) { return _media; };
 
     private:
+      void senderThread ( void );
+      //Polls the pacer and sends the frame it returns, if any.
+      bool sendPaced ( void );
+
       MediaWebStreamer * _mediaWebStreamer;
       ImageConverter* _imageConverter;
 
-      webstreamer::StopWatch<> frame_stopwatch;
-      std::chrono::microseconds frame_interval;
+      FramePacer _framePacer;
+      AVFrame* _pacedFrame;
+
+      std::thread _sender;
+      std::mutex _senderMtx;
+      std::condition_variable _senderCv;
+      bool _stopSender;
+      bool _frameReady;
+
+      SAMPLING_POLICY _samplingPolicy;
+      FramePool _framePool;
+      FrameScaler _scaler;
 
   };
 }
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "FramePacer.h"
+
+namespace remo
+{
+  FramePacer::FramePacer ( double fps_,
+                           PACING_POLICY policy_,
+                           unsigned int maxPending_,
+                           bool duplicate_ )
+    : _fps ( 0.0 )
+    , _interval ( Clock::duration::zero ( ))
+    , _started ( false )
+    , _policy ( policy_ )
+    , _maxPending ( 1 )
+    , _duplicate ( duplicate_ )
+    , _last ( nullptr )
+    , _delivered ( 0 )
+    , _dropped ( 0 )
+    , _duplicated ( 0 )
+    , _late ( 0 )
+  {
+    setFps ( fps_ );
+    setPolicy ( policy_, maxPending_ );
+  }
+
+  FramePacer::~FramePacer ( void )
+  {
+    clearPending ( );
+    _framePool.releaseFrame ( _last );
+  }
+
+  void FramePacer::setFps ( double fps_ )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    _fps = fps_ > 0.0 ? fps_ : 0.0;
+    _interval = _fps > 0.0
+      ? std::chrono::duration_cast < Clock::duration > (
+        std::chrono::duration < double > ( 1.0 / _fps ))
+      : Clock::duration::zero ( );
+    _started = false;
+  }
+
+  void FramePacer::setPolicy ( PACING_POLICY policy_, unsigned int maxPending_ )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    _policy = policy_;
+    _maxPending = ( policy_ == LATEST_WINS || maxPending_ == 0 ) ? 1 : maxPending_;
+    _pending.reserve ( _maxPending + 1 );
+  }
+
+  void FramePacer::setDuplicate ( bool duplicate_ )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    _duplicate = duplicate_;
+    if ( !_duplicate )
+    {
+      _framePool.releaseFrame ( _last );
+    }
+  }
+
+  void FramePacer::clearPending ( void )
+  {
+    for ( auto& frame_ : _pending )
+    {
+      _framePool.releaseFrame ( frame_ );
+    }
+    _pending.clear ( );
+  }
+
+  void FramePacer::push ( const AVFrame* frame_ )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+
+    if ( _pending.size ( ) >= _maxPending )
+    {
+      ++_dropped;
+      if ( _policy == DROP_NEWEST )
+      {
+        return;
+      }
+
+      //DROP_OLDEST and LATEST_WINS make room discarding the oldest frame.
+      _framePool.releaseFrame ( _pending.front ( ));
+      _pending.erase ( _pending.begin ( ));
+    }
+
+    AVFrame* ref_ = _framePool.getFrame ( );
+    if ( ref_ && ( av_frame_ref ( ref_, frame_ ) >= 0 ))
+    {
+      _pending.push_back ( ref_ );
+    }
+    else
+    {
+      ++_dropped;
+      _framePool.releaseFrame ( ref_ );
+    }
+  }
+
+  bool FramePacer::isDue ( Clock::time_point now_ )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    return ( _fps <= 0.0 ) || !_started || ( now_ >= _nextDeadline );
+  }
+
+  FramePacer::Clock::time_point FramePacer::getNextDue ( Clock::time_point now_ )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    return (( _fps <= 0.0 ) || !_started ) ? now_ : _nextDeadline;
+  }
+
+  PACING_ACTION FramePacer::poll ( AVFrame* frame_, Clock::time_point now_ )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+
+    if ( _fps > 0.0 )
+    {
+      if ( !_started )
+      {
+        _nextDeadline = now_;
+      }
+      else if ( now_ < _nextDeadline )
+      {
+        return SKIP;
+      }
+    }
+
+    PACING_ACTION action_ = SKIP;
+    if ( !_pending.empty ( ))
+    {
+      av_frame_move_ref ( frame_, _pending.front ( ));
+      _framePool.releaseFrame ( _pending.front ( ));
+      _pending.erase ( _pending.begin ( ));
+      ++_delivered;
+      action_ = DELIVER;
+
+      if ( _duplicate )
+      {
+        _framePool.releaseFrame ( _last );
+        _last = _framePool.getFrame ( );
+        if ( _last && ( av_frame_ref ( _last, frame_ ) < 0 ))
+        {
+          _framePool.releaseFrame ( _last );
+        }
+      }
+    }
+    else if ( _duplicate && _started && _last
+      && ( av_frame_ref ( frame_, _last ) >= 0 ))
+    {
+      ++_duplicated;
+      action_ = DUPLICATE;
+    }
+
+    //An empty slot without duplication keeps the deadline, so the next frame
+    //goes out as soon as it arrives.
+    if (( _fps > 0.0 ) && ( action_ != SKIP ))
+    {
+      _nextDeadline += _interval;
+      if ( now_ - _nextDeadline > _interval )
+      {
+        //More than one slot behind, resync instead of bursting to catch up.
+        ++_late;
+        _nextDeadline = now_ + _interval;
+      }
+    }
+    _started = _started || ( action_ != SKIP );
+
+    return action_;
+  }
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_FRAMEPACER_H
+#define REMO_FRAMEPACER_H
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "ffdefs.h"
+#include "FramePool.h"
+
+namespace remo
+{
+  //What to do with the pending frames when a new one arrives and the
+  //pending queue is full.
+  enum PACING_POLICY
+  {
+    DROP_OLDEST,
+    DROP_NEWEST,
+    LATEST_WINS //Keep only the newest frame, lowest latency.
+  };
+
+  enum PACING_ACTION
+  {
+    DELIVER,    //A new frame is due.
+    SKIP,       //Nothing to send now.
+    DUPLICATE   //A slot is due but no new frame arrived, repeat the last one.
+  };
+
+  //Wall-clock frame scheduler for live outputs. Frames are pushed as they are
+  //decoded and polled by the output, which only gets one frame per
+  //1/fps seconds on a monotonic clock.
+  class FramePacer
+  {
+    public:
+      typedef std::chrono::steady_clock Clock;
+
+      FramePacer ( double fps_ = 0.0,
+                   PACING_POLICY policy_ = LATEST_WINS,
+                   unsigned int maxPending_ = 2,
+                   bool duplicate_ = false );
+      ~FramePacer ( void );
+
+      FramePacer ( const FramePacer& ) = delete;
+      FramePacer& operator= ( const FramePacer& ) = delete;
+
+      //0 disables pacing, every pushed frame is delivered.
+      void setFps ( double fps_ );
+      double getFps ( void ) { return _fps; }
+      void setPolicy ( PACING_POLICY policy_, unsigned int maxPending_ = 2 );
+      void setDuplicate ( bool duplicate_ );
+
+      //Stores a new reference to the frame, the caller keeps its own.
+      void push ( const AVFrame* frame_ );
+      //On DELIVER and DUPLICATE frame_ receives a reference to the frame to
+      //send, that the caller must unref.
+      PACING_ACTION poll ( AVFrame* frame_, Clock::time_point now_ = Clock::now ( ));
+      //True when the next output slot is already due.
+      bool isDue ( Clock::time_point now_ = Clock::now ( ));
+      //When the next output slot opens, now_ when pacing is off or nothing
+      //was delivered yet.
+      Clock::time_point getNextDue ( Clock::time_point now_ = Clock::now ( ));
+
+      unsigned long getDelivered ( void ) { return _delivered; }
+      unsigned long getDropped ( void ) { return _dropped; }
+      unsigned long getDuplicated ( void ) { return _duplicated; }
+      //Times the output fell more than one slot behind and was resynced.
+      unsigned long getLate ( void ) { return _late; }
+
+    private:
+      void clearPending ( void );
+
+      double _fps;
+      Clock::duration _interval;
+      Clock::time_point _nextDeadline;
+      bool _started;
+
+      PACING_POLICY _policy;
+      unsigned int _maxPending;
+      bool _duplicate;
+
+      std::mutex _mtx;
+      FramePool _framePool;
+      std::vector < AVFrame* > _pending;
+      AVFrame* _last;
+
+      unsigned long _delivered;
+      unsigned long _dropped;
+      unsigned long _duplicated;
+      unsigned long _late;
+  };
+}
+
+#endif //REMO_FRAMEPACER_H
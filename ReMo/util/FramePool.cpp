@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "FramePool.h"
+
+namespace remo
+{
+  FramePool::FramePool ( int alignment_ )
+    : _alignment ( alignment_ > 0 ? alignment_ : 64 )
+    , _requests ( 0 )
+    , _misses ( 0 )
+  {
+  }
+
+  FramePool::~FramePool ( void )
+  {
+    for ( auto& frame_ : _freeFrames )
+    {
+      av_frame_free ( &frame_ );
+    }
+
+    //Buffers still referenced elsewhere are freed when they are released.
+    for ( auto& it_ : _pools )
+    {
+      av_buffer_pool_uninit ( &it_.second._pool );
+    }
+  }
+
+  AVBufferRef* FramePool::allocBuffer ( void* opaque_, BufferSize size_ )
+  {
+    BufferPool* pool_ = static_cast<BufferPool*>( opaque_ );
+    ++pool_->_owner->_misses;
+
+    return av_buffer_alloc ( size_ );
+  }
+
+  FramePool::BufferPool* FramePool::findPool ( AVPixelFormat format_,
+                                              int width_,
+                                              int height_ )
+  {
+    PoolKey key_ ( format_, width_, height_ );
+
+    auto it_ = _pools.find ( key_ );
+    if ( it_ != _pools.end ( ))
+    {
+      return &it_->second;
+    }
+
+    BufferPool pool_;
+    pool_._owner = this;
+    pool_._pool = nullptr;
+    pool_._paddedHeight = FFALIGN( height_, 32 );
+
+    if ( av_image_fill_linesizes ( pool_._linesize, format_, width_ ) < 0 )
+    {
+      return nullptr;
+    }
+
+    //Aligned linesizes keep every plane and row start aligned as well.
+    for ( int i = 0; i < AV_NUM_DATA_POINTERS; ++i )
+    {
+      pool_._linesize[i] = FFALIGN( pool_._linesize[i], _alignment );
+    }
+
+    uint8_t* data_[AV_NUM_DATA_POINTERS] = { nullptr };
+    int size_ = av_image_fill_pointers ( data_,
+                                         format_,
+                                         pool_._paddedHeight,
+                                         nullptr,
+                                         pool_._linesize );
+    if ( size_ < 0 )
+    {
+      return nullptr;
+    }
+
+    BufferPool& stored_ = _pools[key_];
+    stored_ = pool_;
+    stored_._pool = av_buffer_pool_init2 ( size_ + _alignment
+                                             + AV_INPUT_BUFFER_PADDING_SIZE,
+                                           &stored_,
+                                           &FramePool::allocBuffer,
+                                           nullptr );
+    if ( !stored_._pool )
+    {
+      _pools.erase ( key_ );
+      return nullptr;
+    }
+
+    return &stored_;
+  }
+
+  AVFrame* FramePool::getFrame ( void )
+  {
+    AVFrame* frame_ = nullptr;
+    ++_requests;
+    {
+      std::unique_lock < std::mutex > lock ( _mtx );
+      if ( !_freeFrames.empty ( ))
+      {
+        frame_ = _freeFrames.back ( );
+        _freeFrames.pop_back ( );
+      }
+    }
+
+    if ( !frame_ )
+    {
+      ++_misses;
+      frame_ = av_frame_alloc ( );
+    }
+
+    return frame_;
+  }
+
+  AVFrame* FramePool::getFrame ( AVPixelFormat format_, int width_, int height_ )
+  {
+    AVFrame* frame_ = getFrame ( );
+    if ( !frame_ )
+    {
+      return nullptr;
+    }
+
+    frame_->format = format_;
+    frame_->width = width_;
+    frame_->height = height_;
+
+    const AVPixFmtDescriptor* desc_ = av_pix_fmt_desc_get ( format_ );
+    if ( desc_ && ( desc_->flags & AV_PIX_FMT_FLAG_PAL ))
+    {
+      //Paletted formats need the palette plane, let libav handle them.
+      ++_requests;
+      ++_misses;
+      if ( av_frame_get_buffer ( frame_, _alignment ) < 0 )
+      {
+        releaseFrame ( frame_ );
+      }
+      return frame_;
+    }
+
+    std::unique_lock < std::mutex > lock ( _mtx );
+    BufferPool* pool_ = findPool ( format_, width_, height_ );
+    if ( pool_ )
+    {
+      ++_requests;
+      frame_->buf[0] = av_buffer_pool_get ( pool_->_pool );
+    }
+    lock.unlock ( );
+
+    if ( !pool_ || !frame_->buf[0] )
+    {
+      releaseFrame ( frame_ );
+      return nullptr;
+    }
+
+    uint8_t* base_ = frame_->buf[0]->data;
+    base_ += ( _alignment - reinterpret_cast<uintptr_t>( base_ ) % _alignment )
+      % _alignment;
+
+    for ( int i = 0; i < AV_NUM_DATA_POINTERS; ++i )
+    {
+      frame_->linesize[i] = pool_->_linesize[i];
+    }
+    av_image_fill_pointers ( frame_->data,
+                             format_,
+                             pool_->_paddedHeight,
+                             base_,
+                             frame_->linesize );
+    frame_->extended_data = frame_->data;
+
+    return frame_;
+  }
+
+  void FramePool::releaseFrame ( AVFrame*& frame_ )
+  {
+    if ( !frame_ )
+    {
+      return;
+    }
+
+    //Returns the image buffers to their pool (if nobody else holds them).
+    av_frame_unref ( frame_ );
+
+    std::unique_lock < std::mutex > lock ( _mtx );
+    _freeFrames.push_back ( frame_ );
+    frame_ = nullptr;
+  }
+
+  PacketPool::PacketPool ( void )
+    : _requests ( 0 )
+    , _misses ( 0 )
+  {
+  }
+
+  PacketPool::~PacketPool ( void )
+  {
+    for ( auto& packet_ : _freePackets )
+    {
+      av_packet_free ( &packet_ );
+    }
+  }
+
+  AVPacket* PacketPool::getPacket ( void )
+  {
+    AVPacket* packet_ = nullptr;
+    ++_requests;
+    {
+      std::unique_lock < std::mutex > lock ( _mtx );
+      if ( !_freePackets.empty ( ))
+      {
+        packet_ = _freePackets.back ( );
+        _freePackets.pop_back ( );
+      }
+    }
+
+    if ( !packet_ )
+    {
+      ++_misses;
+      packet_ = av_packet_alloc ( );
+    }
+
+    return packet_;
+  }
+
+  void PacketPool::releasePacket ( AVPacket*& packet_ )
+  {
+    if ( !packet_ )
+    {
+      return;
+    }
+
+    av_packet_unref ( packet_ );
+
+    std::unique_lock < std::mutex > lock ( _mtx );
+    _freePackets.push_back ( packet_ );
+    packet_ = nullptr;
+  }
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_FRAMEPOOL_H
+#define REMO_FRAMEPOOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "ffdefs.h"
+
+namespace remo
+{
+  //Recycles refcounted AVFrames. Image buffers come from one AVBufferPool per
+  //(format, width, height) and go back to it when their last reference is
+  //dropped, the AVFrame structs themselves are kept in a free list.
+  class FramePool
+  {
+    public:
+      FramePool ( int alignment_ = 64 );
+      ~FramePool ( void );
+
+      FramePool ( const FramePool& ) = delete;
+      FramePool& operator= ( const FramePool& ) = delete;
+
+      //Empty frame, to be filled by a decoder or by av_frame_ref.
+      AVFrame* getFrame ( void );
+      //Writable frame with aligned and padded planes of the given geometry.
+      AVFrame* getFrame ( AVPixelFormat format_, int width_, int height_ );
+      //Drops the references of the frame and recycles it. Sets it to nullptr.
+      void releaseFrame ( AVFrame*& frame_ );
+
+      unsigned long getHits ( void ) { return _requests - _misses; }
+      unsigned long getMisses ( void ) { return _misses; }
+
+    private:
+      typedef std::tuple < int, int, int > PoolKey;
+
+      struct BufferPool
+      {
+        FramePool* _owner;
+        AVBufferPool* _pool;
+        int _linesize[AV_NUM_DATA_POINTERS];
+        int _paddedHeight;
+      };
+
+#if LIBAVUTIL_VERSION_MAJOR < 57
+      typedef int BufferSize;
+#else
+      typedef size_t BufferSize;
+#endif
+      static AVBufferRef* allocBuffer ( void* opaque_, BufferSize size_ );
+
+      BufferPool* findPool ( AVPixelFormat format_, int width_, int height_ );
+
+      int _alignment;
+
+      std::mutex _mtx;
+      std::vector < AVFrame* > _freeFrames;
+      std::map < PoolKey, BufferPool > _pools;
+
+      std::atomic < unsigned long > _requests;
+      std::atomic < unsigned long > _misses;
+  };
+
+  //Recycles AVPacket structs, payloads stay refcounted by libav.
+  class PacketPool
+  {
+    public:
+      PacketPool ( void );
+      ~PacketPool ( void );
+
+      PacketPool ( const PacketPool& ) = delete;
+      PacketPool& operator= ( const PacketPool& ) = delete;
+
+      AVPacket* getPacket ( void );
+      //Drops the references of the packet and recycles it. Sets it to nullptr.
+      void releasePacket ( AVPacket*& packet_ );
+
+      unsigned long getHits ( void ) { return _requests - _misses; }
+      unsigned long getMisses ( void ) { return _misses; }
+
+    private:
+      std::mutex _mtx;
+      std::vector < AVPacket* > _freePackets;
+
+      std::atomic < unsigned long > _requests;
+      std::atomic < unsigned long > _misses;
+  };
+}
+
+#endif //REMO_FRAMEPOOL_H
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "FrameScaler.h"
+
+namespace remo
+{
+  FrameScaler::FrameScaler ( FramePool& framePool_, int resampleFlags_ )
+    : _framePool ( framePool_ )
+    , _resampleFlags ( resampleFlags_ )
+    , _lastPath ( BYPASS )
+    , _counts { 0, 0, 0 }
+  {
+  }
+
+  FrameScaler::~FrameScaler ( void )
+  {
+  }
+
+  unsigned long FrameScaler::getCount ( SCALE_PATH path_ )
+  {
+    return path_ < NUM_SCALE_PATHS ? _counts[path_] : 0;
+  }
+
+  AVFrame* FrameScaler::scale ( const AVFrame* frame_,
+                                AVPixelFormat format_,
+                                int width_,
+                                int height_ )
+  {
+    AVPixelFormat inFormat_ = static_cast<AVPixelFormat>( frame_->format );
+    bool sameSize_ = ( frame_->width == width_ ) && ( frame_->height == height_ );
+
+    if ( sameSize_ && ( inFormat_ == format_ ))
+    {
+      AVFrame* outFrame_ = _framePool.getFrame ( );
+      if ( outFrame_ && ( av_frame_ref ( outFrame_, frame_ ) < 0 ))
+      {
+        _framePool.releaseFrame ( outFrame_ );
+      }
+      else if ( outFrame_ )
+      {
+        //Raw decoders mark every frame as I, the encoders would force
+        //each one to be a keyframe and ignore the GOP.
+        outFrame_->pict_type = AV_PICTURE_TYPE_NONE;
+        outFrame_->key_frame = 0;
+      }
+
+      _lastPath = BYPASS;
+      ++_counts[_lastPath];
+      return outFrame_;
+    }
+
+    //Without resampling no filter is needed, point sampling lets swscale
+    //pick its unscaled converters.
+    AVFrame* outFrame_ = _framePool.getFrame ( format_, width_, height_ );
+    if ( !outFrame_ || !_parallelScaler.scale ( frame_, outFrame_,
+                                                sameSize_ ? SWS_POINT
+                                                          : _resampleFlags ))
+    {
+      _framePool.releaseFrame ( outFrame_ );
+      return nullptr;
+    }
+
+    _lastPath = sameSize_ ? CONVERT : RESAMPLE;
+    ++_counts[_lastPath];
+    return outFrame_;
+  }
+}
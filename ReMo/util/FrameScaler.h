@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_FRAMESCALER_H
+#define REMO_FRAMESCALER_H
+
+#include "ffdefs.h"
+#include "FramePool.h"
+#include "ParallelScaler.h"
+
+namespace remo
+{
+  //Brings frames to a target format and size taking the cheapest path:
+  //a new reference when they already match, a conversion without
+  //resampling when only the format differs and a full resample otherwise.
+  //Conversions run in slices on a ParallelScaler.
+  class FrameScaler
+  {
+    public:
+      enum SCALE_PATH
+      {
+        BYPASS = 0,
+        CONVERT,
+        RESAMPLE,
+        NUM_SCALE_PATHS
+      };
+
+      FrameScaler ( FramePool& framePool_, int resampleFlags_ = SWS_BICUBIC );
+      ~FrameScaler ( void );
+
+      FrameScaler ( const FrameScaler& ) = delete;
+      FrameScaler& operator= ( const FrameScaler& ) = delete;
+
+      //Pooled frame, to be released to the pool, or nullptr on error.
+      AVFrame* scale ( const AVFrame* frame_,
+                       AVPixelFormat format_,
+                       int width_,
+                       int height_ );
+
+      //Without a pool, WorkerPool::getShared ( ).
+      void setWorkerPool ( WorkerPool* workers_ ) { _parallelScaler.setWorkerPool ( workers_ ); }
+
+      SCALE_PATH getLastPath ( void ) { return _lastPath; }
+      unsigned long getCount ( SCALE_PATH path_ );
+
+    private:
+      FramePool& _framePool;
+      int _resampleFlags;
+      ParallelScaler _parallelScaler;
+
+      SCALE_PATH _lastPath;
+      unsigned long _counts[NUM_SCALE_PATHS];
+  };
+}
+
+#endif //REMO_FRAMESCALER_H
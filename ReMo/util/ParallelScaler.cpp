@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "ParallelScaler.h"
+
+#include <algorithm>
+
+namespace remo
+{
+  namespace
+  {
+    //Smallest slice worth a task of its own, in destination rows.
+    const int minSliceRows = 32;
+
+    int greatestCommonDivisor ( int a_, int b_ )
+    {
+      while ( b_ != 0 )
+      {
+        int r_ = a_ % b_;
+        a_ = b_;
+        b_ = r_;
+      }
+      return a_;
+    }
+
+    //Half the support of the swscale filters, in rows of the smaller
+    //image. One more than the kernel radius covers the rounding of the
+    //filter positions.
+    int filterReach ( int flags_ )
+    {
+      if ( flags_ & ( SWS_POINT | SWS_AREA | SWS_FAST_BILINEAR | SWS_BILINEAR ))
+      {
+        return 2;
+      }
+      if ( flags_ & ( SWS_BICUBIC | SWS_BICUBLIN ))
+      {
+        return 3;
+      }
+      if ( flags_ & SWS_LANCZOS )
+      {
+        return 4;
+      }
+      if ( flags_ & ( SWS_SINC | SWS_SPLINE ))
+      {
+        return 11;
+      }
+      return 5;
+    }
+
+    //Plane pointers moved down to row y_ of the image.
+    void offsetPlanes ( const AVPixFmtDescriptor* desc_,
+                        const uint8_t* const data_[],
+                        const int linesize_[],
+                        int y_,
+                        uint8_t* planes_[4] )
+    {
+      for ( int p = 0; p < 4; ++p )
+      {
+        if ( !data_[p] )
+        {
+          planes_[p] = nullptr;
+          continue;
+        }
+        int rows_ = (( p == 1 ) || ( p == 2 )) ? ( y_ >> desc_->log2_chroma_h ) : y_;
+        planes_[p] = const_cast < uint8_t* > ( data_[p] ) + rows_ * linesize_[p];
+      }
+    }
+  }
+
+  bool ParallelScaler::Geometry::operator== ( const Geometry& other_ ) const
+  {
+    return ( srcWidth == other_.srcWidth ) && ( srcHeight == other_.srcHeight )
+      && ( srcFormat == other_.srcFormat ) && ( dstWidth == other_.dstWidth )
+      && ( dstHeight == other_.dstHeight ) && ( dstFormat == other_.dstFormat )
+      && ( flags == other_.flags );
+  }
+
+  ParallelScaler::ParallelScaler ( WorkerPool* workers_ )
+    : _workers ( workers_ ? workers_ : WorkerPool::getShared ( ))
+    , _maxSlices ( 0 )
+    , _configured ( false )
+  {
+  }
+
+  ParallelScaler::~ParallelScaler ( void )
+  {
+    clear ( );
+  }
+
+  void ParallelScaler::setWorkerPool ( WorkerPool* workers_ )
+  {
+    _workers = workers_ ? workers_ : WorkerPool::getShared ( );
+    _configured = false;
+  }
+
+  void ParallelScaler::setMaxSlices ( unsigned int maxSlices_ )
+  {
+    _maxSlices = maxSlices_;
+    _configured = false;
+  }
+
+  void ParallelScaler::clear ( void )
+  {
+    for ( Slice& slice_: _slices )
+    {
+      sws_freeContext ( slice_.swsCtx );
+      av_freep ( &slice_.scratch[0] );
+    }
+    _slices.clear ( );
+    _configured = false;
+  }
+
+  bool ParallelScaler::configure ( const Geometry& geometry_ )
+  {
+    if ( _configured && ( geometry_ == _geometry ))
+    {
+      return true;
+    }
+    _geometry = geometry_;
+    _configured = false;
+
+    const AVPixFmtDescriptor* srcDesc_ = av_pix_fmt_desc_get ( geometry_.srcFormat );
+    const AVPixFmtDescriptor* dstDesc_ = av_pix_fmt_desc_get ( geometry_.dstFormat );
+    if ( !srcDesc_ || !dstDesc_ || ( geometry_.srcHeight <= 0 )
+      || ( geometry_.dstHeight <= 0 ))
+    {
+      return false;
+    }
+
+    //Rows where both images line up, in steps that keep the slices on
+    //whole chroma rows of both formats.
+    int common_ = greatestCommonDivisor ( geometry_.srcHeight, geometry_.dstHeight );
+    int srcUnit_ = geometry_.srcHeight / common_;
+    int dstUnit_ = geometry_.dstHeight / common_;
+    int chromaRows_ = 1 << std::max ( srcDesc_->log2_chroma_h,
+                                      dstDesc_->log2_chroma_h );
+    int step_ = 1;
+    while ((( srcUnit_ * step_ ) % chromaRows_ ) || (( dstUnit_ * step_ ) % chromaRows_ ))
+    {
+      ++step_;
+    }
+    srcUnit_ *= step_;
+    dstUnit_ *= step_;
+    int units_ = std::max ( 1, common_ / step_ );
+
+    int numSlices_ = _maxSlices ? _maxSlices : _workers->getNumThreads ( );
+    numSlices_ = std::min ( numSlices_, units_ );
+    numSlices_ = std::min ( numSlices_, geometry_.dstHeight / minSliceRows );
+    //Palettes live in data[1] and cannot be moved down.
+    if (( srcDesc_->flags | dstDesc_->flags ) & AV_PIX_FMT_FLAG_PAL )
+    {
+      numSlices_ = 1;
+    }
+    numSlices_ = std::max ( 1, numSlices_ );
+
+    //Source rows read around a slice border, chroma filters reach further.
+    int marginUnits_ = 0;
+    if (( geometry_.srcWidth != geometry_.dstWidth )
+      || ( geometry_.srcHeight != geometry_.dstHeight ))
+    {
+      int ratio_ = std::max ( 1, ( geometry_.srcHeight + geometry_.dstHeight - 1 )
+                                 / geometry_.dstHeight );
+      int reach_ = filterReach ( geometry_.flags ) * ratio_ * chromaRows_;
+      marginUnits_ = ( reach_ + srcUnit_ - 1 ) / srcUnit_;
+    }
+
+    for ( unsigned int s = numSlices_; s < _slices.size ( ); ++s )
+    {
+      sws_freeContext ( _slices[s].swsCtx );
+      av_freep ( &_slices[s].scratch[0] );
+    }
+    _slices.resize ( numSlices_, Slice { 0, 0, 0, 0, 0, 0, nullptr,
+                                         { nullptr, nullptr, nullptr, nullptr },
+                                         { 0, 0, 0, 0 } } );
+
+    //The last unit also takes the rows left by the chroma steps.
+    auto srcRow_ = [ & ] ( int unit_ )
+    {
+      return ( unit_ >= units_ ) ? geometry_.srcHeight : unit_ * srcUnit_;
+    };
+    auto dstRow_ = [ & ] ( int unit_ )
+    {
+      return ( unit_ >= units_ ) ? geometry_.dstHeight : unit_ * dstUnit_;
+    };
+
+    for ( int s = 0; s < numSlices_; ++s )
+    {
+      Slice& slice_ = _slices[s];
+      int begin_ = units_ * s / numSlices_;
+      int end_ = units_ * ( s + 1 ) / numSlices_;
+      int windowBegin_ = std::max ( 0, begin_ - marginUnits_ );
+      int windowEnd_ = std::min ( units_, end_ + marginUnits_ );
+
+      slice_.dstY = dstRow_ ( begin_ );
+      slice_.dstHeight = dstRow_ ( end_ ) - slice_.dstY;
+      slice_.srcWindowY = srcRow_ ( windowBegin_ );
+      slice_.srcWindowHeight = srcRow_ ( windowEnd_ ) - slice_.srcWindowY;
+      slice_.dstWindowY = dstRow_ ( windowBegin_ );
+      slice_.dstWindowHeight = dstRow_ ( windowEnd_ ) - slice_.dstWindowY;
+
+      slice_.swsCtx = sws_getCachedContext ( slice_.swsCtx,
+                                             geometry_.srcWidth,
+                                             slice_.srcWindowHeight,
+                                             geometry_.srcFormat,
+                                             geometry_.dstWidth,
+                                             slice_.dstWindowHeight,
+                                             geometry_.dstFormat,
+                                             geometry_.flags,
+                                             nullptr, nullptr, nullptr );
+      av_freep ( &slice_.scratch[0] );
+      if ( !slice_.swsCtx )
+      {
+        return false;
+      }
+      if (( slice_.dstWindowHeight != slice_.dstHeight )
+        && ( av_image_alloc ( slice_.scratch, slice_.scratchLinesize,
+                              geometry_.dstWidth, slice_.dstWindowHeight,
+                              geometry_.dstFormat, 64 ) < 0 ))
+      {
+        return false;
+      }
+    }
+
+    _configured = true;
+    return true;
+  }
+
+  void ParallelScaler::scaleSlice ( Slice& slice_,
+                                    const uint8_t* const srcData_[],
+                                    const int srcLinesize_[],
+                                    uint8_t* const dstData_[],
+                                    const int dstLinesize_[] )
+  {
+    const AVPixFmtDescriptor* srcDesc_ = av_pix_fmt_desc_get ( _geometry.srcFormat );
+    const AVPixFmtDescriptor* dstDesc_ = av_pix_fmt_desc_get ( _geometry.dstFormat );
+
+    uint8_t* src_[4];
+    uint8_t* dst_[4];
+    offsetPlanes ( srcDesc_, srcData_, srcLinesize_, slice_.srcWindowY, src_ );
+    offsetPlanes ( dstDesc_, dstData_, dstLinesize_, slice_.dstY, dst_ );
+
+    if ( !slice_.scratch[0] )
+    {
+      sws_scale ( slice_.swsCtx, src_, srcLinesize_, 0, slice_.srcWindowHeight,
+                  dst_, dstLinesize_ );
+      return;
+    }
+
+    sws_scale ( slice_.swsCtx, src_, srcLinesize_, 0, slice_.srcWindowHeight,
+                slice_.scratch, slice_.scratchLinesize );
+
+    uint8_t* scratch_[4];
+    offsetPlanes ( dstDesc_, slice_.scratch, slice_.scratchLinesize,
+                   slice_.dstY - slice_.dstWindowY, scratch_ );
+    av_image_copy ( dst_, const_cast < int* > ( dstLinesize_ ),
+                    const_cast < const uint8_t** > ( scratch_ ),
+                    slice_.scratchLinesize, _geometry.dstFormat,
+                    _geometry.dstWidth, slice_.dstHeight );
+  }
+
+  bool ParallelScaler::scale ( const uint8_t* const srcData_[],
+                               const int srcLinesize_[],
+                               int srcWidth_,
+                               int srcHeight_,
+                               AVPixelFormat srcFormat_,
+                               uint8_t* const dstData_[],
+                               const int dstLinesize_[],
+                               int dstWidth_,
+                               int dstHeight_,
+                               AVPixelFormat dstFormat_,
+                               int flags_ )
+  {
+    Geometry geometry_ { srcWidth_, srcHeight_, srcFormat_,
+                         dstWidth_, dstHeight_, dstFormat_, flags_ };
+    if ( !configure ( geometry_ ))
+    {
+      return false;
+    }
+
+    if ( _slices.size ( ) == 1 )
+    {
+      scaleSlice ( _slices[0], srcData_, srcLinesize_, dstData_, dstLinesize_ );
+      return true;
+    }
+
+    _workers->parallelFor ( _slices.size ( ), 1,
+      [ this, srcData_, srcLinesize_, dstData_, dstLinesize_ ]
+      ( unsigned int begin_, unsigned int end_ )
+      {
+        for ( unsigned int s = begin_; s < end_; ++s )
+        {
+          scaleSlice ( _slices[s], srcData_, srcLinesize_, dstData_, dstLinesize_ );
+        }
+      } );
+    return true;
+  }
+
+  bool ParallelScaler::scale ( const AVFrame* srcFrame_, AVFrame* dstFrame_, int flags_ )
+  {
+    return scale ( srcFrame_->data,
+                   srcFrame_->linesize,
+                   srcFrame_->width,
+                   srcFrame_->height,
+                   static_cast<AVPixelFormat>( srcFrame_->format ),
+                   dstFrame_->data,
+                   dstFrame_->linesize,
+                   dstFrame_->width,
+                   dstFrame_->height,
+                   static_cast<AVPixelFormat>( dstFrame_->format ),
+                   flags_ );
+  }
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef REMO_PARALLELSCALER_H
+#define REMO_PARALLELSCALER_H
+
+#include <vector>
+
+#include "ffdefs.h"
+#include "WorkerPool.h"
+
+namespace remo
+{
+  //sws_scale split in horizontal slices converted concurrently, each one
+  //with its own SwsContext kept across frames. Slice borders fall on rows
+  //where source and destination line up exactly, so every slice keeps the
+  //scale of the whole frame. When resampling, slices are widened by the
+  //filter reach and scaled into a scratch image, only their own rows are
+  //copied out, so there are no seams. Not thread safe, one per user.
+  class ParallelScaler
+  {
+    public:
+      //Without a pool, slices run on WorkerPool::getShared ( ).
+      ParallelScaler ( WorkerPool* workers_ = nullptr );
+      ~ParallelScaler ( void );
+
+      ParallelScaler ( const ParallelScaler& ) = delete;
+      ParallelScaler& operator= ( const ParallelScaler& ) = delete;
+
+      void setWorkerPool ( WorkerPool* workers_ );
+      //0 uses one slice per pool thread, 1 scales on the calling thread.
+      void setMaxSlices ( unsigned int maxSlices_ );
+
+      bool scale ( const uint8_t* const srcData_[],
+                   const int srcLinesize_[],
+                   int srcWidth_,
+                   int srcHeight_,
+                   AVPixelFormat srcFormat_,
+                   uint8_t* const dstData_[],
+                   const int dstLinesize_[],
+                   int dstWidth_,
+                   int dstHeight_,
+                   AVPixelFormat dstFormat_,
+                   int flags_ );
+      //dstFrame_ must be allocated, its format and size are the target.
+      bool scale ( const AVFrame* srcFrame_, AVFrame* dstFrame_, int flags_ );
+
+      unsigned int getNumSlices ( void ) { return _slices.size ( ); }
+
+    private:
+      struct Geometry
+      {
+        int srcWidth;
+        int srcHeight;
+        AVPixelFormat srcFormat;
+        int dstWidth;
+        int dstHeight;
+        AVPixelFormat dstFormat;
+        int flags;
+
+        bool operator== ( const Geometry& other_ ) const;
+      };
+
+      struct Slice
+      {
+        //Rows this slice writes.
+        int dstY;
+        int dstHeight;
+        //Rows it scales, dstY and dstHeight plus the filter margins.
+        int srcWindowY;
+        int srcWindowHeight;
+        int dstWindowY;
+        int dstWindowHeight;
+        SwsContext* swsCtx;
+        //Scaled window when it is wider than the slice.
+        uint8_t* scratch[4];
+        int scratchLinesize[4];
+      };
+
+      bool configure ( const Geometry& geometry_ );
+      void clear ( void );
+      void scaleSlice ( Slice& slice_,
+                        const uint8_t* const srcData_[],
+                        const int srcLinesize_[],
+                        uint8_t* const dstData_[],
+                        const int dstLinesize_[] );
+
+      WorkerPool* _workers;
+      unsigned int _maxSlices;
+
+      Geometry _geometry;
+      bool _configured;
+      std::vector < Slice > _slices;
+  };
+}
+
+#endif //REMO_PARALLELSCALER_H
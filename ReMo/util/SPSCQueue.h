@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_SPSCQUEUE_H
+#define REMO_SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace remo
+{
+  //Bounded lock-free queue for exactly one producer and one consumer thread.
+  //Blocking push/pop spin for a short while and then back off sleeping, so
+  //an idle stage does not burn a whole core.
+  template < class T >
+  class SPSCQueue
+  {
+    public:
+      SPSCQueue ( std::size_t capacity_ = 8 )
+        : _capacity ( capacity_ > 0 ? capacity_ : 1 )
+        , _buffer ( _capacity )
+        , _head ( 0 )
+        , _tail ( 0 )
+        , _highWaterMark ( 0 )
+        , _closed ( false )
+      {
+      }
+
+      SPSCQueue ( const SPSCQueue& ) = delete;
+      SPSCQueue& operator= ( const SPSCQueue& ) = delete;
+
+      //Producer side
+      bool tryPush ( T& item_ )
+      {
+        std::size_t tail_ = _tail.load ( std::memory_order_relaxed );
+        std::size_t used_ = tail_ - _head.load ( std::memory_order_acquire );
+        if ( used_ >= _capacity )
+        {
+          return false;
+        }
+
+        _buffer[tail_ % _capacity] = std::move ( item_ );
+        _tail.store ( tail_ + 1, std::memory_order_release );
+
+        if ( used_ + 1 > _highWaterMark.load ( std::memory_order_relaxed ))
+        {
+          _highWaterMark.store ( used_ + 1, std::memory_order_relaxed );
+        }
+        return true;
+      }
+
+      //Returns false if the queue was closed before the item could be stored.
+      bool push ( T item_ )
+      {
+        unsigned int spins_ = 0;
+        while ( !tryPush ( item_ ))
+        {
+          if ( _closed.load ( std::memory_order_acquire ))
+          {
+            return false;
+          }
+          backOff ( spins_ );
+        }
+        return true;
+      }
+
+      //Consumer side
+      bool tryPop ( T& item_ )
+      {
+        std::size_t head_ = _head.load ( std::memory_order_relaxed );
+        if ( head_ == _tail.load ( std::memory_order_acquire ))
+        {
+          return false;
+        }
+
+        item_ = std::move ( _buffer[head_ % _capacity] );
+        _head.store ( head_ + 1, std::memory_order_release );
+        return true;
+      }
+
+      //Returns false once the queue is closed and fully drained.
+      bool pop ( T& item_ )
+      {
+        unsigned int spins_ = 0;
+        while ( !tryPop ( item_ ))
+        {
+          if ( _closed.load ( std::memory_order_acquire ))
+          {
+            //The producer may have pushed right before closing.
+            return tryPop ( item_ );
+          }
+          backOff ( spins_ );
+        }
+        return true;
+      }
+
+      //Signals end of stream, blocked push/pop calls return.
+      void close ( void ) { _closed.store ( true, std::memory_order_release ); }
+      bool isClosed ( void ) const { return _closed.load ( std::memory_order_acquire ); }
+
+      std::size_t size ( void ) const
+      {
+        return _tail.load ( std::memory_order_acquire )
+          - _head.load ( std::memory_order_acquire );
+      }
+      std::size_t capacity ( void ) const { return _capacity; }
+
+      std::size_t getHighWaterMark ( void ) const
+      {
+        return _highWaterMark.load ( std::memory_order_relaxed );
+      }
+
+    private:
+      static void backOff ( unsigned int& spins_ )
+      {
+        if ( ++spins_ < 64 )
+        {
+          std::this_thread::yield ( );
+        }
+        else
+        {
+          std::this_thread::sleep_for ( std::chrono::microseconds ( 100 ));
+        }
+      }
+
+      const std::size_t _capacity;
+      std::vector < T > _buffer;
+
+      //Keep producer and consumer indexes on different cache lines.
+      char _pad0[64];
+      std::atomic < std::size_t > _head;
+      char _pad1[64 - sizeof ( std::atomic < std::size_t > )];
+      std::atomic < std::size_t > _tail;
+      std::atomic < std::size_t > _highWaterMark;
+      char _pad2[64 - 2 * sizeof ( std::atomic < std::size_t > )];
+      std::atomic < bool > _closed;
+  };
+}
+
+#endif //REMO_SPSCQUEUE_H
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "StageStats.h"
+
+namespace remo
+{
+  StageStats::StageStats ( const std::string& name_ )
+    : _name ( name_ )
+  {
+    reset ( );
+  }
+
+  void StageStats::reset ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    std::fill ( _buckets, _buckets + NUM_BUCKETS, 0 );
+    _count = 0;
+    _totalNanos = 0;
+    _maxNanos = 0;
+    _rollingNanos = 0.0;
+    _skipped = 0;
+    _bytes = 0;
+  }
+
+  unsigned int StageStats::bucketOf ( uint64_t nanos_ )
+  {
+    if ( nanos_ < ( 1u << SUB_BUCKETS_BITS ))
+    {
+      return nanos_;
+    }
+
+    unsigned int msb_ = 63;
+    while (( nanos_ >> msb_ ) == 0 )
+    {
+      --msb_;
+    }
+    unsigned int sub_ = ( nanos_ >> ( msb_ - SUB_BUCKETS_BITS ))
+      & (( 1u << SUB_BUCKETS_BITS ) - 1 );
+    return (( msb_ - SUB_BUCKETS_BITS + 1 ) << SUB_BUCKETS_BITS ) + sub_;
+  }
+
+  double StageStats::bucketUpperBound ( unsigned int bucket_ )
+  {
+    if ( bucket_ < ( 1u << SUB_BUCKETS_BITS ))
+    {
+      return bucket_;
+    }
+
+    unsigned int msb_ = ( bucket_ >> SUB_BUCKETS_BITS ) + SUB_BUCKETS_BITS - 1;
+    unsigned int sub_ = bucket_ & (( 1u << SUB_BUCKETS_BITS ) - 1 );
+    return std::ldexp ( 1.0 + ( sub_ + 1.0 ) / ( 1u << SUB_BUCKETS_BITS ), msb_ );
+  }
+
+  void StageStats::record ( Clock::time_point start_,
+                            Clock::time_point end_,
+                            std::size_t bytes_ )
+  {
+    uint64_t nanos_ = std::chrono::duration_cast < std::chrono::nanoseconds > (
+      end_ - start_ ).count ( );
+
+    std::unique_lock < std::mutex > lock ( _mtx );
+    if ( _count == 0 )
+    {
+      _first = start_;
+    }
+    _last = end_;
+
+    ++_buckets[bucketOf ( nanos_ )];
+    ++_count;
+    //Plain average until the window fills.
+    _rollingNanos += ( nanos_ - _rollingNanos ) / std::min ( _count,
+                                                             ( unsigned long ) ROLLING_WINDOW );
+    _totalNanos += nanos_;
+    _maxNanos = std::max ( _maxNanos, nanos_ );
+    _bytes += bytes_;
+  }
+
+  void StageStats::record ( Clock::duration busy_, std::size_t bytes_ )
+  {
+    Clock::time_point end_ = Clock::now ( );
+    record ( end_ - busy_, end_, bytes_ );
+  }
+
+  void StageStats::recordSkip ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    ++_skipped;
+  }
+
+  unsigned long StageStats::getCount ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    return _count;
+  }
+
+  double StageStats::percentileLocked ( double percentile_ )
+  {
+    if ( _count == 0 )
+    {
+      return 0.0;
+    }
+
+    unsigned long rank_ = std::ceil ( percentile_ / 100.0 * _count );
+    rank_ = std::max ( 1ul, std::min ( rank_, _count ));
+
+    unsigned long seen_ = 0;
+    for ( unsigned int i = 0; i < NUM_BUCKETS; ++i )
+    {
+      seen_ += _buckets[i];
+      if ( seen_ >= rank_ )
+      {
+        return std::min ( bucketUpperBound ( i ), double ( _maxNanos )) / 1000.0;
+      }
+    }
+    return _maxNanos / 1000.0;
+  }
+
+  double StageStats::wallSecondsLocked ( void )
+  {
+    return _count == 0 ? 0.0
+      : std::chrono::duration < double > ( _last - _first ).count ( );
+  }
+
+  double StageStats::getPercentile ( double percentile_ )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    return percentileLocked ( percentile_ );
+  }
+
+  double StageStats::getMean ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    return _count == 0 ? 0.0 : _totalNanos / 1000.0 / _count;
+  }
+
+  double StageStats::getRollingMean ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    return _rollingNanos / 1000.0;
+  }
+
+  double StageStats::getMax ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    return _maxNanos / 1000.0;
+  }
+
+  double StageStats::getFps ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    double seconds_ = wallSecondsLocked ( );
+    return seconds_ > 0.0 ? _count / seconds_ : 0.0;
+  }
+
+  double StageStats::getBytesPerSecond ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    double seconds_ = wallSecondsLocked ( );
+    return seconds_ > 0.0 ? _bytes / seconds_ : 0.0;
+  }
+
+  unsigned long StageStats::getSkipped ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    return _skipped;
+  }
+
+  std::string StageStats::toJSON ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    double seconds_ = wallSecondsLocked ( );
+
+    std::ostringstream json_;
+    json_ << "{\"name\": \"" << _name << "\""
+          << ", \"count\": " << _count
+          << ", \"p50_us\": " << percentileLocked ( 50.0 )
+          << ", \"p95_us\": " << percentileLocked ( 95.0 )
+          << ", \"p99_us\": " << percentileLocked ( 99.0 )
+          << ", \"max_us\": " << _maxNanos / 1000.0
+          << ", \"mean_us\": " << ( _count == 0 ? 0.0 : _totalNanos / 1000.0 / _count )
+          << ", \"rolling_mean_us\": " << _rollingNanos / 1000.0
+          << ", \"skipped\": " << _skipped
+          << ", \"fps\": " << ( seconds_ > 0.0 ? _count / seconds_ : 0.0 )
+          << ", \"bytes\": " << _bytes
+          << ", \"bytes_per_second\": " << ( seconds_ > 0.0 ? _bytes / seconds_ : 0.0 )
+          << "}";
+    return json_.str ( );
+  }
+}
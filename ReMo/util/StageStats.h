@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_STAGESTATS_H
+#define REMO_STAGESTATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace remo
+{
+  //Latency histogram and throughput of one stage of a Flow. Latencies are
+  //kept in log-scale buckets (eight per power of two, 12.5% of
+  //resolution at worst), so recording is constant time and memory.
+  class StageStats
+  {
+    public:
+      typedef std::chrono::steady_clock Clock;
+
+      StageStats ( const std::string& name_ );
+
+      void record ( Clock::time_point start_,
+                    Clock::time_point end_,
+                    std::size_t bytes_ = 0 );
+      //Busy time ending now, for stages that also wait on queues.
+      void record ( Clock::duration busy_, std::size_t bytes_ = 0 );
+      //An item the stage let through without doing its work.
+      void recordSkip ( void );
+      void reset ( void );
+
+      const std::string& getName ( void ) { return _name; }
+      unsigned long getCount ( void );
+      //Latencies in microseconds.
+      double getPercentile ( double percentile_ );
+      double getMean ( void );
+      //Exponential average, the last ROLLING_WINDOW records weigh most.
+      double getRollingMean ( void );
+      double getMax ( void );
+      //Items per second and bytes per second over the recorded wall time.
+      double getFps ( void );
+      double getBytesPerSecond ( void );
+      unsigned long getSkipped ( void );
+
+      std::string toJSON ( void );
+
+    private:
+      static const unsigned int SUB_BUCKETS_BITS = 3;
+      static const unsigned int NUM_BUCKETS = 64 << SUB_BUCKETS_BITS;
+      static const unsigned int ROLLING_WINDOW = 16;
+
+      static unsigned int bucketOf ( uint64_t nanos_ );
+      static double bucketUpperBound ( unsigned int bucket_ );
+
+      double percentileLocked ( double percentile_ );
+      double wallSecondsLocked ( void );
+
+      std::string _name;
+
+      std::mutex _mtx;
+      uint64_t _buckets[NUM_BUCKETS];
+      unsigned long _count;
+      uint64_t _totalNanos;
+      uint64_t _maxNanos;
+      double _rollingNanos;
+      unsigned long _skipped;
+      uint64_t _bytes;
+      Clock::time_point _first;
+      Clock::time_point _last;
+  };
+
+  //Records the time from its construction to stop ( ) or its destruction.
+  class StageTimer
+  {
+    public:
+      StageTimer ( StageStats* stats_ )
+        : _stats ( stats_ )
+        , _bytes ( 0 )
+        , _start ( StageStats::Clock::now ( )) {}
+      ~StageTimer ( void ) { stop ( ); }
+
+      void setBytes ( std::size_t bytes_ ) { _bytes = bytes_; }
+      //Nothing is recorded, e.g. a read that had no data.
+      void cancel ( void ) { _stats = nullptr; }
+
+      void stop ( void )
+      {
+        if ( _stats != nullptr )
+        {
+          _stats->record ( _start, StageStats::Clock::now ( ), _bytes );
+          _stats = nullptr;
+        }
+      }
+
+    private:
+      StageStats* _stats;
+      std::size_t _bytes;
+      StageStats::Clock::time_point _start;
+  };
+}
+
+#endif //REMO_STAGESTATS_H
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <memory>
+
+#include "WorkerPool.h"
+
+namespace remo
+{
+  WorkerPool::WorkerPool ( unsigned int numThreads_ )
+    : _order ( 0 )
+    , _stop ( false )
+  {
+    if ( numThreads_ == 0 )
+    {
+      numThreads_ = std::max ( 1u, std::thread::hardware_concurrency ( ));
+    }
+
+    for ( unsigned int i = 0; i < numThreads_; ++i )
+    {
+      _threads.emplace_back ( &WorkerPool::run, this );
+    }
+  }
+
+  WorkerPool* WorkerPool::getShared ( void )
+  {
+    static WorkerPool shared_;
+    return &shared_;
+  }
+
+  WorkerPool::~WorkerPool ( void )
+  {
+    {
+      std::unique_lock < std::mutex > lock ( _mtx );
+      _stop = true;
+    }
+    _cv.notify_all ( );
+
+    for ( auto& thread_ : _threads )
+    {
+      thread_.join ( );
+    }
+  }
+
+  void WorkerPool::submit ( Task task_ )
+  {
+    submitAfter ( Clock::duration::zero ( ), std::move ( task_ ));
+  }
+
+  void WorkerPool::submitAfter ( Clock::duration delay_, Task task_ )
+  {
+    {
+      std::unique_lock < std::mutex > lock ( _mtx );
+      _tasks.push ( Entry { Clock::now ( ) + delay_, _order++, std::move ( task_ ) } );
+    }
+    _cv.notify_one ( );
+  }
+
+  void WorkerPool::parallelFor ( unsigned int count_, unsigned int chunk_,
+                                 const RangeTask& task_ )
+  {
+    if ( count_ == 0 )
+    {
+      return;
+    }
+    chunk_ = std::max ( 1u, chunk_ );
+    const unsigned int chunks_ = ( count_ + chunk_ - 1 ) / chunk_;
+
+    //Shared with the helpers, which may start after the loop is over.
+    struct Range
+    {
+      std::atomic < unsigned int > next;
+      std::atomic < unsigned int > done;
+      std::mutex mtx;
+      std::condition_variable cv;
+    };
+    auto range_ = std::make_shared < Range > ( );
+    range_->next = 0;
+    range_->done = 0;
+
+    const RangeTask* rangeTask_ = &task_;
+    Task work_ = [ range_, rangeTask_, count_, chunk_, chunks_ ] ( )
+    {
+      unsigned int i;
+      while (( i = range_->next.fetch_add ( 1 )) < chunks_ )
+      {
+        unsigned int begin_ = i * chunk_;
+        ( *rangeTask_ ) ( begin_, std::min ( count_, begin_ + chunk_ ));
+        if ( range_->done.fetch_add ( 1 ) + 1 == chunks_ )
+        {
+          std::unique_lock < std::mutex > lock ( range_->mtx );
+          range_->cv.notify_all ( );
+        }
+      }
+    };
+
+    unsigned int helpers_ = std::min < unsigned int > ( chunks_ - 1, _threads.size ( ));
+    for ( unsigned int i = 0; i < helpers_; ++i )
+    {
+      submit ( work_ );
+    }
+    work_ ( );
+
+    std::unique_lock < std::mutex > lock ( range_->mtx );
+    range_->cv.wait ( lock, [ &range_, chunks_ ] ( )
+    {
+      return range_->done.load ( ) == chunks_;
+    } );
+  }
+
+  void WorkerPool::run ( void )
+  {
+    std::unique_lock < std::mutex > lock ( _mtx );
+    while ( !_stop )
+    {
+      if ( _tasks.empty ( ))
+      {
+        _cv.wait ( lock );
+        continue;
+      }
+
+      Clock::time_point due_ = _tasks.top ( ).due;
+      if ( Clock::now ( ) < due_ )
+      {
+        _cv.wait_until ( lock, due_ );
+        continue;
+      }
+
+      Task task_ = std::move ( const_cast < Entry& > ( _tasks.top ( )).task );
+      _tasks.pop ( );
+
+      lock.unlock ( );
+      task_ ( );
+      lock.lock ( );
+    }
+  }
+}
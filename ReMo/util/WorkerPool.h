@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_WORKERPOOL_H
+#define REMO_WORKERPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace remo
+{
+  //Fixed set of threads shared by many short tasks. Tasks can be delayed,
+  //so idle work (a device without a new frame) is retried later without
+  //keeping a thread busy. Pending tasks are discarded on destruction, stop
+  //and join the work that uses the pool before destroying it.
+  class WorkerPool
+  {
+    public:
+      typedef std::chrono::steady_clock Clock;
+      typedef std::function < void ( void ) > Task;
+      //Half-open range [begin, end) of a parallelFor.
+      typedef std::function < void ( unsigned int, unsigned int ) > RangeTask;
+
+      //0 threads uses one per hardware thread.
+      WorkerPool ( unsigned int numThreads_ = 0 );
+      ~WorkerPool ( void );
+
+      WorkerPool ( const WorkerPool& ) = delete;
+      WorkerPool& operator= ( const WorkerPool& ) = delete;
+
+      void submit ( Task task_ );
+      void submitAfter ( Clock::duration delay_, Task task_ );
+
+      //Splits [0, count_) in chunks of chunk_ and runs them on the pool,
+      //returns when all are done. The calling thread takes chunks too, so
+      //it is safe from a task of the same pool.
+      void parallelFor ( unsigned int count_, unsigned int chunk_,
+                         const RangeTask& task_ );
+
+      unsigned int getNumThreads ( void ) { return _threads.size ( ); }
+
+      //Process wide pool, one thread per hardware thread, for the users
+      //that are not given one.
+      static WorkerPool* getShared ( void );
+
+    private:
+      struct Entry
+      {
+        Clock::time_point due;
+        unsigned long order;
+        Task task;
+      };
+
+      //Earliest first, FIFO among tasks due at the same time.
+      struct Later
+      {
+        bool operator( ) ( const Entry& a_, const Entry& b_ ) const
+        {
+          return ( a_.due != b_.due ) ? ( a_.due > b_.due )
+                                      : ( a_.order > b_.order );
+        }
+      };
+
+      void run ( void );
+
+      std::mutex _mtx;
+      std::condition_variable _cv;
+      std::priority_queue < Entry, std::vector < Entry >, Later > _tasks;
+      unsigned long _order;
+      bool _stop;
+
+      std::vector < std::thread > _threads;
+  };
+}
+
+#endif //REMO_WORKERPOOL_H
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "Benchmark.h"
+
+namespace
+{
+  std::atomic < unsigned long > allocationCount ( 0 );
+  std::atomic < unsigned long > allocatedBytes ( 0 );
+
+  void* countedAlloc ( std::size_t size_ )
+  {
+    allocationCount.fetch_add ( 1, std::memory_order_relaxed );
+    allocatedBytes.fetch_add ( size_, std::memory_order_relaxed );
+    void* ptr_ = std::malloc ( size_ ? size_ : 1 );
+    if ( !ptr_ )
+    {
+      throw std::bad_alloc ( );
+    }
+    return ptr_;
+  }
+}
+
+//Every C++ allocation of the process goes through here.
+void* operator new ( std::size_t size_ )
+{
+  return countedAlloc ( size_ );
+}
+
+void* operator new[] ( std::size_t size_ )
+{
+  return countedAlloc ( size_ );
+}
+
+void operator delete ( void* ptr_ ) noexcept
+{
+  std::free ( ptr_ );
+}
+
+void operator delete[] ( void* ptr_ ) noexcept
+{
+  std::free ( ptr_ );
+}
+
+void operator delete ( void* ptr_, std::size_t ) noexcept
+{
+  std::free ( ptr_ );
+}
+
+void operator delete[] ( void* ptr_, std::size_t ) noexcept
+{
+  std::free ( ptr_ );
+}
+
+namespace remo
+{
+  namespace bench
+  {
+    Benchmark::Benchmark ( const std::string& name_,
+                           double minTime_,
+                           unsigned int minIterations_ )
+      : _minTime ( minTime_ )
+      , _minIterations ( minIterations_ )
+      , _sink ( 0 )
+    {
+      _result = BenchmarkResult ( );
+      _result.name = name_;
+      _result.skipped = true;
+      _result.skipReason = "measure not called";
+    }
+
+    void Benchmark::measure ( const std::function < void ( void ) >& iteration_,
+                              unsigned int framesPerIteration_,
+                              unsigned int warmUp_ )
+    {
+      for ( unsigned int i = 0; i < warmUp_; ++i )
+      {
+        iteration_ ( );
+      }
+
+      unsigned long iterations_ = 0;
+      unsigned long allocs_ = getAllocationCount ( );
+      unsigned long bytes_ = getAllocatedBytes ( );
+      auto start_ = std::chrono::steady_clock::now ( );
+      double elapsed_ = 0.0;
+      while ( iterations_ < _minIterations || elapsed_ < _minTime )
+      {
+        iteration_ ( );
+        ++iterations_;
+        elapsed_ = std::chrono::duration < double > (
+          std::chrono::steady_clock::now ( ) - start_ ).count ( );
+      }
+      allocs_ = getAllocationCount ( ) - allocs_;
+      bytes_ = getAllocatedBytes ( ) - bytes_;
+
+      unsigned long frames_ = iterations_ * std::max ( framesPerIteration_, 1u );
+      _result.skipped = false;
+      _result.skipReason.clear ( );
+      _result.iterations = iterations_;
+      _result.frames = frames_;
+      _result.seconds = elapsed_;
+      _result.nsPerFrame = elapsed_ * 1e9 / frames_;
+      _result.fps = elapsed_ > 0.0 ? frames_ / elapsed_ : 0.0;
+      _result.cxxAllocsPerFrame = static_cast < double > ( allocs_ ) / frames_;
+      _result.cxxAllocBytesPerFrame = static_cast < double > ( bytes_ ) / frames_;
+      _result.rssKB = getRssKB ( );
+      _result.peakRssKB = getPeakRssKB ( );
+    }
+
+    void Benchmark::skip ( const std::string& reason_ )
+    {
+      _result.skipped = true;
+      _result.skipReason = reason_;
+    }
+
+    BenchmarkSuite::BenchmarkSuite ( void )
+      : _minTime ( 0.5 )
+      , _minIterations ( 3 )
+    {
+    }
+
+    void BenchmarkSuite::add ( const std::string& name_, Body body_ )
+    {
+      _benchmarks.emplace_back ( name_, body_ );
+    }
+
+    std::vector < std::string > BenchmarkSuite::list ( const std::string& filter_ )
+    {
+      std::vector < std::string > names_;
+      for ( auto& benchmark_: _benchmarks )
+      {
+        if ( benchmark_.first.find ( filter_ ) != std::string::npos )
+        {
+          names_.push_back ( benchmark_.first );
+        }
+      }
+      return names_;
+    }
+
+    std::vector < BenchmarkResult > BenchmarkSuite::run ( const std::string& filter_ )
+    {
+      std::vector < BenchmarkResult > results_;
+      for ( auto& benchmark_: _benchmarks )
+      {
+        if ( benchmark_.first.find ( filter_ ) == std::string::npos )
+        {
+          continue;
+        }
+
+        Benchmark context_ ( benchmark_.first, _minTime, _minIterations );
+        benchmark_.second ( context_ );
+        const BenchmarkResult& result_ = context_.getResult ( );
+
+        if ( result_.skipped )
+        {
+          std::cout << std::left << std::setw ( 48 ) << result_.name
+                    << " skipped: " << result_.skipReason << std::endl;
+        }
+        else
+        {
+          std::cout << std::left << std::setw ( 48 ) << result_.name
+                    << std::right << std::fixed << std::setprecision ( 1 )
+                    << std::setw ( 14 ) << result_.nsPerFrame << " ns/frame"
+                    << std::setw ( 14 ) << result_.fps << " fps"
+                    << std::setw ( 10 ) << result_.cxxAllocsPerFrame << " C++ allocs/frame"
+                    << std::endl;
+        }
+        results_.push_back ( result_ );
+      }
+      return results_;
+    }
+
+    std::string toJSON ( const std::vector < BenchmarkResult >& results_ )
+    {
+      std::ostringstream json_;
+      json_ << std::fixed << std::setprecision ( 3 );
+      json_ << "{\n  \"benchmarks\": [";
+      for ( unsigned int i = 0; i < results_.size ( ); ++i )
+      {
+        const BenchmarkResult& result_ = results_[i];
+        json_ << ( i ? ",\n" : "\n" ) << "    { \"name\": \"" << result_.name << "\"";
+        if ( result_.skipped )
+        {
+          json_ << ", \"skipped\": true, \"reason\": \"" << result_.skipReason << "\" }";
+          continue;
+        }
+        json_ << ", \"iterations\": " << result_.iterations
+              << ", \"frames\": " << result_.frames
+              << ", \"seconds\": " << result_.seconds
+              << ", \"ns_per_frame\": " << result_.nsPerFrame
+              << ", \"fps\": " << result_.fps
+              << ", \"cxx_allocs_per_frame\": " << result_.cxxAllocsPerFrame
+              << ", \"cxx_alloc_bytes_per_frame\": " << result_.cxxAllocBytesPerFrame
+              << ", \"rss_kb\": " << result_.rssKB
+              << ", \"peak_rss_kb\": " << result_.peakRssKB << " }";
+      }
+      json_ << "\n  ]\n}\n";
+      return json_.str ( );
+    }
+
+    bool writeJSON ( const std::string& file_,
+                     const std::vector < BenchmarkResult >& results_ )
+    {
+      std::ofstream out_ ( file_ );
+      if ( !out_ )
+      {
+        return false;
+      }
+      out_ << toJSON ( results_ );
+      return out_.good ( );
+    }
+
+    bool loadBaseline ( const std::string& file_,
+                        std::map < std::string, double >& nsPerFrame_ )
+    {
+      std::ifstream in_ ( file_ );
+      if ( !in_ )
+      {
+        return false;
+      }
+
+      //One benchmark per line, as written by toJSON.
+      const std::string nameKey_ = "\"name\": \"";
+      const std::string nsKey_ = "\"ns_per_frame\": ";
+      std::string line_;
+      while ( std::getline ( in_, line_ ))
+      {
+        std::size_t name_ = line_.find ( nameKey_ );
+        std::size_t ns_ = line_.find ( nsKey_ );
+        if ( name_ == std::string::npos || ns_ == std::string::npos )
+        {
+          continue;
+        }
+        name_ += nameKey_.size ( );
+        std::size_t nameEnd_ = line_.find ( '"', name_ );
+        nsPerFrame_[line_.substr ( name_, nameEnd_ - name_ )] =
+          std::strtod ( line_.c_str ( ) + ns_ + nsKey_.size ( ), nullptr );
+      }
+      return true;
+    }
+
+    std::vector < std::string >
+    findRegressions ( const std::vector < BenchmarkResult >& results_,
+                      const std::map < std::string, double >& baseline_,
+                      double tolerance_ )
+    {
+      std::vector < std::string > regressions_;
+      for ( auto& result_: results_ )
+      {
+        auto reference_ = baseline_.find ( result_.name );
+        if ( result_.skipped || reference_ == baseline_.end ( ) ||
+             reference_->second <= 0.0 )
+        {
+          continue;
+        }
+
+        double ratio_ = result_.nsPerFrame / reference_->second;
+        if ( ratio_ > 1.0 + tolerance_ )
+        {
+          std::ostringstream msg_;
+          msg_ << result_.name << ": " << std::fixed << std::setprecision ( 1 )
+               << result_.nsPerFrame << " ns/frame, baseline "
+               << reference_->second << " (+"
+               << ( ratio_ - 1.0 ) * 100.0 << "%)";
+          regressions_.push_back ( msg_.str ( ));
+        }
+      }
+      return regressions_;
+    }
+
+    unsigned long getAllocationCount ( void )
+    {
+      return allocationCount.load ( std::memory_order_relaxed );
+    }
+
+    unsigned long getAllocatedBytes ( void )
+    {
+      return allocatedBytes.load ( std::memory_order_relaxed );
+    }
+
+    long getRssKB ( void )
+    {
+      long pages_ = 0;
+      long resident_ = 0;
+      std::ifstream statm_ ( "/proc/self/statm" );
+      if ( !( statm_ >> pages_ >> resident_ ))
+      {
+        return 0;
+      }
+      return resident_ * ( sysconf ( _SC_PAGESIZE ) / 1024 );
+    }
+
+    long getPeakRssKB ( void )
+    {
+      struct rusage usage_;
+      if ( getrusage ( RUSAGE_SELF, &usage_ ) != 0 )
+      {
+        return 0;
+      }
+      return usage_.ru_maxrss;
+    }
+  }
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_BENCHMARK_H
+#define REMO_BENCHMARK_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace remo
+{
+  namespace bench
+  {
+    struct BenchmarkResult
+    {
+      std::string name;
+      bool skipped;
+      std::string skipReason;
+
+      unsigned long iterations;
+      unsigned long frames;
+      double seconds;
+      double nsPerFrame;
+      double fps;
+      //Calls to operator new only, av_malloc and malloc are not counted.
+      double cxxAllocsPerFrame;
+      double cxxAllocBytesPerFrame;
+      long rssKB;
+      long peakRssKB;
+    };
+
+    //Context handed to each benchmark body, which does its setup and then
+    //calls measure once with the work of one iteration.
+    class Benchmark
+    {
+      public:
+        Benchmark ( const std::string& name_,
+                    double minTime_,
+                    unsigned int minIterations_ );
+
+        //Runs warmUp_ untimed iterations, then iteration_ until both the
+        //minimum time and iterations are reached. Each iteration processes
+        //framesPerIteration_ frames.
+        void measure ( const std::function < void ( void ) >& iteration_,
+                       unsigned int framesPerIteration_ = 1,
+                       unsigned int warmUp_ = 2 );
+
+        //For benchmarks that can not run here (missing encoder, device...).
+        void skip ( const std::string& reason_ );
+
+        //Keeps the compiler from removing the benchmarked work.
+        void consume ( unsigned long value_ ) { _sink += value_; }
+
+        const BenchmarkResult& getResult ( void ) { return _result; }
+
+      private:
+        double _minTime;
+        unsigned int _minIterations;
+        volatile unsigned long _sink;
+        BenchmarkResult _result;
+    };
+
+    class BenchmarkSuite
+    {
+      public:
+        typedef std::function < void ( Benchmark& ) > Body;
+
+        BenchmarkSuite ( void );
+
+        //Names are "group/case", the group being micro or macro.
+        void add ( const std::string& name_, Body body_ );
+
+        void setMinTime ( double seconds_ ) { _minTime = seconds_; }
+        void setMinIterations ( unsigned int iterations_ ) { _minIterations = iterations_; }
+
+        //Benchmarks whose name contains filter_.
+        std::vector < std::string > list ( const std::string& filter_ = "" );
+        std::vector < BenchmarkResult > run ( const std::string& filter_ = "" );
+
+      private:
+        double _minTime;
+        unsigned int _minIterations;
+        std::vector < std::pair < std::string, Body > > _benchmarks;
+    };
+
+    std::string toJSON ( const std::vector < BenchmarkResult >& results_ );
+    bool writeJSON ( const std::string& file_,
+                     const std::vector < BenchmarkResult >& results_ );
+
+    //Reads ns_per_frame by name from a file written by writeJSON.
+    bool loadBaseline ( const std::string& file_,
+                        std::map < std::string, double >& nsPerFrame_ );
+    //Returns the benchmarks slower than the baseline by more than
+    //tolerance_ (0.25 is 25%).
+    std::vector < std::string >
+    findRegressions ( const std::vector < BenchmarkResult >& results_,
+                      const std::map < std::string, double >& baseline_,
+                      double tolerance_ );
+
+    unsigned long getAllocationCount ( void );
+    unsigned long getAllocatedBytes ( void );
+    long getRssKB ( void );
+    long getPeakRssKB ( void );
+  }
+}
+
+#endif //REMO_BENCHMARK_H
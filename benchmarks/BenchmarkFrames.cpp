@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <ReMo/util/Utils.h>
+
+#include "BenchmarkFrames.h"
+
+namespace remo
+{
+  namespace bench
+  {
+    FramePtr allocFrame ( AVPixelFormat format_, int width_, int height_ )
+    {
+      FramePtr frame_ ( av_frame_alloc ( ));
+      if ( !frame_ )
+      {
+        Utils::getInstance ( )->getErrorManager ( )
+                              ->criticalError ( "Unable to allocate a benchmark frame." );
+      }
+      frame_->format = format_;
+      frame_->width = width_;
+      frame_->height = height_;
+      if ( av_frame_get_buffer ( frame_.get ( ), 64 ) < 0 )
+      {
+        Utils::getInstance ( )->getErrorManager ( )
+                              ->criticalError ( "Unable to allocate a benchmark frame buffer." );
+      }
+      return frame_;
+    }
+
+    void fillPattern ( AVFrame* frame_, int t_ )
+    {
+      const AVPixFmtDescriptor* desc_ =
+        av_pix_fmt_desc_get ( static_cast < AVPixelFormat > ( frame_->format ));
+      int planes_ = av_pix_fmt_count_planes ( static_cast < AVPixelFormat > ( frame_->format ));
+      int lineSizes_[4] = { 0, 0, 0, 0 };
+      av_image_fill_linesizes ( lineSizes_,
+                                static_cast < AVPixelFormat > ( frame_->format ),
+                                frame_->width );
+
+      for ( int p = 0; p < planes_; ++p )
+      {
+        bool chroma_ = ( p == 1 || p == 2 ) && !( desc_->flags & AV_PIX_FMT_FLAG_RGB );
+        int rows_ = chroma_ ? AV_CEIL_RSHIFT ( frame_->height, desc_->log2_chroma_h )
+                            : frame_->height;
+        for ( int y = 0; y < rows_; ++y )
+        {
+          uint8_t* row_ = frame_->data[p] + y * frame_->linesize[p];
+          for ( int x = 0; x < lineSizes_[p]; ++x )
+          {
+            row_[x] = static_cast < uint8_t > (( x + y + t_ * 4 ) ^ ( p * 85 ));
+          }
+        }
+      }
+    }
+  }
+}
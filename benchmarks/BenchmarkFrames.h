@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef REMO_BENCHMARKFRAMES_H
+#define REMO_BENCHMARKFRAMES_H
+
+#include <memory>
+
+#include <ReMo/util/ffdefs.h>
+
+namespace remo
+{
+  namespace bench
+  {
+    struct FrameDeleter
+    {
+      void operator() ( AVFrame* frame_ ) { av_frame_free ( &frame_ ); }
+    };
+    typedef std::unique_ptr < AVFrame, FrameDeleter > FramePtr;
+
+    FramePtr allocFrame ( AVPixelFormat format_, int width_, int height_ );
+
+    //Deterministic gradient moved by t_, so consecutive frames differ as
+    //in a capture.
+    void fillPattern ( AVFrame* frame_, int t_ );
+  }
+}
+
+#endif //REMO_BENCHMARKFRAMES_H
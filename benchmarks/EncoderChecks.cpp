@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <ReMo/pipeline/Encoder.h>
+#include <ReMo/pipeline/FFPipeline.h>
+#include <ReMo/pipeline/FilterGraph.h>
+#include <ReMo/pipeline/Mask.h>
+#include <ReMo/pipeline/Muxer.h>
+#include <ReMo/stream/EncoderSettings.h>
+#include <ReMo/util/FramePool.h>
+#include <ReMo/util/FrameScaler.h>
+
+//Functional checks of the encoding and processing paths, run by CTest as
+//remo_checks.
+namespace
+{
+  //Counts the packets instead of writing them.
+  class PacketCounter: public remo::Muxer
+  {
+    public:
+      PacketCounter ( void ): _packets ( 0 ), _keyframes ( 0 ) {}
+
+      virtual int writePacket ( AVPacket* packet_ )
+      {
+        ++_packets;
+        if ( packet_->flags & AV_PKT_FLAG_KEY )
+        {
+          ++_keyframes;
+        }
+        return 0;
+      }
+      virtual int writeTrailer ( void ) { return 0; }
+
+      unsigned long _packets;
+      unsigned long _keyframes;
+  };
+
+  bool check ( bool condition_, const std::string& msg_ )
+  {
+    std::cout << ( condition_ ? "[ OK ] " : "[FAIL] " ) << msg_ << std::endl;
+    return condition_;
+  }
+
+  //Frames that match the output go through the BYPASS path as references
+  //of the decoded ones, which raw decoders mark as I. The GOP of the
+  //encoder settings must still apply.
+  bool checkBypassKeepsGop ( void )
+  {
+    const int width_ = 320;
+    const int height_ = 240;
+    const int numFrames_ = 48;
+    const int gopSize_ = 12;
+
+    remo::EncoderSettings settings_;
+    settings_.setCodec ( "mpeg4" );
+    settings_.setSize ( width_, height_ );
+    settings_.setFrameRate ( 25 );
+    settings_.setGopSize ( gopSize_ );
+    settings_.setMaxBFrames ( 2 );
+
+    AVCodec* codec_ = settings_.findEncoder ( );
+    if ( !codec_ )
+    {
+      return check ( false, "mpeg4 encoder available" );
+    }
+    AVCodecContext* codecCtx_ = avcodec_alloc_context3 ( codec_ );
+    AVDictionary* options_ = nullptr;
+    settings_.apply ( codecCtx_, &options_ );
+    int value = avcodec_open2 ( codecCtx_, codec_, &options_ );
+    av_dict_free ( &options_ );
+    if ( value < 0 )
+    {
+      avcodec_free_context ( &codecCtx_ );
+      return check ( false, "mpeg4 encoder opened" );
+    }
+
+    remo::FramePool framePool_;
+    remo::FrameScaler scaler_ ( framePool_ );
+    PacketCounter counter_;
+    remo::Encoder encoder_ ( codecCtx_, &counter_ );
+    encoder_.setOption ( "threaded", "0" );
+    encoder_.init ( );
+
+    for ( int i = 0; i < numFrames_; ++i )
+    {
+      AVFrame* decoded_ = framePool_.getFrame ( codecCtx_->pix_fmt, width_, height_ );
+      for ( int p = 0; p < 3; ++p )
+      {
+        int rows_ = p ? height_ / 2 : height_;
+        for ( int y = 0; y < rows_; ++y )
+        {
+          for ( int x = 0; x < decoded_->linesize[p]; ++x )
+          {
+            decoded_->data[p][y * decoded_->linesize[p] + x] =
+              static_cast < uint8_t > ( x + y + i * 4 );
+          }
+        }
+      }
+      decoded_->pict_type = AV_PICTURE_TYPE_I;
+      decoded_->key_frame = 1;
+
+      AVFrame* outFrame_ = scaler_.scale ( decoded_, codecCtx_->pix_fmt,
+                                           width_, height_ );
+      outFrame_->pts = i;
+      encoder_.setFrames ( outFrame_ );
+      encoder_.apply ( );
+      framePool_.releaseFrame ( outFrame_ );
+      framePool_.releaseFrame ( decoded_ );
+    }
+    encoder_.flush ( );
+    avcodec_free_context ( &codecCtx_ );
+
+    bool ok_ = check ( scaler_.getCount ( remo::FrameScaler::BYPASS ) == numFrames_,
+                       "frames take the BYPASS path" );
+    ok_ &= check ( counter_._packets == numFrames_, "every frame is encoded" );
+    ok_ &= check (( counter_._keyframes > 0 )
+                    && ( counter_._keyframes <= numFrames_ / gopSize_ + 1 ),
+                  "keyframes follow the GOP (" + std::to_string ( counter_._keyframes )
+                  + " of " + std::to_string ( counter_._packets ) + ")" );
+    return ok_;
+  }
+
+  //With the input format given, the pipeline builds the graph on init,
+  //before the first frame reaches the capture thread.
+  bool checkFilterGraphBuiltOnInit ( void )
+  {
+    remo::FramePool framePool_;
+    AVFrame* frame_ = framePool_.getFrame ( );
+
+    remo::FilterGraph filterGraph_ ( "hflip" );
+    filterGraph_.setInputFormat ( 64, 48, AV_PIX_FMT_YUV420P );
+
+    remo::FFPipeline pipeline_ ( frame_, nullptr, nullptr, nullptr );
+    pipeline_.addOperation ( &filterGraph_ );
+    pipeline_.init ( );
+
+    bool ok_ = check ( filterGraph_.isBuilt ( ), "filter graph built on pipeline init" );
+    framePool_.releaseFrame ( frame_ );
+    return ok_;
+  }
+
+  //Operations in a pipeline read their options when the pipeline is
+  //initialized, without calling their init ( ) apart.
+  bool checkPipelineReadsOptions ( void )
+  {
+    const int width_ = 64;
+    const int height_ = 48;
+
+    remo::FramePool framePool_;
+    AVFrame* frame_ = framePool_.getFrame ( AV_PIX_FMT_GRAY8, width_, height_ );
+    if ( !frame_ )
+    {
+      return check ( false, "gray frame allocated" );
+    }
+    for ( int y = 0; y < height_; ++y )
+    {
+      std::fill ( frame_->data[0] + y * frame_->linesize[0],
+                  frame_->data[0] + y * frame_->linesize[0] + width_, 100 );
+    }
+
+    remo::Mask mask_;
+    mask_.setOption ( "regions", "8:8:16:16" );
+    mask_.setOption ( "color", "ffffff" );
+
+    remo::FFPipeline pipeline_ ( frame_, nullptr, nullptr, nullptr );
+    pipeline_.addOperation ( &mask_ );
+    pipeline_.init ( );
+    pipeline_.process ( );
+
+    bool ok_ = check ( mask_.getRegions ( ).size ( ) == 1, "mask regions read on init" );
+    ok_ &= check ( frame_->data[0][12 * frame_->linesize[0] + 12] == 255,
+                   "region filled with the option color" );
+    ok_ &= check ( frame_->data[0][0] == 100, "pixels outside the region kept" );
+    framePool_.releaseFrame ( frame_ );
+    return ok_;
+  }
+}
+
+int main ( void )
+{
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+  av_register_all ( );
+  avcodec_register_all ( );
+#endif
+  av_log_set_level ( AV_LOG_ERROR );
+
+  bool ok_ = checkBypassKeepsGop ( );
+  ok_ &= checkPipelineReadsOptions ( );
+  ok_ &= checkFilterGraphBuiltOnInit ( );
+
+  return ok_ ? EXIT_SUCCESS : EXIT_FAILURE;
+}
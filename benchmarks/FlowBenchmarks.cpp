@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <cstdio>
+
+#include <ReMo/flow/FlowDeviceToVideoFile.h>
+#include <ReMo/media/MediaSynthetic.h>
+#include <ReMo/media/MediaVideoFile.h>
+
+#include "Benchmark.h"
+
+namespace remo
+{
+  namespace bench
+  {
+    namespace
+    {
+      //Frames recorded per run, each run opens and closes the whole flow.
+      const unsigned int flowFrames = 120;
+
+      struct FlowConfig
+      {
+        const char* name;
+        unsigned int width;
+        unsigned int height;
+        float motion;
+        float entropy;
+        const char* profile;
+        bool pipelined;
+      };
+
+      const FlowConfig flowConfigs[] =
+      {
+        { "synthetic_720p_to_video", 1280, 720, 0.5f, 0.0f,
+          "default", false },
+        { "synthetic_720p_to_video_pipelined", 1280, 720, 0.5f, 0.0f,
+          "default", true },
+        { "synthetic_1080p_noise_to_video_realtime", 1920, 1080, 0.5f, 0.5f,
+          "realtime-lowcpu", false },
+        { "synthetic_1080p_noise_to_video_realtime_pipelined", 1920, 1080, 0.5f, 0.5f,
+          "realtime-lowcpu", true },
+      };
+
+      void flowBenchmark ( Benchmark& bench_, const FlowConfig& config_ )
+      {
+        const std::string file_ = std::string ( "remo_bench_" ) + config_.name + ".mp4";
+
+        bench_.measure ( [ & ] ( )
+        {
+          MediaSynthetic inMedia_ ( config_.width, config_.height, 30 );
+          inMedia_.setMotion ( config_.motion );
+          inMedia_.setEntropy ( config_.entropy );
+          StreamDeviceIn inStream_ ( &inMedia_ );
+
+          MediaVideoFile outMedia_ ( file_ );
+          StreamVideoFileOut outStream_ ( &outMedia_,
+                                          EncoderSettings::fromProfile ( config_.profile ));
+
+          FlowDeviceToVideoFile flow_ ( &inStream_, &outStream_, false, flowFrames );
+          flow_.setPipelinedExecution ( config_.pipelined );
+          flow_.processStreams ( );
+        }, flowFrames, 0 );
+
+        std::remove ( file_.c_str ( ));
+      }
+    }
+
+    void registerFlowBenchmarks ( BenchmarkSuite& suite_ )
+    {
+      for ( const FlowConfig& config_: flowConfigs )
+      {
+        suite_.add ( std::string ( "macro/flow/" ) + config_.name,
+                     [ &config_ ] ( Benchmark& bench_ )
+                     {
+                       flowBenchmark ( bench_, config_ );
+                     } );
+      }
+    }
+  }
+}
@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <ReMo/pipeline/ColorAdjust.h>
+#include <ReMo/pipeline/FFPipeline.h>
+#include <ReMo/pipeline/FilterGraph.h>
+#include <ReMo/pipeline/Gauss.h>
+#include <ReMo/pipeline/ImageConverter.h>
+#include <ReMo/pipeline/Mask.h>
+#include <ReMo/stream/EncoderSettings.h>
+#include <ReMo/util/FramePool.h>
+#include <ReMo/util/FrameScaler.h>
+#include <ReMo/util/ParallelScaler.h>
+#include <ReMo/util/WorkerPool.h>
+
+#include "Benchmark.h"
+#include "BenchmarkFrames.h"
+
+namespace remo
+{
+  namespace bench
+  {
+    namespace
+    {
+      //Capture size of the desktop grabber and the usual web stream size.
+      const int srcWidth = 1920;
+      const int srcHeight = 1080;
+      const int dstWidth = 1280;
+      const int dstHeight = 720;
+
+      //numThreads_ 0 lets the converter use a thread per core.
+      template < class ImgSamplerType >
+      void converterBenchmark ( Benchmark& bench_,
+                                int width_ = srcWidth,
+                                int height_ = srcHeight,
+                                unsigned int numThreads_ = 0 )
+      {
+        FramePtr src_ = allocFrame ( AV_PIX_FMT_BGRA, width_, height_ );
+        fillPattern ( src_.get ( ), 0 );
+
+        //The samplers read packed rows.
+        if ( src_->linesize[0] != width_ * 4 )
+        {
+          bench_.skip ( "padded source rows" );
+          return;
+        }
+
+        ImageConverter converter_ ( dstWidth, dstHeight );
+        converter_.setImageSampler < ImgSamplerType > ( );
+        std::unique_ptr < WorkerPool > workers_;
+        if ( numThreads_ )
+        {
+          workers_.reset ( new WorkerPool ( numThreads_ ));
+          converter_.setWorkerPool ( workers_.get ( ));
+        }
+
+        bench_.measure ( [ & ] ( )
+        {
+          converter_.convert ( src_->data, width_, height_ );
+          bench_.consume ( converter_.getImage ( )[0] );
+        } );
+      }
+
+      template < class ImgSamplerType >
+      void samplerBenchmark ( Benchmark& bench_ )
+      {
+        FramePtr src_ = allocFrame ( AV_PIX_FMT_BGRA, srcWidth, srcHeight );
+        fillPattern ( src_.get ( ), 0 );
+
+        //The converter always samples packed rows.
+        std::uint8_t* data_[1] = { src_->data[0] };
+        ImgSamplerType sampler_;
+
+        bench_.measure ( [ & ] ( )
+        {
+          unsigned long sum_ = 0;
+          std::uint8_t r_, g_, b_;
+          for ( int i = 0; i < dstHeight; ++i )
+          {
+            int srcI_ = i * srcHeight / dstHeight;
+            for ( int j = 0; j < dstWidth; ++j )
+            {
+              sampler_.samplePixels ( data_, srcWidth, srcHeight,
+                                      srcI_, j * srcWidth / dstWidth,
+                                      r_, g_, b_ );
+              sum_ += r_ + g_ + b_;
+            }
+          }
+          bench_.consume ( sum_ );
+        } );
+      }
+
+      template < class ImgSamplerType >
+      void rowSamplerBenchmark ( Benchmark& bench_ )
+      {
+        FramePtr src_ = allocFrame ( AV_PIX_FMT_BGRA, srcWidth, srcHeight );
+        fillPattern ( src_.get ( ), 0 );
+
+        std::uint8_t* data_[1] = { src_->data[0] };
+        std::vector < int > columns_ ( dstWidth );
+        for ( int j = 0; j < dstWidth; ++j )
+        {
+          columns_[j] = j * srcWidth / dstWidth;
+        }
+        std::vector < std::uint8_t > dst_ ( dstWidth * dstHeight * 3 );
+        ImgSamplerType sampler_;
+
+        bench_.measure ( [ & ] ( )
+        {
+          for ( int i = 0; i < dstHeight; ++i )
+          {
+            sampler_.sampleRow ( data_, srcWidth, srcHeight, i * srcHeight / dstHeight,
+                                 columns_.data ( ), dstWidth,
+                                 dst_.data ( ) + i * dstWidth * 3 );
+          }
+          bench_.consume ( dst_[0] );
+        } );
+      }
+
+      void frameConverterBenchmark ( Benchmark& bench_,
+                                     SAMPLING_POLICY policy_,
+                                     AVPixelFormat format_ )
+      {
+        FramePtr src_ = allocFrame ( format_, srcWidth, srcHeight );
+        fillPattern ( src_.get ( ), 0 );
+
+        ImageConverter converter_ ( dstWidth, dstHeight );
+        converter_.setSamplingPolicy ( policy_ );
+        if ( !converter_.convert ( src_.get ( )))
+        {
+          bench_.skip ( "format not supported" );
+          return;
+        }
+
+        bench_.measure ( [ & ] ( )
+        {
+          converter_.convert ( src_.get ( ));
+          bench_.consume ( converter_.getImage ( )[0] );
+        } );
+      }
+
+      struct SwsConfig
+      {
+        const char* name;
+        AVPixelFormat srcFormat;
+        int srcWidth;
+        int srcHeight;
+        AVPixelFormat dstFormat;
+        int dstWidth;
+        int dstHeight;
+        int flags;
+      };
+
+      const SwsConfig swsConfigs[] =
+      {
+        { "bgra_1080p_to_yuv420p_720p_bicubic", AV_PIX_FMT_BGRA, 1920, 1080,
+          AV_PIX_FMT_YUV420P, 1280, 720, SWS_BICUBIC },
+        { "bgra_1080p_to_yuv420p_720p_bilinear", AV_PIX_FMT_BGRA, 1920, 1080,
+          AV_PIX_FMT_YUV420P, 1280, 720, SWS_BILINEAR },
+        { "bgra_1080p_to_yuv420p_720p_fast_bilinear", AV_PIX_FMT_BGRA, 1920, 1080,
+          AV_PIX_FMT_YUV420P, 1280, 720, SWS_FAST_BILINEAR },
+        { "bgra_1080p_to_yuv420p_720p_point", AV_PIX_FMT_BGRA, 1920, 1080,
+          AV_PIX_FMT_YUV420P, 1280, 720, SWS_POINT },
+        { "bgra_1080p_to_yuv420p_1080p", AV_PIX_FMT_BGRA, 1920, 1080,
+          AV_PIX_FMT_YUV420P, 1920, 1080, SWS_POINT },
+        { "bgra_1080p_to_rgb24_720p_bilinear", AV_PIX_FMT_BGRA, 1920, 1080,
+          AV_PIX_FMT_RGB24, 1280, 720, SWS_BILINEAR },
+        { "yuv420p_720p_to_rgb24_720p", AV_PIX_FMT_YUV420P, 1280, 720,
+          AV_PIX_FMT_RGB24, 1280, 720, SWS_POINT },
+      };
+
+      void swsBenchmark ( Benchmark& bench_, const SwsConfig& config_ )
+      {
+        FramePtr src_ = allocFrame ( config_.srcFormat,
+                                     config_.srcWidth, config_.srcHeight );
+        FramePtr dst_ = allocFrame ( config_.dstFormat,
+                                     config_.dstWidth, config_.dstHeight );
+        fillPattern ( src_.get ( ), 0 );
+
+        SwsContext* swsCtx_ = sws_getContext ( config_.srcWidth, config_.srcHeight,
+                                               config_.srcFormat,
+                                               config_.dstWidth, config_.dstHeight,
+                                               config_.dstFormat,
+                                               config_.flags,
+                                               nullptr, nullptr, nullptr );
+        if ( !swsCtx_ )
+        {
+          bench_.skip ( "unsupported conversion" );
+          return;
+        }
+
+        bench_.measure ( [ & ] ( )
+        {
+          bench_.consume ( sws_scale ( swsCtx_, src_->data, src_->linesize, 0,
+                                       config_.srcHeight,
+                                       dst_->data, dst_->linesize ));
+        } );
+        sws_freeContext ( swsCtx_ );
+      }
+
+      //4K capture, the case where a single sws_scale is too slow.
+      const SwsConfig sliceConfigs[] =
+      {
+        { "bgra_2160p_to_yuv420p_1080p_bicubic", AV_PIX_FMT_BGRA, 3840, 2160,
+          AV_PIX_FMT_YUV420P, 1920, 1080, SWS_BICUBIC },
+        { "bgra_2160p_to_yuv420p_2160p", AV_PIX_FMT_BGRA, 3840, 2160,
+          AV_PIX_FMT_YUV420P, 3840, 2160, SWS_POINT },
+      };
+
+      void parallelScalerBenchmark ( Benchmark& bench_,
+                                     const SwsConfig& config_,
+                                     unsigned int maxSlices_ )
+      {
+        FramePtr src_ = allocFrame ( config_.srcFormat,
+                                     config_.srcWidth, config_.srcHeight );
+        FramePtr dst_ = allocFrame ( config_.dstFormat,
+                                     config_.dstWidth, config_.dstHeight );
+        fillPattern ( src_.get ( ), 0 );
+
+        ParallelScaler scaler_;
+        scaler_.setMaxSlices ( maxSlices_ );
+        if ( !scaler_.scale ( src_.get ( ), dst_.get ( ), config_.flags ))
+        {
+          bench_.skip ( "unsupported conversion" );
+          return;
+        }
+
+        bench_.measure ( [ & ] ( )
+        {
+          scaler_.scale ( src_.get ( ), dst_.get ( ), config_.flags );
+          bench_.consume ( dst_->data[0][0] );
+        } );
+      }
+
+      //Out of place, as a pipeline runs it, the source is left as it is.
+      void gaussBenchmark ( Benchmark& bench_,
+                            AVPixelFormat format_,
+                            float sigma_,
+                            bool outOfPlace_ = false )
+      {
+        FramePtr frame_ = allocFrame ( format_, srcWidth, srcHeight );
+        FramePtr dst_ = allocFrame ( format_, srcWidth, srcHeight );
+        fillPattern ( frame_.get ( ), 0 );
+        AVFrame* out_ = outOfPlace_ ? dst_.get ( ) : frame_.get ( );
+
+        Gauss gauss_ ( sigma_ );
+        if ( !gauss_.blur ( frame_.get ( ), out_ ))
+        {
+          bench_.skip ( "unsupported format" );
+          return;
+        }
+
+        bench_.measure ( [ & ] ( )
+        {
+          gauss_.blur ( frame_.get ( ), out_ );
+          bench_.consume ( out_->data[0][0] );
+        } );
+      }
+
+      //Colour adjustment, a privacy mask and a second adjustment, as
+      //separate passes or fused in one.
+      void pointOpsBenchmark ( Benchmark& bench_,
+                               AVPixelFormat format_,
+                               int width_,
+                               int height_,
+                               bool fusion_ )
+      {
+        FramePtr frame_ = allocFrame ( format_, width_, height_ );
+        fillPattern ( frame_.get ( ), 0 );
+
+        ColorAdjust adjust_ ( 0.05f, 1.1f, 0.9f );
+        Mask mask_;
+        mask_.addRegion ( width_ / 8, height_ / 8, width_ / 4, height_ / 4 );
+        ColorAdjust gamma_ ( 0.0f, 1.0f, 1.2f );
+
+        FFPipeline pipeline_ ( frame_.get ( ), nullptr, nullptr, nullptr );
+        pipeline_.setFusion ( fusion_ );
+        pipeline_.addOperation ( &adjust_ );
+        pipeline_.addOperation ( &mask_ );
+        pipeline_.addOperation ( &gamma_ );
+        pipeline_.init ( );
+
+        bench_.measure ( [ & ] ( )
+        {
+          pipeline_.process ( );
+          bench_.consume ( frame_->data[0][0] );
+        } );
+      }
+
+      void filterGraphBenchmark ( Benchmark& bench_, const std::string& graph_ )
+      {
+        FramePtr src_ = allocFrame ( AV_PIX_FMT_YUV420P, srcWidth, srcHeight );
+        FramePtr frame_ = allocFrame ( AV_PIX_FMT_YUV420P, srcWidth, srcHeight );
+        fillPattern ( src_.get ( ), 0 );
+
+        FilterGraph filterGraph_ ( graph_ );
+        int64_t pts_ = 0;
+        auto filter_ = [ & ] ( )
+        {
+          av_frame_unref ( frame_.get ( ));
+          av_frame_ref ( frame_.get ( ), src_.get ( ));
+          frame_->pts = pts_++;
+          return filterGraph_.filter ( frame_.get ( ));
+        };
+        if ( !filter_ ( ))
+        {
+          bench_.skip ( "unable to build the graph" );
+          return;
+        }
+
+        bench_.measure ( [ & ] ( )
+        {
+          filter_ ( );
+          bench_.consume ( frame_->data[0][0] );
+        } );
+      }
+
+      void frameScalerBenchmark ( Benchmark& bench_,
+                                  AVPixelFormat format_,
+                                  int width_,
+                                  int height_ )
+      {
+        FramePtr src_ = allocFrame ( AV_PIX_FMT_YUV420P, srcWidth, srcHeight );
+        fillPattern ( src_.get ( ), 0 );
+
+        FramePool pool_;
+        FrameScaler scaler_ ( pool_ );
+
+        bench_.measure ( [ & ] ( )
+        {
+          AVFrame* out_ = scaler_.scale ( src_.get ( ), format_, width_, height_ );
+          bench_.consume ( out_->data[0][0] );
+          pool_.releaseFrame ( out_ );
+        } );
+      }
+
+      //Frames handed to the encoder per iteration, enough to keep the
+      //lookahead of x264/x265 full. The size keeps the slow profiles short.
+      const unsigned int encodedFrames = 30;
+      const int encodedWidth = 640;
+      const int encodedHeight = 360;
+
+      void encoderBenchmark ( Benchmark& bench_, const std::string& profile_ )
+      {
+        EncoderSettings settings_ = EncoderSettings::fromProfile ( profile_ );
+        settings_.setSize ( encodedWidth, encodedHeight );
+
+        AVCodec* codec_ = settings_.findEncoder ( );
+        if ( !codec_ )
+        {
+          bench_.skip ( "no encoder for " + settings_.getCodec ( ));
+          return;
+        }
+
+        AVCodecContext* codecCtx_ = avcodec_alloc_context3 ( codec_ );
+        AVDictionary* options_ = nullptr;
+        settings_.apply ( codecCtx_, &options_ );
+        int value_ = avcodec_open2 ( codecCtx_, codec_, &options_ );
+        av_dict_free ( &options_ );
+        if ( value_ < 0 )
+        {
+          avcodec_free_context ( &codecCtx_ );
+          bench_.skip ( "unable to open " + std::string ( codec_->name ));
+          return;
+        }
+
+        FramePtr frame_ = allocFrame ( codecCtx_->pix_fmt, encodedWidth, encodedHeight );
+        AVPacket* packet_ = av_packet_alloc ( );
+        int64_t pts_ = 0;
+
+        auto receive_ = [ & ] ( )
+        {
+          while ( avcodec_receive_packet ( codecCtx_, packet_ ) == 0 )
+          {
+            bench_.consume ( packet_->size );
+            av_packet_unref ( packet_ );
+          }
+        };
+
+        bench_.measure ( [ & ] ( )
+        {
+          for ( unsigned int i = 0; i < encodedFrames; ++i )
+          {
+            av_frame_make_writable ( frame_.get ( ));
+            fillPattern ( frame_.get ( ), static_cast < int > ( pts_ ));
+            frame_->pts = pts_++;
+            avcodec_send_frame ( codecCtx_, frame_.get ( ));
+            receive_ ( );
+          }
+        }, encodedFrames, 1 );
+
+        avcodec_send_frame ( codecCtx_, nullptr );
+        receive_ ( );
+        av_packet_free ( &packet_ );
+        avcodec_free_context ( &codecCtx_ );
+      }
+    }
+
+    void registerMicroBenchmarks ( BenchmarkSuite& suite_ )
+    {
+      suite_.add ( "micro/converter/near_1080p_to_720p", [ ] ( Benchmark& bench_ )
+      {
+        converterBenchmark < NearImageSampler > ( bench_ );
+      } );
+      suite_.add ( "micro/converter/linear_1080p_to_720p", [ ] ( Benchmark& bench_ )
+      {
+        converterBenchmark < LinearImageSampler > ( bench_ );
+      } );
+      suite_.add ( "micro/converter/simd_near_1080p_to_720p", [ ] ( Benchmark& bench_ )
+      {
+        converterBenchmark < SimdNearImageSampler > ( bench_ );
+      } );
+      suite_.add ( "micro/converter/simd_near_2160p_to_720p_1thread",
+                   [ ] ( Benchmark& bench_ )
+      {
+        converterBenchmark < SimdNearImageSampler > ( bench_, 3840, 2160, 1 );
+      } );
+      suite_.add ( "micro/converter/simd_near_2160p_to_720p", [ ] ( Benchmark& bench_ )
+      {
+        converterBenchmark < SimdNearImageSampler > ( bench_, 3840, 2160 );
+      } );
+
+      const std::pair < const char*, SAMPLING_POLICY > policies_[] =
+      {
+        { "nearest", SAMPLING_NEAREST },
+        { "box", SAMPLING_BOX },
+        { "bilinear", SAMPLING_BILINEAR },
+      };
+      const AVPixelFormat formats_[] =
+      {
+        AV_PIX_FMT_BGRA, AV_PIX_FMT_RGB24, AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12
+      };
+      for ( auto& policy_: policies_ )
+      {
+        for ( AVPixelFormat format_: formats_ )
+        {
+          SAMPLING_POLICY samplingPolicy_ = policy_.second;
+          suite_.add ( std::string ( "micro/frame_converter/" ) + policy_.first + "_" +
+                       av_get_pix_fmt_name ( format_ ) + "_1080p_to_720p",
+                       [ samplingPolicy_, format_ ] ( Benchmark& bench_ )
+                       {
+                         frameConverterBenchmark ( bench_, samplingPolicy_, format_ );
+                       } );
+        }
+      }
+
+      suite_.add ( "micro/sampler/near", samplerBenchmark < NearImageSampler > );
+      suite_.add ( "micro/sampler/linear", samplerBenchmark < LinearImageSampler > );
+      suite_.add ( "micro/sampler/near_rows", rowSamplerBenchmark < NearImageSampler > );
+      suite_.add ( "micro/sampler/simd_near_rows",
+                   rowSamplerBenchmark < SimdNearImageSampler > );
+
+      for ( const SwsConfig& config_: swsConfigs )
+      {
+        suite_.add ( std::string ( "micro/sws/" ) + config_.name,
+                     [ &config_ ] ( Benchmark& bench_ )
+                     {
+                       swsBenchmark ( bench_, config_ );
+                     } );
+      }
+
+      for ( const SwsConfig& config_: sliceConfigs )
+      {
+        suite_.add ( std::string ( "micro/parallel_scaler/" ) + config_.name + "_1slice",
+                     [ &config_ ] ( Benchmark& bench_ )
+                     {
+                       parallelScalerBenchmark ( bench_, config_, 1 );
+                     } );
+        suite_.add ( std::string ( "micro/parallel_scaler/" ) + config_.name,
+                     [ &config_ ] ( Benchmark& bench_ )
+                     {
+                       parallelScalerBenchmark ( bench_, config_, 0 );
+                     } );
+      }
+
+      suite_.add ( "micro/gauss/yuv420p_1080p_sigma1.5", [ ] ( Benchmark& bench_ )
+      {
+        gaussBenchmark ( bench_, AV_PIX_FMT_YUV420P, 1.5f );
+      } );
+      suite_.add ( "micro/gauss/yuv420p_1080p_sigma1.5_out_of_place", [ ] ( Benchmark& bench_ )
+      {
+        gaussBenchmark ( bench_, AV_PIX_FMT_YUV420P, 1.5f, true );
+      } );
+      suite_.add ( "micro/gauss/yuv420p_1080p_sigma4", [ ] ( Benchmark& bench_ )
+      {
+        gaussBenchmark ( bench_, AV_PIX_FMT_YUV420P, 4.0f );
+      } );
+      suite_.add ( "micro/gauss/bgra_1080p_sigma1.5", [ ] ( Benchmark& bench_ )
+      {
+        gaussBenchmark ( bench_, AV_PIX_FMT_BGRA, 1.5f );
+      } );
+
+      for ( bool fusion_: { false, true } )
+      {
+        std::string mode_ = fusion_ ? "fused" : "separate";
+        suite_.add ( "micro/point_ops/yuv420p_2160p_" + mode_, [ fusion_ ] ( Benchmark& bench_ )
+        {
+          pointOpsBenchmark ( bench_, AV_PIX_FMT_YUV420P, 3840, 2160, fusion_ );
+        } );
+        suite_.add ( "micro/point_ops/bgra_2160p_" + mode_, [ fusion_ ] ( Benchmark& bench_ )
+        {
+          pointOpsBenchmark ( bench_, AV_PIX_FMT_BGRA, 3840, 2160, fusion_ );
+        } );
+      }
+
+      for ( const char* graph_: { "crop=1280:720:320:180", "scale=1280:720",
+                                  "hqdn3d", "unsharp" } )
+      {
+        std::string name_ ( graph_ );
+        suite_.add ( "micro/filter_graph/" + name_.substr ( 0, name_.find ( '=' )),
+                     [ name_ ] ( Benchmark& bench_ )
+                     {
+                       filterGraphBenchmark ( bench_, name_ );
+                     } );
+      }
+
+      suite_.add ( "micro/frame_scaler/bypass", [ ] ( Benchmark& bench_ )
+      {
+        frameScalerBenchmark ( bench_, AV_PIX_FMT_YUV420P, srcWidth, srcHeight );
+      } );
+      suite_.add ( "micro/frame_scaler/convert", [ ] ( Benchmark& bench_ )
+      {
+        frameScalerBenchmark ( bench_, AV_PIX_FMT_BGRA, srcWidth, srcHeight );
+      } );
+      suite_.add ( "micro/frame_scaler/resample", [ ] ( Benchmark& bench_ )
+      {
+        frameScalerBenchmark ( bench_, AV_PIX_FMT_YUV420P, dstWidth, dstHeight );
+      } );
+
+      for ( const char* profile_: { "default", "realtime-lowcpu", "archive-quality" } )
+      {
+        std::string name_ ( profile_ );
+        suite_.add ( "micro/encoder/" + name_, [ name_ ] ( Benchmark& bench_ )
+        {
+          encoderBenchmark ( bench_, name_ );
+        } );
+      }
+    }
+  }
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <atomic>
+#include <thread>
+
+#include <ReMo/util/net/Connection.h>
+#include <ReMo/util/net/PacketHandler.h>
+#include <ReMo/util/net/ThreadPool.h>
+
+#include "Benchmark.h"
+
+namespace remo
+{
+  namespace bench
+  {
+    namespace
+    {
+      const char benchOpcode = 1;
+      const std::string benchPayload ( 48, 'x' );
+
+      class BenchSendablePacket: public SendablePacket
+      {
+        public:
+          BenchSendablePacket ( ByteBuffer* buf_, int id_ )
+            : _id ( id_ )
+          {
+            setBuffer ( buf_ );
+          }
+
+          char getOpcode ( ) { return benchOpcode; }
+
+          void writeImpl ( )
+          {
+            writeInt ( _id );
+            writeDouble ( _id * 0.5 );
+            writeString ( benchPayload );
+          }
+
+        private:
+          int _id;
+      };
+
+      class BenchReceivablePacket: public ReceivablePacket
+      {
+        public:
+          char getOpcode ( ) { return benchOpcode; }
+
+          void readImpl ( )
+          {
+            _id = readInt ( );
+            _value = readDouble ( );
+            _payload = readString ( );
+          }
+
+          void executePacketAction ( ) { }
+
+        private:
+          int _id;
+          double _value;
+          std::string _payload;
+      };
+
+      //Packets are parsed from memory, the socket is never opened.
+      class BenchConnection: public Connection
+      {
+        public:
+          BenchConnection ( void ) { }
+      };
+
+      class CounterTask: public Runnable
+      {
+        public:
+          CounterTask ( std::atomic < unsigned int >& counter_ )
+            : _counter ( counter_ )
+          {
+          }
+
+          void run ( ) { _counter.fetch_add ( 1 ); }
+
+        private:
+          std::atomic < unsigned int >& _counter;
+      };
+
+      const unsigned int packetsPerBuffer = 256;
+      const unsigned int tasksPerBatch = 128;
+
+      void byteBufferBenchmark ( Benchmark& bench_ )
+      {
+        ByteBuffer buffer_ ( 1024 );
+
+        bench_.measure ( [ & ] ( )
+        {
+          for ( unsigned int i = 0; i < packetsPerBuffer; ++i )
+          {
+            buffer_.reset ( );
+            buffer_.writeInt ( i );
+            buffer_.writeLong ( i * 3 );
+            buffer_.writeFloat ( i * 0.25f );
+            buffer_.writeDouble ( i * 0.5 );
+            buffer_.writeString ( benchPayload );
+
+            bench_.consume ( buffer_.readInt ( ));
+            bench_.consume ( buffer_.readLong ( ));
+            bench_.consume ( buffer_.readFloat ( ));
+            bench_.consume ( buffer_.readDouble ( ));
+            bench_.consume ( buffer_.readString ( ).size ( ));
+          }
+        }, packetsPerBuffer );
+      }
+
+      void packetHandlerBenchmark ( Benchmark& bench_ )
+      {
+        ByteBuffer buffer_ ( 64 * 1024 );
+        for ( unsigned int i = 0; i < packetsPerBuffer; ++i )
+        {
+          BenchSendablePacket packet_ ( &buffer_, i );
+          packet_.writePacket ( );
+        }
+
+        PacketHandler handler_;
+        handler_.registerPacketFactory < BenchReceivablePacket > ( );
+        BenchConnection connection_;
+
+        bench_.measure ( [ & ] ( )
+        {
+          buffer_.rewind ( );
+          while ( ReceivablePacketPtr packet_ =
+                    handler_.handlePacket ( buffer_, connection_ ))
+          {
+            packet_->run ( );
+          }
+        }, packetsPerBuffer );
+      }
+
+      void threadPoolBenchmark ( Benchmark& bench_ )
+      {
+        //The workers are detached and keep waiting on the pool after
+        //shutDown, so it is never destroyed.
+        static ThreadPool < CounterTask >* pool_ =
+          new ThreadPool < CounterTask > ( 4, 8, 60000, 2 * tasksPerBatch );
+        std::atomic < unsigned int > counter_ ( 0 );
+
+        bench_.measure ( [ & ] ( )
+        {
+          counter_ = 0;
+          for ( unsigned int i = 0; i < tasksPerBatch; ++i )
+          {
+            pool_->executeTask ( std::unique_ptr < CounterTask > (
+              new CounterTask ( counter_ )));
+          }
+          while ( counter_.load ( ) < tasksPerBatch )
+          {
+            std::this_thread::yield ( );
+          }
+        }, tasksPerBatch );
+      }
+    }
+
+    void registerNetBenchmarks ( BenchmarkSuite& suite_ )
+    {
+      suite_.add ( "micro/net/byte_buffer_roundtrip", byteBufferBenchmark );
+      suite_.add ( "micro/net/packet_handler", packetHandlerBenchmark );
+      suite_.add ( "micro/net/thread_pool_execute", threadPoolBenchmark );
+    }
+  }
+}
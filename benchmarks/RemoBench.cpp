@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include <ReMo/util/ffdefs.h>
+
+#include "Benchmark.h"
+
+namespace remo
+{
+  namespace bench
+  {
+    void registerMicroBenchmarks ( BenchmarkSuite& suite_ );
+    void registerFlowBenchmarks ( BenchmarkSuite& suite_ );
+#ifdef REMO_USE_POCO
+    void registerNetBenchmarks ( BenchmarkSuite& suite_ );
+#endif
+  }
+}
+
+namespace
+{
+  //Exit code of a run without baseline to compare against, reported by
+  //CTest as skipped.
+  const int EXIT_NO_BASELINE = 77;
+
+  void usage ( const char* program_ )
+  {
+    std::cout << "Usage: " << program_ << " [options]\n"
+              << "  --filter <text>      run the benchmarks whose name contains text\n"
+              << "  --list               print the benchmark names and exit\n"
+              << "  --json <file>        write the results as JSON\n"
+              << "  --baseline <file>    fail when slower than a previous JSON report,\n"
+              << "                       exit with " << EXIT_NO_BASELINE
+              << " when the file does not exist\n"
+              << "  --tolerance <ratio>  allowed slowdown over the baseline (0.25)\n"
+              << "  --min-time <s>       minimum measured time per benchmark (0.5)\n"
+              << "  --min-iterations <n> minimum measured iterations (3)\n";
+  }
+}
+
+int main ( int argc, char** argv )
+{
+  std::string filter_;
+  std::string jsonFile_;
+  std::string baselineFile_;
+  double tolerance_ = 0.25;
+  bool list_ = false;
+
+  remo::bench::BenchmarkSuite suite_;
+
+  for ( int i = 1; i < argc; ++i )
+  {
+    std::string arg_ ( argv[i] );
+    bool hasValue_ = i + 1 < argc;
+    if ( arg_ == "--filter" && hasValue_ )
+    {
+      filter_ = argv[++i];
+    }
+    else if ( arg_ == "--list" )
+    {
+      list_ = true;
+    }
+    else if ( arg_ == "--json" && hasValue_ )
+    {
+      jsonFile_ = argv[++i];
+    }
+    else if ( arg_ == "--baseline" && hasValue_ )
+    {
+      baselineFile_ = argv[++i];
+    }
+    else if ( arg_ == "--tolerance" && hasValue_ )
+    {
+      tolerance_ = std::atof ( argv[++i] );
+    }
+    else if ( arg_ == "--min-time" && hasValue_ )
+    {
+      suite_.setMinTime ( std::atof ( argv[++i] ));
+    }
+    else if ( arg_ == "--min-iterations" && hasValue_ )
+    {
+      suite_.setMinIterations ( std::atoi ( argv[++i] ));
+    }
+    else
+    {
+      usage ( argv[0] );
+      return arg_ == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+  av_register_all ( );
+  avcodec_register_all ( );
+#endif
+  avdevice_register_all ( );
+  av_log_set_level ( AV_LOG_ERROR );
+
+  remo::bench::registerMicroBenchmarks ( suite_ );
+#ifdef REMO_USE_POCO
+  remo::bench::registerNetBenchmarks ( suite_ );
+#endif
+  remo::bench::registerFlowBenchmarks ( suite_ );
+
+  if ( list_ )
+  {
+    for ( auto& name_: suite_.list ( filter_ ))
+    {
+      std::cout << name_ << std::endl;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  //The benchmarks still run and write their report without baseline.
+  std::map < std::string, double > baseline_;
+  bool missingBaseline_ = !baselineFile_.empty ( ) &&
+                          !std::ifstream ( baselineFile_ ).good ( );
+  if ( missingBaseline_ )
+  {
+    std::cerr << "No baseline at " << baselineFile_
+              << ", the results are not compared" << std::endl;
+  }
+  else if ( !baselineFile_.empty ( ) &&
+            !remo::bench::loadBaseline ( baselineFile_, baseline_ ))
+  {
+    std::cerr << "Unable to read the baseline " << baselineFile_ << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto results_ = suite_.run ( filter_ );
+
+  if ( !jsonFile_.empty ( ) && !remo::bench::writeJSON ( jsonFile_, results_ ))
+  {
+    std::cerr << "Unable to write " << jsonFile_ << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto regressions_ = remo::bench::findRegressions ( results_, baseline_, tolerance_ );
+  for ( auto& regression_: regressions_ )
+  {
+    std::cerr << "Regression " << regression_ << std::endl;
+  }
+  if ( !regressions_.empty ( ))
+  {
+    return EXIT_FAILURE;
+  }
+  return missingBaseline_ ? EXIT_NO_BASELINE : EXIT_SUCCESS;
+}
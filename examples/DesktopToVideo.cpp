@@ -45,11 +45,20 @@ int main ( )
   std::unique_ptr < remo::Stream >
     os = std::unique_ptr < remo::StreamVideoFileOut > ( new
       remo::StreamVideoFileOut ( om.get ( )));
+  //H.264 at a tenth of the default bitrate ("archive-quality" for storage).
+  //static_cast < remo::StreamVideoFileOut* > ( os.get ( ))->setEncoderSettings (
+  //  remo::EncoderSettings::fromProfile ( "realtime-lowcpu" ));
+  //Fragmented MP4, readable up to the last keyframe after a crash.
+  //static_cast < remo::StreamVideoFileOut* > ( os.get ( ))->setFragmented ( true );
 
   //Define the Flow and process
   remo::FlowDeviceToVideoFile f ( is.get ( ), os.get ( ));
+  //f.setPipelinedExecution ( true ); //One thread per stage.
+  //f.addSegmentedOutput ( "desktop", 10.0, 0, 2000000000 ); //10 s segments, 2 GB kept.
+  //f.addOutput ( "udp://127.0.0.1:1234", "mpegts" ); //Same encoding, sent too.
 
   f.processStreams ( );
+  //f.dumpStats ( "desktopToVideo.json" ); //Per-stage latency and throughput.
 
   remo::Utils::getInstance ( )->getLog ( ) ( remo::LOG_LEVEL::INFO,
                                              "Desktop to video successfully executed." );
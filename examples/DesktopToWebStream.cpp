@@ -48,7 +48,17 @@ int main ( )
 
   //Define the Flow and process
   remo::FlowDeviceToWebStream f ( is.get ( ), os.get ( ));
-  f.processStreams ( );
+  remo::FlowHandle h = f.start ( );
+
+  remo::Utils::getInstance ( )->getLog ( ) ( remo::LOG_LEVEL::WARNING,
+                                             "Press any key to finish the stream!." );
+  std::cin.get ( );
+  if ( !h.stopAndWait ( std::chrono::seconds ( 2 )))
+  {
+    remo::Utils::getInstance ( )->getLog ( ) ( remo::LOG_LEVEL::WARNING,
+                                               "Waiting for the stream to finish." );
+  }
+  h.join ( );
 
   remo::Utils::getInstance ( )->getLog ( ) ( remo::LOG_LEVEL::INFO,
                                              "Desktop viewer successfully executed." );
@@ -47,7 +47,7 @@ int main ( )
       remo::StreamSDLViewerOut ( om.get ( )));
 
   //Define the Flow and process
-  //remo::FlowDeviceToSDLViewer f ( is.get (), os.get (), true ); //Continuous visualization.
+  //remo::FlowDeviceToSDLViewer f ( is.get (), os.get (), true ); //Continuous visualization, stopped with f.finish ( ) or through f.start ( ).
   remo::FlowDeviceToSDLViewer f ( is.get ( ), os.get ( ));
   f.processStreams ( );
 
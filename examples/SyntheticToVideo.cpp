@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018 CCS/UPM - GMRV/URJC.
+ *
+ * Authors: Juan Pedro Brito Méndez <juanpedro.brito@upm.es>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+#include <iostream>
+
+#include <ReMo/flow/FlowDeviceToVideoFile.h>
+#include <ReMo/media/MediaSynthetic.h>
+#include <ReMo/media/MediaVideoFile.h>
+#include <ReMo/util/Utils.h>
+
+using namespace std;
+
+int main ( )
+{
+  remo::Utils::getInstance ( )
+    ->getLog ( ) ( remo::LOG_LEVEL::INFO, "Init logging." );
+
+  //Define the input Media and Stream, a moving and noisy 720p pattern
+  std::unique_ptr < remo::Media >
+    im = std::unique_ptr < remo::MediaSynthetic > ( new remo::MediaSynthetic ( 1280, 720, 30 ));
+  static_cast < remo::MediaSynthetic* > ( im.get ( ))->setMotion ( 0.5f );
+  static_cast < remo::MediaSynthetic* > ( im.get ( ))->setEntropy ( 0.2f );
+  std::unique_ptr < remo::Stream >
+    is = std::unique_ptr < remo::StreamDeviceIn > ( new remo::StreamDeviceIn ( im.get ( )));
+
+  //Define the output Media and Stream
+  std::unique_ptr < remo::Media > om =
+    std::unique_ptr < remo::MediaVideoFile > ( new remo::MediaVideoFile ( ));
+  std::unique_ptr < remo::Stream >
+    os = std::unique_ptr < remo::StreamVideoFileOut > ( new remo::StreamVideoFileOut (
+      om.get ( )));
+
+  //Define the Flow and process
+  remo::FlowDeviceToVideoFile f ( is.get ( ), os.get ( ), false, 300 );
+  f.processStreams ( );
+  f.dumpStats ( "syntheticToVideo_stats.json" );
+
+  remo::Utils::getInstance ( )->getLog ( ) ( remo::LOG_LEVEL::INFO,
+                                             "Synthetic to video successfully executed." );
+  return 0;
+}
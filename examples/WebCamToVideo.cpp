@@ -35,6 +35,7 @@ int main ( )
   //Define the input Media and Stream
   std::unique_ptr < remo::Media >
     im = std::unique_ptr < remo::MediaWebCam > ( new remo::MediaWebCam ( ));
+  //static_cast < remo::MediaWebCam* > ( im.get ( ))->setInputFormat ( "mjpeg" ); //Compressed capture.
   std::unique_ptr < remo::Stream >
     is = std::unique_ptr < remo::StreamDeviceIn > ( new remo::StreamDeviceIn ( im.get ( )));
 
@@ -44,6 +45,7 @@ int main ( )
   std::unique_ptr < remo::Stream >
     os = std::unique_ptr < remo::StreamVideoFileOut > ( new remo::StreamVideoFileOut (
       om.get ( )));
+  //static_cast < remo::StreamVideoFileOut* > ( os.get ( ))->setPassthrough ( true ); //Store the camera packets as they come.
 
   //Define the Flow and process
   remo::FlowDeviceToVideoFile f ( is.get ( ), os.get ( ));